@@ -35,6 +35,9 @@
 #include <string.h>
 #include <stdbool.h>
 #include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <sys/stat.h>
 #include "capture.h"
 #ifdef USE_EEP
@@ -135,6 +138,11 @@ capture_init(size_t limit, bool rtp_capture, bool rotate, size_t pcap_buffer_siz
 #endif
     pthread_mutex_init(&capture_cfg.lock, &attr);
 
+    // Initialize packets captured while lock is busy
+    capture_cfg.pending = vector_create(0, 200);
+    vector_set_destroyer(capture_cfg.pending, packet_destroyer);
+    pthread_mutex_init(&capture_cfg.pending_lock, NULL);
+
 }
 
 void
@@ -147,6 +155,10 @@ capture_deinit()
     vector_set_destroyer(capture_cfg.sources, vector_generic_destroyer);
     vector_destroy(capture_cfg.sources);
 
+    // Remove packets never parsed
+    vector_destroy(capture_cfg.pending);
+    pthread_mutex_destroy(&capture_cfg.pending_lock);
+
     // Remove capture mutex
     pthread_mutex_destroy(&capture_cfg.lock);
 }
@@ -343,6 +355,20 @@ parse_packet(u_char *info, const struct pcap_pkthdr *header, const u_char *packe
     // Captured HEP3 packet info
     packet_t *pkt_hep3;
 #endif
+    // Stage timer start
+    uint64_t start;
+    // Capture drop statistics
+    struct pcap_stat ps;
+
+    // Count received frame
+    metrics_source_captured(&capinfo->metrics, header->caplen);
+
+    // Update drop statistics once per second, pcap handle is only used by this thread
+    if (!capinfo->infile && header->ts.tv_sec != capinfo->metrics.drops_time) {
+        capinfo->metrics.drops_time = header->ts.tv_sec;
+        if (pcap_stats(capinfo->handle, &ps) == 0)
+            metrics_source_drops(&capinfo->metrics, ps.ps_drop, ps.ps_ifdrop);
+    }
 
     // Ignore packets while capture is paused
     if (capture_paused())
@@ -364,7 +390,10 @@ parse_packet(u_char *info, const struct pcap_pkthdr *header, const u_char *packe
     memcpy(data, packet, header->caplen);
 
     // Check if we have a complete IP packet
-    if (!(pkt = capture_packet_reasm_ip(capinfo, header, data, &size_payload, &size_capture)))
+    start = metrics_stage_start();
+    pkt = capture_packet_reasm_ip(capinfo, header, data, &size_payload, &size_capture);
+    metrics_stage_end(METRICS_STAGE_REASM_IP, start);
+    if (!pkt)
         return;
 
     // Only interested in UDP packets
@@ -435,13 +464,18 @@ parse_packet(u_char *info, const struct pcap_pkthdr *header, const u_char *packe
         packet_set_payload(pkt, payload, size_payload);
 
         // Create a structure for this captured packet
-        if (!(pkt = capture_packet_reasm_tcp(capinfo, pkt, tcp, payload, size_payload)))
+        start = metrics_stage_start();
+        pkt = capture_packet_reasm_tcp(capinfo, pkt, tcp, payload, size_payload);
+        metrics_stage_end(METRICS_STAGE_REASM_TCP, start);
+        if (!pkt)
             return;
 
 #if defined(WITH_GNUTLS) || defined(WITH_OPENSSL)
         // Check if packet is TLS
         if (capture_cfg.keyfile) {
+            start = metrics_stage_start();
             tls_process_segment(pkt, tcp);
+            metrics_stage_end(METRICS_STAGE_TLS, start);
         }
 #endif
 
@@ -453,30 +487,113 @@ parse_packet(u_char *info, const struct pcap_pkthdr *header, const u_char *packe
         return;
     }
 
-    // Avoid parsing from multiples sources.
-    // Avoid parsing while screen in being redrawn
-    capture_lock();
+    // Update source counters and reassembly queues depth
+    metrics_source_parsed(&capinfo->metrics);
+    atomic_store_explicit(&capinfo->metrics.ip_reasm, vector_count(capinfo->ip_reasm), memory_order_relaxed);
+    atomic_store_explicit(&capinfo->metrics.tcp_reasm, vector_count(capinfo->tcp_reasm), memory_order_relaxed);
+
+    // Parse the packet (now or after screen is redrawn)
+    capture_packet_store(pkt);
+}
+
+void
+capture_packet_store(packet_t *pkt)
+{
+    uint64_t start;
+    bool full;
+
+    // Queue the packet to be parsed by the thread holding the lock
+    pthread_mutex_lock(&capture_cfg.pending_lock);
+    if (!(full = vector_count(capture_cfg.pending) >= CAPTURE_PENDING_MAX))
+        vector_append(capture_cfg.pending, pkt);
+    pthread_mutex_unlock(&capture_cfg.pending_lock);
+
+    if (full) {
+        // Too many pending packets, wait until lock is released
+        start = metrics_now();
+        pthread_mutex_lock(&capture_cfg.lock);
+        metrics_lock_wait(metrics_now() - start);
+        capture_packet_store_pending();
+        capture_packet_process(pkt);
+        pthread_mutex_unlock(&capture_cfg.lock);
+    }
+
+    // Parse pending packets if lock is not busy
+    capture_packet_store_pending();
+}
+
+void
+capture_packet_store_pending()
+{
+    vector_t *pending;
+    packet_t *pkt;
+    vector_iter_t it;
+    int count;
+
+    while (1) {
+        // Check if there is any packet to parse
+        pthread_mutex_lock(&capture_cfg.pending_lock);
+        count = vector_count(capture_cfg.pending);
+        pthread_mutex_unlock(&capture_cfg.pending_lock);
+
+        // Avoid parsing from multiples sources.
+        // Avoid parsing while screen in being redrawn
+        if (!count || pthread_mutex_trylock(&capture_cfg.lock) != 0)
+            break;
+
+        // Take all packets queued until now
+        pthread_mutex_lock(&capture_cfg.pending_lock);
+        pending = capture_cfg.pending;
+        capture_cfg.pending = vector_create(0, 200);
+        vector_set_destroyer(capture_cfg.pending, packet_destroyer);
+        pthread_mutex_unlock(&capture_cfg.pending_lock);
+
+        // Parse them in capture order
+        it = vector_iterator(pending);
+        while ((pkt = vector_iterator_next(&it)))
+            capture_packet_process(pkt);
+
+        vector_set_destroyer(pending, NULL);
+        vector_destroy(pending);
+
+        // Allow Interface refresh and user input actions
+        pthread_mutex_unlock(&capture_cfg.lock);
+    }
+}
+
+void
+capture_packet_process(packet_t *pkt)
+{
+#ifdef USE_EEP
+    frame_t *frame;
+#endif
+    uint64_t start;
+
     // Check if we can handle this packet
     if (capture_packet_parse(pkt) == 0) {
+        metrics_packet(pkt->type);
 #ifdef USE_EEP
-        // Send this packet through eep
-        capture_eep_send(pkt);
+        // Send this packet through eep (unless received from eep server)
+        if (!(frame = vector_first(pkt->frames)) || !frame->synthetic) {
+            start = metrics_stage_start();
+            capture_eep_send(pkt);
+            metrics_stage_end(METRICS_STAGE_EEP, start);
+        }
 #endif
         // Store this packets in output file
-        capture_dump_packet(pkt);;
+        start = metrics_stage_start();
+        capture_dump_packet(pkt);
+        metrics_stage_end(METRICS_STAGE_DUMP, start);
         // If storage is disabled, delete frames payload
         if (capture_cfg.storage == 0) {
             packet_free_frames(pkt);
         }
-        // Allow Interface refresh and user input actions
-        capture_unlock();
         return;
     }
 
     // Not an interesting packet ...
+    metrics_packet(-1);
     packet_destroy(pkt);
-    // Allow Interface refresh and user input actions
-    capture_unlock();
 }
 
 packet_t *
@@ -986,16 +1103,26 @@ capture_packet_parse(packet_t *packet)
 {
     // Media structure for RTP packets
     rtp_stream_t *stream;
+    // Parsed SIP message
+    sip_msg_t *msg;
+    // Stage timer start
+    uint64_t start;
 
     // We're only interested in packets with payload
     if (packet_payloadlen(packet)) {
         // Parse this header and payload
-        if (sip_check_packet(packet)) {
+        start = metrics_stage_start();
+        msg = sip_check_packet(packet);
+        metrics_stage_end(METRICS_STAGE_SIP, start);
+        if (msg) {
             return 0;
         }
 
         // Check if this packet belongs to a RTP stream
-        if ((stream = rtp_check_packet(packet))) {
+        start = metrics_stage_start();
+        stream = rtp_check_packet(packet);
+        metrics_stage_end(METRICS_STAGE_RTP, start);
+        if (stream) {
             // We have an RTP packet!
             packet_set_type(packet, PACKET_RTP);
             // Store this pacekt if capture rtp is enabled
@@ -1017,11 +1144,6 @@ capture_close()
     if (vector_count(capture_cfg.sources) == 0)
         return;
 
-    // Close dump file
-    if (capture_cfg.pd) {
-        dump_close(capture_cfg.pd);
-    }
-
     // Stop all captures
     vector_iter_t it = vector_iterator(capture_cfg.sources);
     while ((capinfo = vector_iterator_next(&it))) {
@@ -1041,6 +1163,12 @@ capture_close()
         }
     }
 
+    // Parse packets queued before captures were stopped
+    capture_packet_store_pending();
+
+    // Close dump file once all captured packets have been written
+    dump_writer_destroy(capture_cfg.writer);
+    capture_cfg.writer = NULL;
 }
 
 int
@@ -1262,6 +1390,33 @@ capture_sources_count()
     return vector_count(capture_cfg.sources);
 }
 
+vector_iter_t
+capture_sources_iterator()
+{
+    return vector_iterator(capture_cfg.sources);
+}
+
+const char *
+capture_source_name(capture_info_t *capinfo)
+{
+    if (capinfo->device)
+        return capinfo->device;
+    if (capinfo->infile)
+        return capinfo->infile;
+    return "eep";
+}
+
+int
+capture_pending_count()
+{
+    int count;
+
+    pthread_mutex_lock(&capture_cfg.pending_lock);
+    count = vector_count(capture_cfg.pending);
+    pthread_mutex_unlock(&capture_cfg.pending_lock);
+    return count;
+}
+
 char *
 capture_last_error()
 {
@@ -1277,8 +1432,11 @@ capture_last_error()
 void
 capture_lock()
 {
+    uint64_t start = metrics_now();
+
     // Avoid parsing more packet
     pthread_mutex_lock(&capture_cfg.lock);
+    metrics_lock_wait(metrics_now() - start);
 }
 
 void
@@ -1286,6 +1444,8 @@ capture_unlock()
 {
     // Allow parsing more packets
     pthread_mutex_unlock(&capture_cfg.lock);
+    // Parse packets captured while we had the lock
+    capture_packet_store_pending();
 }
 
 
@@ -1314,39 +1474,675 @@ capture_packet_time_sorter(vector_t *vector, void *item)
     vector_insert(vector, item, 0);
 }
 
+capture_merge_t *
+capture_merge_create()
+{
+    return sng_malloc(sizeof(capture_merge_t));
+}
+
+void
+capture_merge_destroy(capture_merge_t *merge)
+{
+    int i;
+
+    if (!merge)
+        return;
+
+    // Free streams not completely merged
+    for (i = 0; i < merge->count; i++) {
+        free(merge->heap[i]->items);
+        sng_free(merge->heap[i]);
+    }
+    sng_free(merge->heap);
+    sng_free(merge);
+}
+
+void
+capture_merge_add(capture_merge_t *merge, vector_t *items, bool msgs)
+{
+    capture_merge_stream_t *stream, **heap;
+    int count = vector_count(items);
+    int i;
+
+    // Nothing to merge
+    if (!count)
+        return;
+
+    if (!(stream = sng_malloc(sizeof(capture_merge_stream_t))))
+        return;
+
+    // Lists can be bigger than sng_malloc limit
+    if (!(stream->items = malloc(sizeof(void *) * count))) {
+        sng_free(stream);
+        return;
+    }
+
+    stream->count = count;
+    stream->msgs = msgs;
+    stream->id = merge->streams++;
+
+    // Copy the items, sorting them only if they are not in time order
+    for (i = 0; i < count; i++)
+        stream->items[i] = vector_item(items, i);
+    for (i = 1; i < count; i++) {
+        if (capture_merge_item_time(stream->items[i], msgs)
+            < capture_merge_item_time(stream->items[i - 1], msgs))
+            break;
+    }
+    if (i < count) {
+        qsort(stream->items, count, sizeof(void *),
+              (msgs) ? capture_merge_msg_cmp : capture_merge_packet_cmp);
+    }
+
+    stream->ts = capture_merge_item_time(stream->items[0], msgs);
+
+    // Make room in the heap for this stream
+    if (merge->count == merge->size) {
+        merge->size = (merge->size) ? merge->size * 2 : 64;
+        if (!(heap = realloc(merge->heap, sizeof(capture_merge_stream_t *) * merge->size))) {
+            free(stream->items);
+            sng_free(stream);
+            return;
+        }
+        merge->heap = heap;
+    }
+
+    // Add the stream to the heap
+    merge->heap[merge->count] = stream;
+    capture_merge_sift_up(merge, merge->count++);
+    merge->total += count;
+}
+
+packet_t *
+capture_merge_next(capture_merge_t *merge)
+{
+    capture_merge_stream_t *stream;
+    void *item;
+    bool msgs;
+
+    // All streams have been merged
+    if (!merge || !merge->count)
+        return NULL;
+
+    // Take next item from the oldest stream
+    stream = merge->heap[0];
+    item = stream->items[stream->pos++];
+    msgs = stream->msgs;
+
+    if (stream->pos < stream->count) {
+        // Update stream time and move it to its new position
+        stream->ts = capture_merge_item_time(stream->items[stream->pos], msgs);
+    } else {
+        // Stream completely merged, replace it with the last one
+        free(stream->items);
+        sng_free(stream);
+        merge->heap[0] = merge->heap[--merge->count];
+    }
+    capture_merge_sift_down(merge, 0);
+
+    return (msgs) ? ((sip_msg_t *) item)->packet : item;
+}
+
+uint64_t
+capture_merge_item_time(const void *item, bool msgs)
+{
+    struct timeval ts;
+
+    ts = (msgs) ? msg_get_time((sip_msg_t *) item) : packet_time((packet_t *) item);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_usec;
+}
+
+bool
+capture_merge_stream_less(capture_merge_stream_t *s1, capture_merge_stream_t *s2)
+{
+    // Keep streams insertion order for packets with the same time
+    return s1->ts < s2->ts || (s1->ts == s2->ts && s1->id < s2->id);
+}
+
 void
-capture_set_dumper(pcap_dumper_t *dumper, ino_t dump_inode)
+capture_merge_sift_up(capture_merge_t *merge, int pos)
 {
-    capture_cfg.pd = dumper;
-    capture_cfg.dump_inode = dump_inode;
+    capture_merge_stream_t *stream = merge->heap[pos];
+
+    while (pos > 0 && capture_merge_stream_less(stream, merge->heap[(pos - 1) / 2])) {
+        merge->heap[pos] = merge->heap[(pos - 1) / 2];
+        pos = (pos - 1) / 2;
+    }
+    merge->heap[pos] = stream;
+}
+
+void
+capture_merge_sift_down(capture_merge_t *merge, int pos)
+{
+    capture_merge_stream_t *stream;
+    int child;
+
+    if (pos >= merge->count)
+        return;
+
+    stream = merge->heap[pos];
+    while ((child = pos * 2 + 1) < merge->count) {
+        // Pick the oldest child
+        if (child + 1 < merge->count
+            && capture_merge_stream_less(merge->heap[child + 1], merge->heap[child]))
+            child++;
+        if (!capture_merge_stream_less(merge->heap[child], stream))
+            break;
+        merge->heap[pos] = merge->heap[child];
+        pos = child;
+    }
+    merge->heap[pos] = stream;
+}
+
+int
+capture_merge_packet_cmp(const void *item1, const void *item2)
+{
+    uint64_t t1 = capture_merge_item_time(*(void **) item1, false);
+    uint64_t t2 = capture_merge_item_time(*(void **) item2, false);
+    return (t1 > t2) - (t1 < t2);
+}
+
+int
+capture_merge_msg_cmp(const void *item1, const void *item2)
+{
+    uint64_t t1 = capture_merge_item_time(*(void **) item1, true);
+    uint64_t t2 = capture_merge_item_time(*(void **) item2, true);
+    return (t1 > t2) - (t1 < t2);
+}
+
+int
+capture_set_dumpfile(const char *pattern)
+{
+    // Write captured packets from a different thread
+    if (!(capture_cfg.writer = dump_writer_create(pattern)))
+        return 1;
+    return 0;
 }
 
 void
 capture_dump_packet(packet_t *packet)
 {
-    if (sigusr1_received && capture_cfg.pd) {
-        // we got a SIGUSR1: reopen the dump file because it could have been renamed
-        // we don't need to care about locking or other threads accessing in parallel
-        // because dump_open ensures count(capture_cfg.sources) == 1
+    // Let the writer thread store the packet
+    if (capture_cfg.writer)
+        dump_writer_push(capture_cfg.writer, packet);
+}
 
-        // check if the file has actually changed
-        // only reopen if it has, otherwise we would overwrite the existing one
-        struct stat sb;
-        if (stat(capture_cfg.dumpfilename, &sb) == -1 ||
-            sb.st_ino != capture_cfg.dump_inode)
-        {
-            pcap_dump_close(capture_cfg.pd);
-            capture_cfg.pd = dump_open(capture_cfg.dumpfilename, &capture_cfg.dump_inode);
+void
+capture_dump_stats(capture_dump_stats_t *stats)
+{
+    dump_writer_t *writer = capture_cfg.writer;
+
+    memset(stats, 0, sizeof(capture_dump_stats_t));
+    if (!writer)
+        return;
+
+    stats->queued = atomic_load(&writer->queued);
+    stats->written = atomic_load(&writer->written);
+    stats->dropped = atomic_load(&writer->dropped);
+    stats->pending = queue_count(writer->queue);
+    stats->highwater = atomic_load(&writer->highwater);
+    stats->rotated = atomic_load(&writer->rotated);
+}
+
+dump_writer_t *
+dump_writer_create(const char *pattern)
+{
+    dump_writer_t *writer;
+    void *buffer;
+    int size;
+
+    if (!(writer = sng_malloc(sizeof(dump_writer_t))))
+        return NULL;
+
+    // Aligned buffer for direct I/O (bigger than sng_malloc limit)
+    if (posix_memalign(&buffer, DUMP_WRITER_ALIGN, DUMP_BUFFER_SIZE) != 0) {
+        sng_free(writer);
+        return NULL;
+    }
+
+    writer->pattern = pattern;
+    writer->fd = -1;
+    writer->buffer = buffer;
+    writer->direct = setting_enabled(SETTING_CAPTURE_DUMP_DIRECT);
+    writer->sync = setting_get_enumvalue(SETTING_CAPTURE_DUMP_SYNC);
+    writer->drop = capture_is_online();
+    writer->maxsize = (uint64_t) setting_get_intvalue(SETTING_CAPTURE_DUMP_SIZE) * 1024 * 1024;
+    writer->interval = setting_get_intvalue(SETTING_CAPTURE_DUMP_INTERVAL);
+
+    // Create queues for records pending to be written and records to be reused
+    size = setting_get_intvalue(SETTING_CAPTURE_DUMP_QUEUE);
+    writer->queue = queue_create((size > 0) ? size : 1);
+    writer->free = queue_create((size > 0) ? size : 1);
+    if (!writer->queue || !writer->free) {
+        queue_destroy(writer->queue);
+        queue_destroy(writer->free);
+        free(writer->buffer);
+        sng_free(writer);
+        return NULL;
+    }
+    queue_set_destroyer(writer->queue, dump_record_destroyer);
+    queue_set_destroyer(writer->free, dump_record_destroyer);
+
+    // Open first dump file
+    if (dump_writer_open(writer) != 0) {
+        queue_destroy(writer->queue);
+        queue_destroy(writer->free);
+        free(writer->buffer);
+        sng_free(writer);
+        return NULL;
+    }
+
+    // Start the writer thread
+    sem_init(&writer->sem, 0, 0);
+    atomic_init(&writer->running, true);
+    if (pthread_create(&writer->thread, NULL, dump_writer_run, writer) != 0) {
+        sem_destroy(&writer->sem);
+        dump_close(writer->pd);
+        queue_destroy(writer->queue);
+        queue_destroy(writer->free);
+        free(writer->buffer);
+        sng_free(writer);
+        return NULL;
+    }
+
+    metrics_memory_add(METRICS_MEM_DUMP, DUMP_BUFFER_SIZE);
+    return writer;
+}
+
+void
+dump_writer_destroy(dump_writer_t *writer)
+{
+    if (!writer)
+        return;
+
+    // Stop writer thread after writing pending records
+    atomic_store(&writer->running, false);
+    sem_post(&writer->sem);
+    pthread_join(writer->thread, NULL);
+    sem_destroy(&writer->sem);
+
+    dump_close(writer->pd);
+    queue_destroy(writer->queue);
+    queue_destroy(writer->free);
+    free(writer->buffer);
+    metrics_memory_add(METRICS_MEM_DUMP, -DUMP_BUFFER_SIZE);
+    sng_free(writer);
+}
+
+int
+dump_writer_push(dump_writer_t *writer, const packet_t *packet)
+{
+    dump_record_t *record, *dropped;
+    struct dump_record_header header;
+    vector_iter_t it;
+    frame_t *frame;
+    u_char *data;
+    size_t len = 0, pending;
+
+    // Get required size for all packet frames
+    it = vector_iterator(packet->frames);
+    while ((frame = vector_iterator_next(&it)))
+        len += sizeof(struct dump_record_header) + frame->header->caplen;
+
+    // Nothing to write
+    if (!len)
+        return 1;
+
+    // Reuse a written record or create a new one
+    if (!(record = queue_pop(writer->free))) {
+        if (!(record = sng_malloc(sizeof(dump_record_t))))
+            return 1;
+    }
+
+    if (record->size < len) {
+        if (!(data = realloc(record->data, len))) {
+            dump_record_destroyer(record);
+            return 1;
         }
+        metrics_memory_add(METRICS_MEM_DUMP, (long) (len - record->size));
+        record->data = data;
+        record->size = len;
+    }
+
+    // Copy frames in pcap file record format
+    record->len = 0;
+    it = vector_iterator(packet->frames);
+    while ((frame = vector_iterator_next(&it))) {
+        data = frame->data;
+#ifdef USE_EEP
+        // Generate frame contents only when storing them
+        if (frame->synthetic && !(data = capture_eep_frame_data(packet, frame)))
+            continue;
+#endif
+        header.ts_sec = frame->header->ts.tv_sec;
+        header.ts_usec = frame->header->ts.tv_usec;
+        header.caplen = frame->header->caplen;
+        header.len = frame->header->len;
+        memcpy(record->data + record->len, &header, sizeof(header));
+        record->len += sizeof(header);
+        memcpy(record->data + record->len, data, header.caplen);
+        record->len += header.caplen;
+#ifdef USE_EEP
+        if (frame->synthetic)
+            free(data);
+#endif
+    }
 
-        sigusr1_received = 0;
+    // Offline captures wait for the writer instead of losing packets
+    while (!writer->drop && queue_count(writer->queue) >= writer->queue->size) {
+        if (atomic_exchange(&writer->waiting, 0))
+            sem_post(&writer->sem);
+        usleep(1000);
+    }
 
-        // error reopening capture file: we can't capture anymore
-        if (!capture_cfg.pd)
-            return;
+    // Queue the record, dropping the oldest one if queue is full
+    if ((dropped = queue_push(writer->queue, record))) {
+        atomic_fetch_add(&writer->dropped, 1);
+        dump_record_destroyer(dropped);
+    }
+    atomic_fetch_add(&writer->queued, 1);
+
+    // Update max number of pending records (only updated by this thread)
+    pending = queue_count(writer->queue);
+    if (pending > atomic_load(&writer->highwater))
+        atomic_store(&writer->highwater, pending);
+
+    // Wake up writer thread if it is waiting for records
+    if (atomic_exchange(&writer->waiting, 0))
+        sem_post(&writer->sem);
+
+    return 0;
+}
+
+void *
+dump_writer_run(void *data)
+{
+    dump_writer_t *writer = (dump_writer_t *) data;
+    dump_record_t *record, *dropped;
+    struct timespec ts;
+
+    while (1) {
+        // We got a SIGUSR1: reopen the dump file because it could have been renamed
+        if (sigusr1_received) {
+            dump_writer_reopen(writer);
+            sigusr1_received = 0;
+        }
+
+        if (!(record = queue_pop(writer->queue))) {
+            // No more pending records, write buffered ones
+            dump_writer_flush(writer, true);
+
+            // Rotate by time even if no packet is being captured
+            if (atomic_load(&writer->running) && dump_writer_rotate_due(writer, 0))
+                dump_writer_rotate(writer);
+
+            // Writer has been stopped, finish when all records are written
+            if (!atomic_load(&writer->running)) {
+                if (queue_count(writer->queue) == 0)
+                    break;
+                continue;
+            }
+
+            // Request a notification for the next queued record
+            atomic_store(&writer->waiting, 1);
+            // Records may have been queued before the request was done
+            if (queue_count(writer->queue) == 0) {
+                clock_gettime(CLOCK_REALTIME, &ts);
+                ts.tv_nsec += 100 * 1000 * 1000;
+                if (ts.tv_nsec >= 1000 * 1000 * 1000) {
+                    ts.tv_sec++;
+                    ts.tv_nsec -= 1000 * 1000 * 1000;
+                }
+                sem_timedwait(&writer->sem, &ts);
+            }
+            atomic_store(&writer->waiting, 0);
+            continue;
+        }
+
+        // Start a new dump file if current one is full or too old
+        if (dump_writer_rotate_due(writer, record->len))
+            dump_writer_rotate(writer);
+
+        // Make room in the buffer for this record
+        if (writer->buflen + record->len > DUMP_BUFFER_SIZE)
+            dump_writer_flush(writer, false);
+
+        // Error reopening dump file or record too big to be buffered
+        if (!writer->pd || writer->buflen + record->len > DUMP_BUFFER_SIZE) {
+            atomic_fetch_add(&writer->dropped, 1);
+        } else {
+            memcpy(writer->buffer + writer->buflen, record->data, record->len);
+            writer->buflen += record->len;
+            writer->size += record->len;
+            atomic_fetch_add(&writer->written, 1);
+        }
+
+        // Return record for reuse
+        if ((dropped = queue_push(writer->free, record)))
+            dump_record_destroyer(dropped);
+    }
+
+    return NULL;
+}
+
+void
+dump_writer_attach(dump_writer_t *writer, pcap_dumper_t *pd)
+{
+    ssize_t len;
+    int fd;
+#ifdef O_DIRECT
+    int flags;
+#endif
+
+    writer->pd = pd;
+    writer->fd = -1;
+    writer->buflen = 0;
+    writer->offset = 0;
+
+    if (!pd)
+        return;
+
+    // Make sure the file header has been written
+    pcap_dump_flush(pd);
+
+    // Compressed files have no raw file descriptor
+    if ((fd = fileno(pcap_dump_file(pd))) == -1)
+        return;
+
+    // Load file header, it will be written again with the first block
+    if ((len = pread(fd, writer->buffer, DUMP_WRITER_ALIGN, 0)) < 0)
+        return;
+
+    writer->fd = fd;
+    writer->buflen = len;
+
+#ifdef O_DIRECT
+    // Disable direct I/O if the filesystem does not support it
+    if (writer->direct) {
+        if ((flags = fcntl(writer->fd, F_GETFL)) == -1
+            || fcntl(writer->fd, F_SETFL, flags | O_DIRECT) == -1)
+            writer->direct = false;
+    }
+#else
+    writer->direct = false;
+#endif
+}
+
+int
+dump_writer_flush(dump_writer_t *writer, bool all)
+{
+    size_t len = writer->buflen, tail = 0;
+    FILE *fp;
+    int err = 0;
+#ifdef O_DIRECT
+    int flags;
+#endif
+
+    // Nothing to write
+    if (!len || !writer->pd)
+        return 0;
+
+    // Compressed files are written through their stdio stream
+    if (writer->fd == -1) {
+        fp = pcap_dump_file(writer->pd);
+        if (fwrite(writer->buffer, 1, len, fp) != len || fflush(fp) != 0)
+            err = 1;
+        writer->buflen = 0;
+        return err;
+    }
+
+    // Direct I/O can only write full aligned blocks
+    if (writer->direct) {
+        tail = len % DUMP_WRITER_ALIGN;
+        len -= tail;
+    }
+
+    if (len)
+        err = dump_write(writer->fd, writer->buffer, len, writer->offset);
+
+#ifdef O_DIRECT
+    // Write the unaligned tail through the page cache. It is kept in the
+    // buffer, so the next aligned block will write it again
+    if (tail && all) {
+        flags = fcntl(writer->fd, F_GETFL);
+        fcntl(writer->fd, F_SETFL, flags & ~O_DIRECT);
+        err |= dump_write(writer->fd, writer->buffer + len, tail, writer->offset + len);
+        fcntl(writer->fd, F_SETFL, flags);
+    }
+#endif
+
+    // Keep the unaligned tail at the start of the buffer
+    memmove(writer->buffer, writer->buffer + len, tail);
+    writer->buflen = tail;
+    writer->offset += len;
+
+    // Wait for written data to reach the disk
+    if (writer->sync == SETTING_DUMP_SYNC_BATCH
+        || (all && writer->sync == SETTING_DUMP_SYNC_IDLE))
+        fdatasync(writer->fd);
+
+    return err;
+}
+
+void
+dump_writer_reopen(dump_writer_t *writer)
+{
+    struct stat sb;
+
+    // Check if the file has actually changed, only reopen if it has,
+    // otherwise we would overwrite the existing one
+    if (writer->pd && stat(writer->filename, &sb) == 0 && sb.st_ino == writer->inode)
+        return;
+
+    // Write pending data to the old file
+    dump_writer_flush(writer, true);
+    dump_close(writer->pd);
+
+    // If the file can not be reopened, records will be dropped
+    dump_writer_attach(writer, dump_open(writer->filename, &writer->inode));
+    writer->size = sizeof(struct pcap_file_header);
+}
+
+int
+dump_writer_open(dump_writer_t *writer)
+{
+    char name[PATH_MAX];
+    const char *base, *ext;
+    time_t now = time(NULL);
+    struct tm tm;
+
+    // Schedule next rotation at a multiple of the interval, so files
+    // start at round times (for example, at the start of each hour)
+    if (writer->interval > 0)
+        writer->rotate_at = (now / writer->interval + 1) * writer->interval;
+    writer->size = sizeof(struct pcap_file_header);
+
+    if (!writer->pattern) {
+        dump_writer_attach(writer, NULL);
+        return 1;
+    }
+
+    if (writer->maxsize || writer->interval > 0) {
+        // Expand time fields of the file name pattern
+        localtime_r(&now, &tm);
+        if (strftime(name, sizeof(name), writer->pattern, &tm) == 0) {
+            dump_writer_attach(writer, NULL);
+            return 1;
+        }
+    } else {
+        // Without rotation, the file name is used as is
+        snprintf(name, sizeof(name), "%s", writer->pattern);
+    }
+
+    if (strcmp(name, writer->basename) == 0) {
+        // Same name than previous file, insert an index before file extensions
+        writer->index++;
+        base = (base = strrchr(name, '/')) ? base + 1 : name;
+        if (!(ext = strchr(base, '.')))
+            ext = name + strlen(name);
+        snprintf(writer->filename, sizeof(writer->filename), "%.*s_%d%s",
+                 (int) (ext - name), name, writer->index, ext);
+    } else {
+        writer->index = 0;
+        strcpy(writer->basename, name);
+        strcpy(writer->filename, name);
     }
 
-    dump_packet(capture_cfg.pd, packet);
+    // If the file can not be opened, records will be dropped
+    dump_writer_attach(writer, dump_open(writer->filename, &writer->inode));
+    return (writer->pd) ? 0 : 1;
+}
+
+bool
+dump_writer_rotate_due(dump_writer_t *writer, size_t len)
+{
+    // Rotate by size, unless the file has no packets yet
+    if (writer->maxsize && len && writer->size + len > writer->maxsize
+        && writer->size > sizeof(struct pcap_file_header))
+        return true;
+
+    // Rotate by time
+    if (writer->interval > 0 && time(NULL) >= writer->rotate_at)
+        return true;
+
+    return false;
+}
+
+void
+dump_writer_rotate(dump_writer_t *writer)
+{
+    // Write pending data to the current file
+    dump_writer_flush(writer, true);
+    dump_close(writer->pd);
+
+    dump_writer_open(writer);
+    atomic_fetch_add(&writer->rotated, 1);
+}
+
+int
+dump_write(int fd, const u_char *data, size_t len, off_t offset)
+{
+    ssize_t ret;
+    size_t done;
+
+    for (done = 0; done < len; done += ret) {
+        ret = pwrite(fd, data + done, len - done, offset + done);
+        if (ret == -1 && errno == EINTR) {
+            ret = 0;
+            continue;
+        }
+        if (ret <= 0)
+            return 1;
+    }
+    return 0;
+}
+
+void
+dump_record_destroyer(void *record)
+{
+    metrics_memory_add(METRICS_MEM_DUMP, -(long) ((dump_record_t *) record)->size);
+    free(((dump_record_t *) record)->data);
+    sng_free(record);
 }
 
 int8_t
@@ -1413,7 +2209,6 @@ dump_open(const char *dumpfile, ino_t* dump_inode)
     capture_info_t *capinfo;
 
     if (vector_count(capture_cfg.sources) == 1) {
-        capture_cfg.dumpfilename = dumpfile;
         capinfo = vector_first(capture_cfg.sources);
 
         FILE *fp = fopen(dumpfile,"wb+");
@@ -1456,6 +2251,9 @@ dump_open(const char *dumpfile, ino_t* dump_inode)
 #endif
         }
 
+        // Write packets in large blocks instead of one syscall per packet
+        setvbuf(fp, NULL, _IOFBF, DUMP_BUFFER_SIZE);
+
         return pcap_dump_fopen(capinfo->handle, fp);
     }
     return NULL;
@@ -1463,6 +2261,16 @@ dump_open(const char *dumpfile, ino_t* dump_inode)
 
 void
 dump_packet(pcap_dumper_t *pd, const packet_t *packet)
+{
+    if (!pd || !packet)
+        return;
+
+    dump_packet_frames(pd, packet);
+    pcap_dump_flush(pd);
+}
+
+void
+dump_packet_frames(pcap_dumper_t *pd, const packet_t *packet)
 {
     if (!pd || !packet)
         return;
@@ -1470,9 +2278,19 @@ dump_packet(pcap_dumper_t *pd, const packet_t *packet)
     vector_iter_t it = vector_iterator(packet->frames);
     frame_t *frame;
     while ((frame = vector_iterator_next(&it))) {
+#ifdef USE_EEP
+        // Generate frame contents only when storing them
+        if (frame->synthetic) {
+            u_char *data = capture_eep_frame_data(packet, frame);
+            if (data) {
+                pcap_dump((u_char*) pd, frame->header, data);
+                free(data);
+            }
+            continue;
+        }
+#endif
         pcap_dump((u_char*) pd, frame->header, frame->data);
     }
-    pcap_dump_flush(pd);
 }
 
 void
@@ -37,6 +37,7 @@
 #include <pcap.h>
 #include <string.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <time.h>
 #include "address.h"
 
@@ -70,13 +71,23 @@
 #include <netinet/tcp.h>
 #include <netinet/udp.h>
 #include <stdbool.h>
+#include <stdatomic.h>
+#include <semaphore.h>
 #include "packet.h"
 #include "vector.h"
+#include "queue.h"
+#include "metrics.h"
 
 //! Max allowed packet assembled size
 #define MAX_CAPTURE_LEN 20480
 //! Max allowed packet length
 #define MAXIMUM_SNAPLEN 262144
+//! Max packets queued while capture lock is busy
+#define CAPTURE_PENDING_MAX 65536
+//! Write buffer size of dump files
+#define DUMP_BUFFER_SIZE (1024 * 1024)
+//! Alignment of dump writer buffer and writes (required by O_DIRECT)
+#define DUMP_WRITER_ALIGN 4096
 
 //! Define VLAN 802.1Q Ethernet type
 #ifndef ETHERTYPE_8021Q
@@ -110,6 +121,16 @@ enum capture_storage {
 typedef struct capture_config capture_config_t;
 //; Shorter declaration of capture_info structure
 typedef struct capture_info capture_info_t;
+//! Shorter declaration of capture_merge structure
+typedef struct capture_merge capture_merge_t;
+//! Shorter declaration of capture_merge_stream structure
+typedef struct capture_merge_stream capture_merge_stream_t;
+//! Shorter declaration of dump_writer structure
+typedef struct dump_writer dump_writer_t;
+//! Shorter declaration of dump_record structure
+typedef struct dump_record dump_record_t;
+//! Shorter declaration of capture_dump_stats structure
+typedef struct capture_dump_stats capture_dump_stats_t;
 
 /**
  * @brief Capture common configuration
@@ -137,16 +158,16 @@ struct capture_config {
     const char *filter;
     //! The compiled filter expression
     struct bpf_program fp;
-    //! libpcap dump file handler
-    pcap_dumper_t *pd;
-    //! libpcap dump file name
-    const char *dumpfilename;
-    //! inode of the dump file we have open
-    ino_t dump_inode;
+    //! Asynchronous writer of the dump file
+    dump_writer_t *writer;
     //! Capture sources
     vector_t *sources;
     //! Capture Lock. Avoid parsing and handling data at the same time
     pthread_mutex_t lock;
+    //! Packets captured while capture lock was busy
+    vector_t *pending;
+    //! Pending packets lock
+    pthread_mutex_t pending_lock;
 };
 
 /**
@@ -182,6 +203,166 @@ struct capture_info
     void *(*capture_fn)(void *data);
     //! Capture thread for online capturing
     pthread_t capture_t;
+    //! Source counters for metrics exporter
+    metrics_source_t metrics;
+};
+
+/**
+ * @brief Time ordered list of packets to be merged
+ */
+struct capture_merge_stream {
+    //! Time sorted copy of the stream items (packets or SIP messages)
+    void **items;
+    //! Number of items in the stream
+    int count;
+    //! Items are SIP messages instead of packets
+    bool msgs;
+    //! Stream position in merge, to keep insertion order for same times
+    int id;
+    //! Position of the next item
+    int pos;
+    //! Time of the next item (usec)
+    uint64_t ts;
+};
+
+/**
+ * @brief Time ordered merge of several lists of packets
+ *
+ * Each list is expected to be sorted (or nearly sorted) by time, like
+ * call messages and RTP packets. Lists are kept in a binary min-heap by
+ * the time of their next packet, so getting each packet takes O(log k),
+ * being k the number of merged lists.
+ *
+ * Lists are copied when added, so the merge can be consumed without the
+ * capture lock while the capture keeps appending packets to them.
+ */
+struct capture_merge {
+    //! Streams with pending packets (binary heap)
+    capture_merge_stream_t **heap;
+    //! Number of streams in the heap
+    int count;
+    //! Allocated heap slots
+    int size;
+    //! Number of added streams
+    int streams;
+    //! Number of packets in all added streams
+    int total;
+};
+
+/**
+ * @brief Packet frames pending to be written in the dump file
+ *
+ * Frames are copied in pcap file record format (record header followed
+ * by frame data), so the writer only needs to append them to its buffer.
+ */
+struct dump_record {
+    //! Allocated data size
+    size_t size;
+    //! Used data length
+    size_t len;
+    //! Packet frames records
+    u_char *data;
+};
+
+/**
+ * @brief Header of each record in pcap files
+ *
+ * This is the on-disk version of struct pcap_pkthdr, with fixed size
+ * timestamp fields.
+ */
+struct dump_record_header {
+    uint32_t ts_sec;
+    uint32_t ts_usec;
+    uint32_t caplen;
+    uint32_t len;
+};
+
+/**
+ * @brief Dump file writer counters
+ */
+struct capture_dump_stats {
+    //! Packets queued to be written
+    unsigned long queued;
+    //! Packets written to the dump file
+    unsigned long written;
+    //! Packets dropped because the writer queue was full
+    unsigned long dropped;
+    //! Packets currently pending in the queue
+    unsigned long pending;
+    //! Max number of packets that have been pending at the same time
+    unsigned long highwater;
+    //! Number of times the dump file has been rotated
+    unsigned long rotated;
+};
+
+/**
+ * @brief Asynchronous writer of the -O dump file
+ *
+ * Capture threads copy packet frames into records and queue them
+ * without waiting for the disk. The writer thread appends the records
+ * to an aligned buffer and writes it in large blocks when it is full
+ * or when there are no more pending records.
+ *
+ * In online captures, if the queue is full the oldest record is
+ * dropped. Offline captures wait for the writer instead, as no packet
+ * is lost by waiting.
+ *
+ * The writer thread also rotates the dump file when it reaches a size
+ * or age, so capture threads never wait for files being opened.
+ */
+struct dump_writer {
+    //! Dump file name pattern (strftime format)
+    const char *pattern;
+    //! Current dump file name
+    char filename[PATH_MAX];
+    //! Current dump file name before adding rotation index
+    char basename[PATH_MAX];
+    //! Rotation index of files with the same name
+    int index;
+    //! inode of the current dump file, to check if it has been moved
+    ino_t inode;
+    //! Rotate dump file when it reaches this size in bytes (0 to disable)
+    uint64_t maxsize;
+    //! Rotate dump file every N seconds (0 to disable)
+    int interval;
+    //! Bytes written to the current dump file (before compression)
+    uint64_t size;
+    //! Time of next rotation by interval
+    time_t rotate_at;
+    //! libpcap dump file handler (only used by writer thread)
+    pcap_dumper_t *pd;
+    //! Raw file descriptor of the dump file (-1 for compressed files)
+    int fd;
+    //! Write without page cache (O_DIRECT)
+    bool direct;
+    //! When to wait for written data to reach the disk (@see setting_dump_sync)
+    int sync;
+    //! Drop oldest records instead of waiting when queue is full
+    bool drop;
+    //! Aligned buffer of records pending to be written
+    u_char *buffer;
+    //! Bytes used in the buffer
+    size_t buflen;
+    //! File offset of the buffer first byte
+    off_t offset;
+    //! Records pending to be written
+    queue_t *queue;
+    //! Written records to be reused
+    queue_t *free;
+    //! Writer thread
+    pthread_t thread;
+    //! Writer thread is running
+    atomic_bool running;
+    //! Writer thread is waiting for new records
+    atomic_int waiting;
+    //! Semaphore to wake up the writer thread
+    sem_t sem;
+    //! Writer counters (@see capture_dump_stats)
+    atomic_ulong queued;
+    atomic_ulong written;
+    atomic_ulong dropped;
+    atomic_ulong highwater;
+    atomic_ulong rotated;
 };
 
 /**
@@ -307,6 +488,41 @@ capture_ws_check_packet(packet_t *packet);
 int
 capture_packet_parse(packet_t *pkt);
 
+/**
+ * @brief Parse and store a captured packet
+ *
+ * Packets are parsed by the thread holding the capture lock. If the
+ * lock is busy (for example, while the interface is being drawn) the
+ * packet is queued and parsed when the lock is released, so capture
+ * threads don't wait for the interface to read more packets.
+ *
+ * If too many packets are pending, the caller waits for the lock.
+ *
+ * @param pkt Captured packet
+ */
+void
+capture_packet_store(packet_t *pkt);
+
+/**
+ * @brief Parse packets queued while the capture lock was busy
+ *
+ * Packets will only be parsed if the capture lock is not being used
+ * by other thread.
+ */
+void
+capture_packet_store_pending();
+
+/**
+ * @brief Parse a captured packet and store it
+ *
+ * Capture lock must be held by the caller.
+ * Packet is destroyed if it doesn't contain interesting data.
+ *
+ * @param pkt Captured packet
+ */
+void
+capture_packet_process(packet_t *pkt);
+
 /**
  * @brief Create a capture thread for online mode
  *
@@ -439,6 +655,26 @@ capture_add_source(struct capture_info *capinfo);
 int
 capture_sources_count();
 
+/**
+ * @brief Return an iterator of capture sources
+ */
+vector_iter_t
+capture_sources_iterator();
+
+/**
+ * @brief Return the name of a capture source
+ *
+ * @return capture device, input file or "eep" for HEP servers
+ */
+const char *
+capture_source_name(capture_info_t *capinfo);
+
+/**
+ * @brief Return the number of packets waiting for the capture lock
+ */
+int
+capture_pending_count();
+
 /**
  * @brief Return the last capture error
  */
@@ -453,6 +689,9 @@ capture_lock();
 
 /**
  * @brief Allow parsing more packets
+ *
+ * Packets captured while the lock was held will be parsed before
+ * returning.
  */
 void
 capture_unlock();
@@ -463,6 +702,70 @@ capture_unlock();
 void
 capture_packet_time_sorter(vector_t *vector, void *item);
 
+/**
+ * @brief Create a new empty packet merge
+ */
+capture_merge_t *
+capture_merge_create();
+
+/**
+ * @brief Free merge memory
+ *
+ * Merged items are not freed.
+ */
+void
+capture_merge_destroy(capture_merge_t *merge);
+
+/**
+ * @brief Add a list of items to the merge
+ *
+ * A copy of the list is merged, sorted by time if required.
+ *
+ * @param merge Merge structure pointer
+ * @param items Vector of packets or SIP messages
+ * @param msgs true if items are SIP messages
+ */
+void
+capture_merge_add(capture_merge_t *merge, vector_t *items, bool msgs);
+
+/**
+ * @brief Get the packet with the oldest time of all merged lists
+ *
+ * @return next packet or NULL if all packets have been merged
+ */
+packet_t *
+capture_merge_next(capture_merge_t *merge);
+
+/**
+ * @brief Get time of a merge item (in usec)
+ */
+uint64_t
+capture_merge_item_time(const void *item, bool msgs);
+
+/**
+ * @brief Check if one stream next item goes before other stream one
+ */
+bool
+capture_merge_stream_less(capture_merge_stream_t *s1, capture_merge_stream_t *s2);
+
+/**
+ * @brief Move a heap stream up or down to its sorted position
+ */
+void
+capture_merge_sift_up(capture_merge_t *merge, int pos);
+
+void
+capture_merge_sift_down(capture_merge_t *merge, int pos);
+
+/**
+ * @brief qsort comparators by time of merge items
+ */
+int
+capture_merge_packet_cmp(const void *item1, const void *item2);
+
+int
+capture_merge_msg_cmp(const void *item1, const void *item2);
+
 /**
  * @brief Close pcap handler
  */
@@ -470,17 +773,148 @@ void
 capture_close();
 
 /**
- * @brief Set general capture dumper
+ * @brief Set general capture dump file
+ *
+ * Start the writer thread that will store captured packets
+ * in the dump file.
+ *
+ * @param pattern Dump file name, with optional strftime fields that are
+ * only expanded when dump file rotation is enabled
+ * @return 0 if the dump file has been opened, 1 otherwise
  */
-void
-capture_set_dumper(pcap_dumper_t *dumper, ino_t dump_inode);
+int
+capture_set_dumpfile(const char *pattern);
 
 /**
  * @brief Store a packet in dumper file
+ *
+ * Packet frames are queued to be written by the dump writer thread.
  */
 void
 capture_dump_packet(packet_t *packet);
 
+/**
+ * @brief Get dump file writer counters
+ *
+ * @param stats Structure to be filled with current counters
+ */
+void
+capture_dump_stats(capture_dump_stats_t *stats);
+
+/**
+ * @brief Create and start a new dump file writer
+ *
+ * First dump file is opened before starting the writer thread.
+ *
+ * @param pattern Dump file name, with optional strftime fields that are
+ * only expanded when dump file rotation is enabled
+ * @return new writer or NULL on failure
+ */
+dump_writer_t *
+dump_writer_create(const char *pattern);
+
+/**
+ * @brief Stop the dump file writer
+ *
+ * All pending records are written before closing the dump file.
+ */
+void
+dump_writer_destroy(dump_writer_t *writer);
+
+/**
+ * @brief Queue the frames of a packet to be written
+ *
+ * This must be called by one thread at a time (capture threads
+ * do it with the capture lock held).
+ *
+ * @return 0 if the packet has been queued, 1 otherwise
+ */
+int
+dump_writer_push(dump_writer_t *writer, const packet_t *packet);
+
+/**
+ * @brief Writer thread function
+ *
+ * @param data Dump writer pointer
+ */
+void *
+dump_writer_run(void *data);
+
+/**
+ * @brief Prepare writer buffer for a new dump file
+ *
+ * Get the raw file descriptor of the dump file and enable direct I/O
+ * if configured. The pcap file header is loaded into the buffer, so
+ * all writes start at aligned file offsets.
+ */
+void
+dump_writer_attach(dump_writer_t *writer, pcap_dumper_t *pd);
+
+/**
+ * @brief Write writer buffer to the dump file
+ *
+ * With direct I/O, only full aligned blocks are written unless all
+ * buffer is requested. The unaligned tail is then written through the
+ * page cache and kept in the buffer to be written again with the next
+ * block.
+ *
+ * @param writer Dump writer pointer
+ * @param all Write all buffered data, including unaligned tail
+ * @return 0 if data has been written, 1 on write error
+ */
+int
+dump_writer_flush(dump_writer_t *writer, bool all);
+
+/**
+ * @brief Reopen the dump file after receiving SIGUSR1
+ *
+ * Dump file is only reopened if it has been moved or removed
+ */
+void
+dump_writer_reopen(dump_writer_t *writer);
+
+/**
+ * @brief Open a new dump file
+ *
+ * File name is built expanding the strftime fields of the writer pattern
+ * with current time. If the name is the same than the previous file,
+ * an index is added before file extensions (capture_1.pcap, ...).
+ *
+ * @return 0 if the file has been opened, 1 otherwise
+ */
+int
+dump_writer_open(dump_writer_t *writer);
+
+/**
+ * @brief Check if the dump file must be rotated before writing a record
+ *
+ * @param writer Dump writer pointer
+ * @param len Length of the record to be written
+ * @return true if a new dump file must be opened
+ */
+bool
+dump_writer_rotate_due(dump_writer_t *writer, size_t len);
+
+/**
+ * @brief Close current dump file and open the next one
+ */
+void
+dump_writer_rotate(dump_writer_t *writer);
+
+/**
+ * @brief Write all data at the given file offset
+ *
+ * @return 0 if all data has been written, 1 on write error
+ */
+int
+dump_write(int fd, const u_char *data, size_t len, off_t offset);
+
+/**
+ * @brief Free a dump record
+ */
+void
+dump_record_destroyer(void *record);
+
 /**
  * @brief Get datalink header size
  *
@@ -502,6 +936,15 @@ dump_open(const char *dumpfile, ino_t* dump_inode);
 void
 dump_packet(pcap_dumper_t *pd, const packet_t *packet);
 
+/**
+ * @brief Store a packet in dump file without flushing it
+ *
+ * Used when storing many packets at once. Pending data is written
+ * when the file is closed.
+ */
+void
+dump_packet_frames(pcap_dumper_t *pd, const packet_t *packet);
+
 /**
  * @brief Close a dump file
  */
@@ -46,6 +46,9 @@
 #include <netdb.h>
 #include <unistd.h>
 #include <pcap.h>
+#ifdef HAVE_EPOLL_CREATE1
+#include <sys/epoll.h>
+#endif
 #include "capture_eep.h"
 #include "util.h"
 #include "setting.h"
@@ -55,6 +58,12 @@ capture_eep_config_t eep_cfg = { 0 };
 void *
 accept_eep_client(void *info);
 
+static void *
+capture_eep_send_thread(void *data);
+
+static void
+capture_eep_buf_destroyer(void *item);
+
 int
 capture_eep_init()
 {
@@ -92,6 +101,25 @@ capture_eep_init()
                 return 1;
             }
         }
+
+        // Create queues for frames pending to be sent and buffers to be reused
+        eep_cfg.send_queue = queue_create(setting_get_intvalue(SETTING_EEP_SEND_QUEUE));
+        eep_cfg.send_free = queue_create(setting_get_intvalue(SETTING_EEP_SEND_QUEUE));
+        if (!eep_cfg.send_queue || !eep_cfg.send_free) {
+            fprintf(stderr, "Can't allocate memory for EEP send queue!\n");
+            return 1;
+        }
+        queue_set_destroyer(eep_cfg.send_queue, capture_eep_buf_destroyer);
+        queue_set_destroyer(eep_cfg.send_free, capture_eep_buf_destroyer);
+
+        // Start the sender thread
+        sem_init(&eep_cfg.send_sem, 0, 0);
+        atomic_store(&eep_cfg.send_running, true);
+        if (pthread_create(&eep_cfg.send_thread, NULL, capture_eep_send_thread, NULL) != 0) {
+            fprintf(stderr, "Unable to create EEP sender thread!\n");
+            atomic_store(&eep_cfg.send_running, false);
+            return 1;
+        }
     }
 
     if (setting_enabled(SETTING_EEP_LISTEN)) {
@@ -100,11 +128,27 @@ capture_eep_init()
         eep_cfg.capt_srv_host = setting_get_value(SETTING_EEP_LISTEN_ADDR);
         eep_cfg.capt_srv_port = setting_get_value(SETTING_EEP_LISTEN_PORT);
         eep_cfg.capt_srv_password = setting_get_value(SETTING_EEP_LISTEN_PASS);
+        eep_cfg.capt_srv_tcp = setting_has_value(SETTING_EEP_LISTEN_PROTO, "tcp");
+        eep_cfg.capt_srv_timeout = setting_get_intvalue(SETTING_EEP_LISTEN_TIMEOUT);
+        eep_cfg.capt_srv_maxconn = setting_get_intvalue(SETTING_EEP_LISTEN_MAXCONN);
+
+        if (eep_cfg.capt_srv_tcp) {
+#ifdef HAVE_EPOLL_CREATE1
+            // Only HEP3 frames contain the length required to split a stream
+            if (eep_cfg.capt_srv_version != 3) {
+                fprintf(stderr, "EEP server: TCP transport requires HEP version 3\n");
+                return 1;
+            }
+#else
+            fprintf(stderr, "EEP server: sngrep is not compiled with TCP listen support\n");
+            return 1;
+#endif
+        }
 
         hints->ai_flags = AI_NUMERICSERV;
         hints->ai_family = AF_UNSPEC;
-        hints->ai_socktype = SOCK_DGRAM;
-        hints->ai_protocol = IPPROTO_UDP;
+        hints->ai_socktype = (eep_cfg.capt_srv_tcp) ? SOCK_STREAM : SOCK_DGRAM;
+        hints->ai_protocol = (eep_cfg.capt_srv_tcp) ? IPPROTO_TCP : IPPROTO_UDP;
 
         if (getaddrinfo(eep_cfg.capt_srv_host, eep_cfg.capt_srv_port, hints, &ai)) {
             fprintf(stderr, "EEP server: failed getaddrinfo() for %s:%s\n",
@@ -112,19 +156,33 @@ capture_eep_init()
             return 1;
         }
 
-        // Create a socket for a new TCP IPv4 connection
-        eep_cfg.server_sock = socket(AF_INET, SOCK_DGRAM, 0);
-        if (eep_cfg.client_sock < 0) {
+        // Create a socket for a new connection
+        eep_cfg.server_sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (eep_cfg.server_sock < 0) {
             fprintf(stderr, "Error creating server socket: %s\n", strerror(errno));
             return 1;
         }
 
+        if (eep_cfg.capt_srv_tcp) {
+            int reuse = 1;
+            setsockopt(eep_cfg.server_sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        }
+
         // Bind that socket to the requested address and port
         if (bind(eep_cfg.server_sock, ai->ai_addr, ai->ai_addrlen) == -1) {
             fprintf(stderr, "Error binding address: %s\n", strerror(errno));
             return 1;
         }
 
+        // Start accepting sender connections
+        if (eep_cfg.capt_srv_tcp) {
+            if (listen(eep_cfg.server_sock, SOMAXCONN) == -1) {
+                fprintf(stderr, "Error listening on server socket: %s\n", strerror(errno));
+                return 1;
+            }
+            fcntl(eep_cfg.server_sock, F_SETFL, fcntl(eep_cfg.server_sock, F_GETFL) | O_NONBLOCK);
+        }
+
         capture_info_t *capinfo;
 
         // Create a new structure to handle this capture source
@@ -134,7 +192,11 @@ capture_eep_init()
         }
 
         // Set capture thread function
+#ifdef HAVE_EPOLL_CREATE1
+        capinfo->capture_fn = (eep_cfg.capt_srv_tcp) ? accept_eep_tcp_client : accept_eep_client;
+#else
         capinfo->capture_fn = accept_eep_client;
+#endif
         capinfo->ispcap = false;
 
         // Open capture device
@@ -155,13 +217,13 @@ capture_eep_init()
 
         // Add this capture information as packet source
         capture_add_source(capinfo);
+        eep_cfg.capinfo = capinfo;
     }
 
     // Settings for EEP server
     return 0;
 }
 
-
 void *
 accept_eep_client(void *info)
 {
@@ -171,19 +233,211 @@ accept_eep_client(void *info)
     // Begin accepting connections
     while (eep_cfg.server_sock > 0) {
         if ((pkt = capture_eep_receive())) {
-            // Avoid parsing from multiples sources.
-            // Avoid parsing while screen in being redrawn
-            capture_lock();
-            if (capture_packet_parse(pkt) != 0) {
-                packet_destroy(pkt);
-            }
+            capture_eep_store(pkt);
+        }
+    }
 
-            // Store this packets in output file
-            capture_dump_packet(pkt);
+    // Mark capture as not longer running
+    capinfo->running = false;
 
-            capture_unlock();
+    // Leave the thread gracefully
+    pthread_exit(NULL);
+    return 0;
+}
+
+#ifdef HAVE_EPOLL_CREATE1
+/**
+ * @brief Close a TCP sender connection
+ *
+ * Closing the socket also removes it from the epoll set.
+ *
+ * @param item Connection structure pointer
+ */
+static void
+capture_eep_tcp_conn_destroyer(void *item)
+{
+    capture_eep_conn_t *conn = (capture_eep_conn_t *) item;
+    close(conn->fd);
+    sng_free(conn);
+}
+
+/**
+ * @brief Accept all pending connections in the listen socket
+ *
+ * @param efd epoll file descriptor
+ */
+static void
+capture_eep_tcp_accept(int efd)
+{
+    int fd;
+    capture_eep_conn_t *conn;
+    struct epoll_event ev = { 0 };
+
+    while ((fd = accept(eep_cfg.server_sock, NULL, NULL)) != -1) {
+        // Refuse connections over the configured limit
+        if (eep_cfg.capt_srv_maxconn > 0
+            && vector_count(eep_cfg.tcp_conns) >= eep_cfg.capt_srv_maxconn) {
+            close(fd);
+            continue;
         }
+
+        if (!(conn = sng_malloc(sizeof(capture_eep_conn_t)))) {
+            close(fd);
+            continue;
+        }
+
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        conn->fd = fd;
+        conn->last_seen = time(NULL);
+
+        ev.events = EPOLLIN;
+        ev.data.ptr = conn;
+        if (epoll_ctl(efd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+            capture_eep_tcp_conn_destroyer(conn);
+            continue;
+        }
+
+        vector_append(eep_cfg.tcp_conns, conn);
     }
+}
+
+/**
+ * @brief Read available data from a sender connection
+ *
+ * Received data is appended to the connection buffer and every complete
+ * HEP3 frame is parsed directly from there. Only the trailing incomplete
+ * frame (if any) is moved back to the beginning of the buffer.
+ *
+ * At most one buffer of data is read per call, so busy senders can not
+ * starve the rest of connections sharing the capture thread.
+ *
+ * @param conn Connection structure pointer
+ * @return 0 if connection is still valid, 1 if it must be closed
+ */
+static int
+capture_eep_tcp_read(capture_eep_conn_t *conn)
+{
+    ssize_t rlen;
+    uint32_t pos = 0, frame_len;
+    hep_ctrl_t ctrl;
+    packet_t *pkt;
+
+    rlen = recv(conn->fd, conn->buffer + conn->len, sizeof(conn->buffer) - conn->len, 0);
+
+    // Remote sender closed the connection
+    if (rlen == 0)
+        return 1;
+
+    if (rlen < 0)
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : 1;
+
+    conn->len += rlen;
+    conn->last_seen = time(NULL);
+
+    // Parse all complete frames in the buffer
+    while (conn->len - pos >= sizeof(hep_ctrl_t)) {
+        memcpy(&ctrl, conn->buffer + pos, sizeof(hep_ctrl_t));
+
+        // Stream is not synchronized with frames anymore
+        if (memcmp(ctrl.id, "\x48\x45\x50\x33", 4) != 0)
+            return 1;
+
+        frame_len = ntohs(ctrl.length);
+        if (frame_len < sizeof(hep_ctrl_t))
+            return 1;
+
+        // Wait for the rest of the frame
+        if (conn->len - pos < frame_len)
+            break;
+
+        if ((pkt = capture_eep_receive_v3(conn->buffer + pos, frame_len))) {
+            capture_eep_store(pkt);
+        }
+
+        pos += frame_len;
+    }
+
+    // Move incomplete frame data to the beginning of the buffer
+    if (pos > 0) {
+        memmove(conn->buffer, conn->buffer + pos, conn->len - pos);
+        conn->len -= pos;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Close sender connections without activity
+ *
+ * @param now Current time
+ */
+static void
+capture_eep_tcp_expire(time_t now)
+{
+    int i;
+    capture_eep_conn_t *conn;
+
+    if (eep_cfg.capt_srv_timeout <= 0)
+        return;
+
+    for (i = vector_count(eep_cfg.tcp_conns) - 1; i >= 0; i--) {
+        conn = vector_item(eep_cfg.tcp_conns, i);
+        if (now - conn->last_seen >= eep_cfg.capt_srv_timeout) {
+            vector_remove(eep_cfg.tcp_conns, conn);
+        }
+    }
+}
+
+void *
+accept_eep_tcp_client(void *info)
+{
+    int efd, nfds, i;
+    time_t now, last_expire = time(NULL);
+    capture_eep_conn_t *conn;
+    struct epoll_event ev = { 0 }, events[EEP_TCP_MAX_EVENTS];
+    capture_info_t *capinfo = (capture_info_t *) info;
+
+    // Connections are closed when removed from the vector
+    eep_cfg.tcp_conns = vector_create(0, 10);
+    vector_set_destroyer(eep_cfg.tcp_conns, capture_eep_tcp_conn_destroyer);
+
+    if ((efd = epoll_create1(EPOLL_CLOEXEC)) != -1) {
+        // Listen socket events are identified by a NULL data pointer
+        ev.events = EPOLLIN;
+        ev.data.ptr = NULL;
+        if (epoll_ctl(efd, EPOLL_CTL_ADD, eep_cfg.server_sock, &ev) == -1) {
+            close(efd);
+            efd = -1;
+        }
+    }
+
+    while (efd != -1 && eep_cfg.server_sock > 0) {
+        // Wake up at least once per second to check idle connections
+        nfds = epoll_wait(efd, events, EEP_TCP_MAX_EVENTS, 1000);
+        if (nfds == -1 && errno != EINTR)
+            break;
+
+        for (i = 0; i < nfds; i++) {
+            if (!(conn = events[i].data.ptr)) {
+                capture_eep_tcp_accept(efd);
+            } else if (events[i].events & (EPOLLERR | EPOLLHUP) && !(events[i].events & EPOLLIN)) {
+                vector_remove(eep_cfg.tcp_conns, conn);
+            } else if (capture_eep_tcp_read(conn) != 0) {
+                vector_remove(eep_cfg.tcp_conns, conn);
+            }
+        }
+
+        if ((now = time(NULL)) != last_expire) {
+            capture_eep_tcp_expire(now);
+            last_expire = now;
+        }
+    }
+
+    // Close all remaining connections
+    vector_destroy(eep_cfg.tcp_conns);
+    eep_cfg.tcp_conns = NULL;
+    if (efd != -1)
+        close(efd);
 
     // Mark capture as not longer running
     capinfo->running = false;
@@ -192,10 +446,22 @@ accept_eep_client(void *info)
     pthread_exit(NULL);
     return 0;
 }
+#endif
 
 void
 capture_eep_deinit()
 {
+    // Stop sender thread
+    if (atomic_exchange(&eep_cfg.send_running, false)) {
+        sem_post(&eep_cfg.send_sem);
+        pthread_join(eep_cfg.send_thread, NULL);
+        sem_destroy(&eep_cfg.send_sem);
+    }
+
+    queue_destroy(eep_cfg.send_queue);
+    queue_destroy(eep_cfg.send_free);
+    eep_cfg.send_queue = eep_cfg.send_free = NULL;
+
     if (eep_cfg.client_sock)
         close(eep_cfg.client_sock);
 
@@ -217,38 +483,179 @@ capture_eep_listen_port()
     return eep_cfg.capt_srv_port;
 }
 
+/**
+ * @brief Make sure the buffer can store the given number of bytes
+ *
+ * @return 0 if buffer has enough memory, 1 otherwise
+ */
+static int
+capture_eep_buf_reserve(capture_eep_buf_t *buf, uint32_t size)
+{
+    u_char *data;
+
+    if (buf->size >= size)
+        return 0;
+
+    if (!(data = realloc(buf->data, size)))
+        return 1;
+
+    buf->data = data;
+    buf->size = size;
+    return 0;
+}
+
+/**
+ * @brief Free a frame buffer memory
+ */
+static void
+capture_eep_buf_destroyer(void *item)
+{
+    capture_eep_buf_t *buf = (capture_eep_buf_t *) item;
+    free(buf->data);
+    sng_free(buf);
+}
+
+/**
+ * @brief Send queued frames through the client socket
+ *
+ * Frames are popped from the send queue in batches and sent with a
+ * single system call when possible. Sent buffers are passed back to
+ * the capture threads for reuse.
+ */
+static void *
+capture_eep_send_thread(void *data)
+{
+    capture_eep_buf_t *bufs[EEP_SEND_BATCH], *dropped;
+#ifdef HAVE_SENDMMSG
+    struct mmsghdr msgs[EEP_SEND_BATCH];
+    struct iovec iovs[EEP_SEND_BATCH];
+    int ret;
+#endif
+    struct timespec ts;
+    int count, sent, i;
+
+    while (atomic_load(&eep_cfg.send_running)) {
+        // Get next batch of pending frames
+        for (count = 0; count < EEP_SEND_BATCH; count++) {
+            if (!(bufs[count] = queue_pop(eep_cfg.send_queue)))
+                break;
+        }
+
+        if (count == 0) {
+            // Request a notification for the next queued frame
+            atomic_store(&eep_cfg.send_waiting, 1);
+            // Frames may have been queued before the request was done
+            if (queue_count(eep_cfg.send_queue) == 0) {
+                clock_gettime(CLOCK_REALTIME, &ts);
+                ts.tv_nsec += 100 * 1000 * 1000;
+                if (ts.tv_nsec >= 1000 * 1000 * 1000) {
+                    ts.tv_sec++;
+                    ts.tv_nsec -= 1000 * 1000 * 1000;
+                }
+                sem_timedwait(&eep_cfg.send_sem, &ts);
+            }
+            atomic_store(&eep_cfg.send_waiting, 0);
+            continue;
+        }
+
+#ifdef HAVE_SENDMMSG
+        memset(msgs, 0, sizeof(struct mmsghdr) * count);
+        for (i = 0; i < count; i++) {
+            iovs[i].iov_base = bufs[i]->data;
+            iovs[i].iov_len = bufs[i]->len;
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        for (sent = 0; sent < count;) {
+            ret = sendmmsg(eep_cfg.client_sock, msgs + sent, count - sent, 0);
+            if (ret == -1 && errno == EINTR)
+                continue;
+            if (ret <= 0) {
+                // Skip the frame that can not be sent
+                atomic_fetch_add(&eep_cfg.send_dropped, 1);
+                sent++;
+                continue;
+            }
+            atomic_fetch_add(&eep_cfg.send_sent, ret);
+            sent += ret;
+        }
+#else
+        for (sent = 0; sent < count; sent++) {
+            if (send(eep_cfg.client_sock, bufs[sent]->data, bufs[sent]->len, 0) == -1) {
+                atomic_fetch_add(&eep_cfg.send_dropped, 1);
+            } else {
+                atomic_fetch_add(&eep_cfg.send_sent, 1);
+            }
+        }
+#endif
+
+        // Return buffers for reuse
+        for (i = 0; i < count; i++) {
+            if ((dropped = queue_push(eep_cfg.send_free, bufs[i]))) {
+                capture_eep_buf_destroyer(dropped);
+            }
+        }
+    }
+
+    return NULL;
+}
+
 int
 capture_eep_send(packet_t *pkt)
 {
+    capture_eep_buf_t *buf, *dropped;
+    int ret = 1;
+
     // Dont send RTP packets
     if (pkt->type == PACKET_RTP)
         return 1;
 
     // Check we have a connection established
-    if (!eep_cfg.client_sock)
+    if (!eep_cfg.client_sock || !eep_cfg.send_queue)
         return 1;
 
+    // Reuse a buffer already sent or create a new one
+    if (!(buf = queue_pop(eep_cfg.send_free))) {
+        if (!(buf = sng_malloc(sizeof(capture_eep_buf_t))))
+            return 1;
+    }
+
     switch (eep_cfg.capt_version) {
         case 2:
-            return capture_eep_send_v2(pkt);
+            ret = capture_eep_build_v2(pkt, buf);
+            break;
         case 3:
-            return capture_eep_send_v3(pkt);
+            ret = capture_eep_build_v3(pkt, buf);
+            break;
     }
-    return 1;
+
+    if (ret != 0) {
+        capture_eep_buf_destroyer(buf);
+        return 1;
+    }
+
+    // Queue the frame, dropping the oldest one if queue is full
+    if ((dropped = queue_push(eep_cfg.send_queue, buf))) {
+        atomic_fetch_add(&eep_cfg.send_dropped, 1);
+        capture_eep_buf_destroyer(dropped);
+    }
+    atomic_fetch_add(&eep_cfg.send_queued, 1);
+
+    // Wake up sender thread if it is waiting for frames
+    if (atomic_exchange(&eep_cfg.send_waiting, 0)) {
+        sem_post(&eep_cfg.send_sem);
+    }
+
+    return 0;
 }
 
-struct pcap_pkthdr
-capture_eep_build_frame_data(
-        const struct pcap_pkthdr header,
-        const unsigned char *payload,
-        const uint32_t payload_size,
-        const address_t src,
-        const address_t dst,
-        unsigned char **frame_payload
-) {
-    //! Frame variables
-    struct pcap_pkthdr frame_pcap_header;
+u_char *
+capture_eep_frame_data(const packet_t *pkt, const frame_t *frame)
+{
+    u_char *data;
     uint32_t frame_size = 0;
+    uint32_t payload_size = packet_payloadlen((packet_t *) pkt);
 
     // Build frame ethernet header
     struct ether_header ether_hdr = {
@@ -265,41 +672,40 @@ capture_eep_build_frame_data(
         .ip_len = htons(sizeof(ip_hdr) + sizeof(struct udphdr) + payload_size),
         .ip_ttl = 128,
     };
-    inet_pton(AF_INET, src.ip, &ip_hdr.ip_src);
-    inet_pton(AF_INET, dst.ip, &ip_hdr.ip_dst);
+    inet_pton(AF_INET, pkt->src.ip, &ip_hdr.ip_src);
+    inet_pton(AF_INET, pkt->dst.ip, &ip_hdr.ip_dst);
 
     // Build frame UDP header
     struct udphdr udp_hdr = {
-        .uh_sport = htons(src.port),
-        .uh_dport = htons(dst.port),
+        .uh_sport = htons(pkt->src.port),
+        .uh_dport = htons(pkt->dst.port),
         .uh_ulen = htons(sizeof(struct udphdr) + payload_size),
     };
 
-    // Allocate memory for payload contents
-    *frame_payload = sng_malloc(sizeof(ether_hdr) + sizeof(ip_hdr) + sizeof(udp_hdr) + payload_size);
+    // Frame header must match the generated data
+    if (frame->header->caplen != EEP_FRAME_HEADERS_LEN + payload_size)
+        return NULL;
+
+    // Allocate memory for frame contents
+    if (!(data = malloc(frame->header->caplen)))
+        return NULL;
 
     // Append all headers to frame contents
-    memcpy(*frame_payload + frame_size, (void*) &ether_hdr, sizeof(ether_hdr));
+    memcpy(data + frame_size, (void*) &ether_hdr, sizeof(ether_hdr));
     frame_size += sizeof(ether_hdr);
-    memcpy(*frame_payload + frame_size, (void*) &ip_hdr, sizeof(ip_hdr));
+    memcpy(data + frame_size, (void*) &ip_hdr, sizeof(ip_hdr));
     frame_size += sizeof(ip_hdr);
-    memcpy(*frame_payload + frame_size, (void*) &udp_hdr, sizeof(udp_hdr));
+    memcpy(data + frame_size, (void*) &udp_hdr, sizeof(udp_hdr));
     frame_size += sizeof(udp_hdr);
-    memcpy(*frame_payload + frame_size, (void*) payload, payload_size);
-    frame_size += payload_size;
-
-    // Build a custom frame pcap header
-    frame_pcap_header.caplen = frame_size;
-    frame_pcap_header.len = frame_size;
-    frame_pcap_header.ts = header.ts;
+    memcpy(data + frame_size, (void*) pkt->payload, payload_size);
 
-    return frame_pcap_header;
+    return data;
 }
 
 int
-capture_eep_send_v2(packet_t *pkt)
+capture_eep_build_v2(packet_t *pkt, capture_eep_buf_t *buf)
 {
-    void* buffer;
+    u_char *buffer;
     uint32_t buflen = 0, tlen = 0;
     struct hep_hdr hdr;
     struct hep_timehdr hep_time;
@@ -348,9 +754,10 @@ capture_eep_send_v2(packet_t *pkt)
     tlen += len;
     hdr.hp_l = htons(tlen);
 
-    // Allocate memory for HEPv2 packet
-    if (!(buffer = sng_malloc(tlen)))
+    // Reserve memory for HEPv2 packet
+    if (capture_eep_buf_reserve(buf, tlen) != 0)
         return 1;
+    buffer = buf->data;
 
     // Copy basic headers
     buflen = 0;
@@ -377,21 +784,15 @@ capture_eep_send_v2(packet_t *pkt)
     memcpy((void*) buffer + buflen, data, len);
     buflen += len;
 
-    if (send(eep_cfg.client_sock, buffer, buflen, 0) == -1) {
-        return 1;
-    }
-
-    /* FREE */
-    sng_free(buffer);
-
-    return 1;
+    buf->len = buflen;
+    return 0;
 }
 
 int
-capture_eep_send_v3(packet_t *pkt)
+capture_eep_build_v3(packet_t *pkt, capture_eep_buf_t *buf)
 {
-    struct hep_generic *hg = NULL;
-    void* buffer;
+    struct hep_generic hep_generic, *hg = &hep_generic;
+    u_char *buffer;
     uint32_t buflen = 0, iplen = 0, tlen = 0;
     hep_chunk_ip4_t src_ip4, dst_ip4;
 #ifdef USE_IPV6
@@ -403,7 +804,7 @@ capture_eep_send_v3(packet_t *pkt)
     unsigned char *data = packet_payload(pkt);
     uint32_t len = packet_payloadlen(pkt);
 
-    hg = sng_malloc(sizeof(struct hep_generic));
+    memset(hg, 0, sizeof(struct hep_generic));
 
     /* header set "HEP3" */
     memcpy(hg->header.id, "\x48\x45\x50\x33", 4);
@@ -513,10 +914,10 @@ capture_eep_send_v3(packet_t *pkt)
     /* total */
     hg->header.length = htons(tlen);
 
-    if (!(buffer = sng_malloc(tlen))) {
-        sng_free(hg);
+    if (capture_eep_buf_reserve(buf, tlen) != 0)
         return 1;
-    }
+    buffer = buf->data;
+
     memcpy((void*) buffer, hg, sizeof(struct hep_generic));
     buflen = sizeof(struct hep_generic);
 
@@ -561,14 +962,32 @@ capture_eep_send_v3(packet_t *pkt)
     memcpy((void*) buffer + buflen, data, len);
     buflen += len;
 
-    if (send(eep_cfg.client_sock, buffer, buflen, 0) == -1) {
-        return 1;
+    buf->len = buflen;
+    return 0;
+}
+
+void
+capture_eep_send_stats(capture_eep_send_stats_t *stats)
+{
+    stats->queued = atomic_load(&eep_cfg.send_queued);
+    stats->sent = atomic_load(&eep_cfg.send_sent);
+    stats->dropped = atomic_load(&eep_cfg.send_dropped);
+    stats->pending = (eep_cfg.send_queue) ? queue_count(eep_cfg.send_queue) : 0;
+}
+
+
+void
+capture_eep_store(packet_t *pkt)
+{
+    frame_t *frame;
+
+    // Update server source counters
+    if (eep_cfg.capinfo && (frame = vector_first(pkt->frames))) {
+        metrics_source_captured(&eep_cfg.capinfo->metrics, frame->header->caplen);
+        metrics_source_parsed(&eep_cfg.capinfo->metrics);
     }
 
-    /* FREE */
-    sng_free(buffer);
-    sng_free(hg);
-    return 0;
+    capture_packet_store(pkt);
 }
 
 packet_t *
@@ -588,7 +1007,7 @@ capture_eep_receive_v2()
 {
     uint8_t family, proto;
     unsigned char *payload = 0;
-    uint32_t pos;
+    uint32_t pos, payload_len;
     char buffer[MAX_CAPTURE_LEN] ;
     //! Source Address
     address_t src;
@@ -604,9 +1023,6 @@ capture_eep_receive_v2()
     struct hep_hdr hdr;
     struct hep_timehdr hep_time;
     struct hep_iphdr hep_ipheader;
-    //! Frame contents
-    struct pcap_pkthdr frame_pcap_header;
-    unsigned char *frame_payload;
 #ifdef USE_IPV6
     struct hep_ip6hdr hep_ip6header;
 #endif
@@ -663,32 +1079,46 @@ capture_eep_receive_v2()
     /* Capture ID */
 
     // Calculate payload size (Total size - headers size)
-    header.caplen = header.len = ntohs(hdr.hp_l) - pos;
-
-    // Copy packet payload
-    payload = sng_malloc(header.caplen + 1);
-    memcpy(payload, (void*) buffer + pos, header.caplen);
-
-    // Build a custom frame pcap header
-    frame_pcap_header = capture_eep_build_frame_data(header, payload,header.caplen, src, dst, &frame_payload);
+    payload_len = ntohs(hdr.hp_l) - pos;
+    payload = (unsigned char *) buffer + pos;
 
     // Create a new packet
     pkt = packet_create((family == AF_INET) ? 4 : 6, proto, src, dst, 0);
-    packet_add_frame(pkt, &frame_pcap_header, frame_payload);
     packet_set_transport_data(pkt, src.port, dst.port);
     packet_set_type(pkt, PACKET_SIP_UDP);
-    packet_set_payload(pkt, payload, header.caplen);
+    packet_set_payload(pkt, payload, payload_len);
 
-    // We don't longer require frame payload anymore, because adding the frame to packet clones its memory
-    sng_free(frame_payload);
+    // Frame contents will only be generated if this packet is stored
+    header.caplen = header.len = EEP_FRAME_HEADERS_LEN + payload_len;
+    packet_add_synthetic_frame(pkt, &header);
 
-    /* FREE */
-    sng_free(payload);
     return pkt;
 
 }
 
 
+/**
+ * @brief Read a 16 bits network order value from received data
+ */
+static inline uint16_t
+capture_eep_read16(const u_char *data)
+{
+    uint16_t value;
+    memcpy(&value, data, sizeof(value));
+    return ntohs(value);
+}
+
+/**
+ * @brief Read a 32 bits network order value from received data
+ */
+static inline uint32_t
+capture_eep_read32(const u_char *data)
+{
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return ntohl(value);
+}
+
 /**
  * @brief Received a HEP3 packet
  *
@@ -696,73 +1126,67 @@ capture_eep_receive_v2()
  * to a Packet information. This code has been updated based on
  * Kamailio sipcapture module.
  *
+ * Chunks are read in place from the received data, checking that
+ * each one fits in the packet. SIP payload is copied only once into
+ * the new packet and the pcap frame is not built until required.
+ *
  * @return packet pointer
  */
 packet_t *
 capture_eep_receive_v3(const u_char *pkt, uint32_t size)
 {
-
-    struct hep_generic hg;
-    hep_chunk_ip4_t src_ip4, dst_ip4;
-#ifdef USE_IPV6
-    hep_chunk_ip6_t src_ip6, dst_ip6;
-#endif
-    hep_chunk_t payload_chunk;
-    hep_chunk_t authkey_chunk;
-    char password[100];
-    int password_len;
-    unsigned char *payload = 0;
-    uint32_t total_len, pos;
-    char buffer[MAX_CAPTURE_LEN] ;
+    u_char recvbuf[EEP_MAX_FRAME_LEN];
+    const u_char *buffer, *chunk, *data;
+    const u_char *payload = NULL, *password = NULL;
+    uint32_t total_len, pos, chunk_len, data_len;
+    uint32_t payload_len = 0, password_len = 0;
+    uint16_t chunk_vendor, chunk_type;
+    uint8_t family = 0, proto = 0;
+    ssize_t recvlen;
     //! Source and Destination Address
-    address_t src, dst;
+    address_t src = { }, dst = { };
     //! EEP client data
     struct sockaddr_storage eep_client;
-    socklen_t eep_client_len=sizeof(eep_client);
+    socklen_t eep_client_len = sizeof(eep_client);
     //! Packet header
-    struct pcap_pkthdr header;
+    struct pcap_pkthdr header = { };
     //! New created packet pointer
     packet_t *pkt_new;
-    //! Frame contents
-    struct pcap_pkthdr frame_pcap_header;
-    unsigned char *frame_payload;
 
-    if(!pkt) {
+    if (!pkt) {
         /* Receive EEP generic header */
-        if (recvfrom(eep_cfg.server_sock, buffer, MAX_CAPTURE_LEN, 0, (struct sockaddr*)&eep_client, &eep_client_len) == -1)
+        if ((recvlen = recvfrom(eep_cfg.server_sock, recvbuf, sizeof(recvbuf), 0, (struct sockaddr*)&eep_client, &eep_client_len)) == -1)
             return NULL;
+        buffer = recvbuf;
+        size = recvlen;
     } else {
-        memcpy(&buffer, pkt, size);
+        // Parse given data in place
+        buffer = pkt;
     }
 
-    // Initialize structs
-    memset(&hg, 0, sizeof(hep_generic_t));
-    memset(&password, 0, sizeof(password));
-    memset(&src, 0, sizeof(address_t));
-    memset(&dst, 0, sizeof(address_t));
-    memset(&header, 0, sizeof(struct pcap_pkthdr));
-
-    /* Copy initial bytes to EEP Generic header */
-    memcpy(&hg.header, buffer, sizeof(struct hep_generic));
+    // Not enough data for a HEP header
+    if (size < sizeof(hep_ctrl_t))
+        return NULL;
 
     /* header check */
-    if (memcmp(hg.header.id, "\x48\x45\x50\x33", 4) != 0)
+    if (memcmp(buffer, "\x48\x45\x50\x33", 4) != 0)
         return NULL;
 
-    total_len = ntohs(hg.header.length);
-    pos = sizeof(hep_ctrl_t);
-
-    while (pos < total_len) {
+    /* Truncated packet */
+    total_len = capture_eep_read16(buffer + offsetof(hep_ctrl_t, length));
+    if (total_len > size)
+        return NULL;
 
-        hep_chunk_t *chunk = (struct hep_chunk*) (buffer + pos);
-        int chunk_vendor = ntohs(chunk->vendor_id);
-        int chunk_type = ntohs(chunk->type_id);
-        int chunk_len = ntohs(chunk->length);
+    pos = sizeof(hep_ctrl_t);
+    while (pos + sizeof(hep_chunk_t) <= total_len) {
+        chunk = buffer + pos;
+        chunk_vendor = capture_eep_read16(chunk + offsetof(hep_chunk_t, vendor_id));
+        chunk_type = capture_eep_read16(chunk + offsetof(hep_chunk_t, type_id));
+        chunk_len = capture_eep_read16(chunk + offsetof(hep_chunk_t, length));
 
         /* Bad length, drop packet */
-        if (chunk_len == 0) {
+        if (chunk_len < sizeof(hep_chunk_t) || chunk_len > total_len - pos)
             return NULL;
-        }
 
         /* Skip not general chunks */
         if (chunk_vendor != 0) {
@@ -770,70 +1194,77 @@ capture_eep_receive_v3(const u_char *pkt, uint32_t size)
             continue;
         }
 
+        // Chunk contents
+        data = chunk + sizeof(hep_chunk_t);
+        data_len = chunk_len - sizeof(hep_chunk_t);
+
         switch (chunk_type) {
             case CAPTURE_EEP_CHUNK_INVALID:
                 return NULL;
             case CAPTURE_EEP_CHUNK_FAMILY:
-                memcpy(&hg.ip_family, (void*) buffer + pos, sizeof(hep_chunk_uint8_t));
+                if (data_len < sizeof(uint8_t))
+                    return NULL;
+                family = *data;
                 break;
             case CAPTURE_EEP_CHUNK_PROTO:
-                memcpy(&hg.ip_proto, (void*) buffer + pos, sizeof(hep_chunk_uint8_t));
+                if (data_len < sizeof(uint8_t))
+                    return NULL;
+                proto = *data;
                 break;
             case CAPTURE_EEP_CHUNK_SRC_IP4:
-                memcpy(&src_ip4, (void*) buffer + pos, sizeof(struct hep_chunk_ip4));
-                inet_ntop(AF_INET, &src_ip4.data, src.ip, sizeof(src.ip));
+                if (data_len < sizeof(struct in_addr))
+                    return NULL;
+                inet_ntop(AF_INET, data, src.ip, sizeof(src.ip));
                 break;
             case CAPTURE_EEP_CHUNK_DST_IP4:
-                memcpy(&dst_ip4, (void*) buffer + pos, sizeof(struct hep_chunk_ip4));
-                inet_ntop(AF_INET, &dst_ip4.data, dst.ip, sizeof(src.ip));
+                if (data_len < sizeof(struct in_addr))
+                    return NULL;
+                inet_ntop(AF_INET, data, dst.ip, sizeof(dst.ip));
                 break;
 #ifdef USE_IPV6
             case CAPTURE_EEP_CHUNK_SRC_IP6:
-                memcpy(&src_ip6, (void*) buffer + pos, sizeof(struct hep_chunk_ip6));
-                inet_ntop(AF_INET6, &src_ip6.data, src.ip, sizeof(src.ip));
+                if (data_len < sizeof(struct in6_addr))
+                    return NULL;
+                inet_ntop(AF_INET6, data, src.ip, sizeof(src.ip));
                 break;
             case CAPTURE_EEP_CHUNK_DST_IP6:
-                memcpy(&dst_ip6, (void*) buffer + pos, sizeof(struct hep_chunk_ip6));
-                inet_ntop(AF_INET6, &dst_ip6.data, dst.ip, sizeof(dst.ip));
+                if (data_len < sizeof(struct in6_addr))
+                    return NULL;
+                inet_ntop(AF_INET6, data, dst.ip, sizeof(dst.ip));
                 break;
 #endif
             case CAPTURE_EEP_CHUNK_SRC_PORT:
-                memcpy(&hg.src_port, (void*) buffer + pos, sizeof(hep_chunk_uint16_t));
-                src.port = ntohs(hg.src_port.data);
+                if (data_len < sizeof(uint16_t))
+                    return NULL;
+                src.port = capture_eep_read16(data);
                 break;
             case CAPTURE_EEP_CHUNK_DST_PORT:
-                memcpy(&hg.dst_port, (void*) buffer + pos, sizeof(hep_chunk_uint16_t));
-                dst.port = ntohs(hg.dst_port.data);
+                if (data_len < sizeof(uint16_t))
+                    return NULL;
+                dst.port = capture_eep_read16(data);
                 break;
             case CAPTURE_EEP_CHUNK_TS_SEC:
-                memcpy(&hg.time_sec, (void*) buffer + pos, sizeof(hep_chunk_uint32_t));
-                header.ts.tv_sec = ntohl(hg.time_sec.data);
+                if (data_len < sizeof(uint32_t))
+                    return NULL;
+                header.ts.tv_sec = capture_eep_read32(data);
                 break;
             case CAPTURE_EEP_CHUNK_TS_USEC:
-                memcpy(&hg.time_usec, (void*) buffer + pos, sizeof(hep_chunk_uint32_t));
-                header.ts.tv_usec = ntohl(hg.time_usec.data);
-                break;
-            case CAPTURE_EEP_CHUNK_PROTO_TYPE:
-                memcpy(&hg.proto_t, (void*) buffer + pos, sizeof(hep_chunk_uint8_t));
-                break;
-            case CAPTURE_EEP_CHUNK_CAPT_ID:
-                memcpy(&hg.capt_id, (void*) buffer + pos, sizeof(hep_chunk_uint32_t));
-                break;
-            case CAPTURE_EEP_CHUNK_KEEP_TM:
+                if (data_len < sizeof(uint32_t))
+                    return NULL;
+                header.ts.tv_usec = capture_eep_read32(data);
                 break;
             case CAPTURE_EEP_CHUNK_AUTH_KEY:
-                memcpy(&authkey_chunk, (void*) buffer + pos, sizeof(authkey_chunk));
-                password_len = ntohs(authkey_chunk.length) - sizeof(authkey_chunk);
-                memcpy(password, (void*) buffer + pos + sizeof(hep_chunk_t), password_len);
+                password = data;
+                password_len = data_len;
                 break;
             case CAPTURE_EEP_CHUNK_PAYLOAD:
-                memcpy(&payload_chunk, (void*) buffer + pos, sizeof(payload_chunk));
-                header.caplen = header.len = chunk_len - sizeof(hep_chunk_t);
-                payload = sng_malloc(header.caplen);
-                memcpy(payload, (void*) buffer + pos + sizeof(hep_chunk_t), header.caplen);
+                payload = data;
+                payload_len = data_len;
                 break;
+            case CAPTURE_EEP_CHUNK_PROTO_TYPE:
+            case CAPTURE_EEP_CHUNK_CAPT_ID:
+            case CAPTURE_EEP_CHUNK_KEEP_TM:
             case CAPTURE_EEP_CHUNK_CORRELATION_ID:
-                break;
             default:
                 break;
         }
@@ -845,27 +1276,23 @@ capture_eep_receive_v3(const u_char *pkt, uint32_t size)
     // Validate password
     if (eep_cfg.capt_srv_password != NULL) {
         // No password in packet
-        if (strlen(password) == 0)
+        if (!password)
             return NULL;
         // Check password matches configured
-        if (strncmp(password, eep_cfg.capt_srv_password, strlen(eep_cfg.capt_srv_password)) != 0)
+        if (password_len != strlen(eep_cfg.capt_srv_password)
+            || memcmp(password, eep_cfg.capt_srv_password, password_len) != 0)
             return NULL;
     }
 
-    // Build a custom frame pcap header
-    frame_pcap_header = capture_eep_build_frame_data(header, payload,header.caplen, src, dst, &frame_payload);
-
     // Create a new packet
-    pkt_new = packet_create((hg.ip_family.data == AF_INET)?4:6, hg.ip_proto.data, src, dst, 0);
-    packet_add_frame(pkt_new, &frame_pcap_header, frame_payload);
+    pkt_new = packet_create((family == AF_INET) ? 4 : 6, proto, src, dst, 0);
     packet_set_type(pkt_new, PACKET_SIP_UDP);
-    packet_set_payload(pkt_new, payload, header.caplen);
+    packet_set_payload(pkt_new, (u_char *) payload, payload_len);
 
-    // We don't longer require frame payload anymore, because adding the frame to packet clones its memory
-    sng_free(frame_payload);
+    // Frame contents will only be generated if this packet is stored
+    header.caplen = header.len = EEP_FRAME_HEADERS_LEN + payload_len;
+    packet_add_synthetic_frame(pkt_new, &header);
 
-    /* FREE */
-    sng_free(payload);
     return pkt_new;
 }
 
@@ -873,14 +1300,18 @@ int
 capture_eep_set_server_url(const char *url)
 {
     char urlstr[256];
-    char address[ADDRESSLEN + 1], port[6];
+    char proto[4], address[ADDRESSLEN + 1], port[6];
 
+    memset(proto, 0, sizeof(proto));
     memset(address, 0, sizeof(address));
     memset(port, 0, sizeof(port));
 
     strncpy(urlstr, url, sizeof(urlstr));
-    if (sscanf(urlstr, "%*[^:]:%" STRINGIFY(ADDRESSLEN) "[^:]:%5s", address, port) == 2) {
+    if (sscanf(urlstr, "%3[^:]:%" STRINGIFY(ADDRESSLEN) "[^:]:%5s", proto, address, port) == 3) {
+        if (strcmp(proto, "udp") && strcmp(proto, "tcp"))
+            return 1;
         setting_set_value(SETTING_EEP_LISTEN, SETTING_ON);
+        setting_set_value(SETTING_EEP_LISTEN_PROTO, proto);
         setting_set_value(SETTING_EEP_LISTEN_ADDR, address);
         setting_set_value(SETTING_EEP_LISTEN_PORT, port);
         return 0;
@@ -42,7 +42,22 @@
 #ifndef __SNGREP_CAPTURE_EEP_H
 #define __SNGREP_CAPTURE_EEP_H
 #include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <time.h>
 #include "capture.h"
+#include "queue.h"
+
+//! Max HEP3 frame size (total length field is 16 bits)
+#define EEP_MAX_FRAME_LEN 65535
+//! Per connection buffer size for HEP over TCP streams
+#define EEP_TCP_BUFFER_LEN (EEP_MAX_FRAME_LEN + 1)
+//! Max number of events handled by each epoll_wait call
+#define EEP_TCP_MAX_EVENTS 64
+//! Max number of frames sent by the sender thread in one system call
+#define EEP_SEND_BATCH 32
+//! Size of headers of generated pcap frames for received packets
+#define EEP_FRAME_HEADERS_LEN (sizeof(struct ether_header) + sizeof(struct ip) + sizeof(struct udphdr))
 
 //! HEP chunk types
 enum
@@ -99,6 +114,92 @@ struct capture_eep_config
     const char *capt_srv_password;
     //! Server thread to parse incoming data
     pthread_t server_thread;
+    //! Receive HEP frames through a TCP stream instead of UDP datagrams
+    bool capt_srv_tcp;
+    //! Seconds before an inactive TCP sender connection is closed
+    int capt_srv_timeout;
+    //! Max number of concurrent TCP sender connections
+    int capt_srv_maxconn;
+    //! Active TCP sender connections
+    vector_t *tcp_conns;
+    //! Frames pending to be sent by the sender thread
+    queue_t *send_queue;
+    //! Frame buffers already sent, ready to be reused
+    queue_t *send_free;
+    //! Sender thread
+    pthread_t send_thread;
+    //! Flag to determine if sender thread must keep running
+    atomic_bool send_running;
+    //! Sender thread is waiting for new frames
+    atomic_int send_waiting;
+    //! Wake up sender thread when new frames are queued
+    sem_t send_sem;
+    //! Number of frames queued to be sent
+    atomic_ulong send_queued;
+    //! Number of frames sent
+    atomic_ulong send_sent;
+    //! Number of frames dropped (queue full or send failure)
+    atomic_ulong send_dropped;
+    //! Capture source of received packets
+    capture_info_t *capinfo;
+};
+
+//! Shorter declaration of capture_eep_buf structure
+typedef struct capture_eep_buf capture_eep_buf_t;
+
+/**
+ * @brief Reusable buffer for an encapsulated HEP frame
+ */
+struct capture_eep_buf
+{
+    //! Frame contents
+    u_char *data;
+    //! Frame length
+    uint32_t len;
+    //! Allocated size of data
+    uint32_t size;
+};
+
+//! Shorter declaration of capture_eep_send_stats structure
+typedef struct capture_eep_send_stats capture_eep_send_stats_t;
+
+/**
+ * @brief EEP client sender counters
+ */
+struct capture_eep_send_stats
+{
+    //! Frames queued to be sent
+    unsigned long queued;
+    //! Frames sent through client socket
+    unsigned long sent;
+    //! Frames dropped before being sent
+    unsigned long dropped;
+    //! Frames currently pending in the queue
+    unsigned long pending;
+};
+
+//! Shorter declaration of capture_eep_conn structure
+typedef struct capture_eep_conn capture_eep_conn_t;
+
+/**
+ * @brief HEP over TCP sender connection
+ *
+ * Each connected sender has a fixed size buffer where the stream is
+ * accumulated until a complete HEP3 frame is available. Since a frame
+ * can not exceed EEP_MAX_FRAME_LEN bytes, a slow sender can not make the
+ * buffer grow: once it is full no more data is read from that socket and
+ * TCP flow control throttles the sender.
+ */
+struct capture_eep_conn
+{
+    //! Connection socket
+    int fd;
+    //! Bytes pending to be parsed in buffer
+    uint32_t len;
+    //! Last time data was received through this connection
+    time_t last_seen;
+    //! Received stream data
+    u_char buffer[EEP_TCP_BUFFER_LEN];
 };
 
 /* HEPv3 types */
@@ -240,6 +341,21 @@ struct hep_ip6hdr
 int
 capture_eep_init();
 
+#ifdef HAVE_EPOLL_CREATE1
+/**
+ * @brief Accept and read HEP over TCP sender connections
+ *
+ * Capture thread function for EEP listen mode using TCP transport.
+ * All sender connections are multiplexed in a single epoll set and
+ * the received stream is split into HEP3 frames using the total length
+ * field of each frame header.
+ *
+ * @param info Capture information of the EEP source
+ */
+void *
+accept_eep_tcp_client(void *info);
+#endif
+
 /**
  * @brief Unitialize EEP process
  *
@@ -268,6 +384,10 @@ capture_eep_listen_port();
 /**
  * @brief Wrapper for sending packet in configured EEP version
  *
+ * The packet is encapsulated into a reusable buffer and queued for
+ * the sender thread, so this function never waits for the network.
+ * If the queue is full, the oldest pending frame is dropped.
+ *
  * @param pkt Packet Structure data
  * @return 1 on any error occurs, 0 otherwise
  */
@@ -275,30 +395,46 @@ int
 capture_eep_send(packet_t *pkt);
 
 /**
- * @brief Send a captured packet (EEP version 2)
+ * @brief Encapsulate a captured packet (EEP version 2)
  *
- * Send a packet encapsulated into EEP through the client socket.
- * This function will only handle SIP packets if EEP client mode
- * has been enabled.
+ * Build the EEP frame of the given packet into the buffer, growing
+ * its memory if required.
  *
  * @param pkt Packet Structure data
+ * @param buf Buffer where the frame will be stored
  * @return 1 on any error occurs, 0 otherwise
  */
 int
-capture_eep_send_v2(packet_t *pkt);
+capture_eep_build_v2(packet_t *pkt, capture_eep_buf_t *buf);
 
 /**
- * @brief Send a captured packet (EEP version 3)
+ * @brief Encapsulate a captured packet (EEP version 3)
  *
- * Send a packet encapsulated into EEP through the client socket.
- * This function will only handle SIP packets if EEP client mode
- * has been enabled.
+ * Build the EEP frame of the given packet into the buffer, growing
+ * its memory if required.
  *
  * @param pkt Packet Structure data
+ * @param buf Buffer where the frame will be stored
  * @return 1 on any error occurs, 0 otherwise
  */
 int
-capture_eep_send_v3(packet_t *pkt);
+capture_eep_build_v3(packet_t *pkt, capture_eep_buf_t *buf);
+
+/**
+ * @brief Get EEP client sender counters
+ *
+ * @param stats Structure to be filled with current counters
+ */
+void
+capture_eep_send_stats(capture_eep_send_stats_t *stats);
+
+/**
+ * @brief Queue a received packet to be parsed
+ *
+ * @param pkt Packet received by the EEP server
+ */
+void
+capture_eep_store(packet_t *pkt);
 
 /**
  * @brief Wrapper for receiving packet in configured EEP version
@@ -335,6 +471,20 @@ capture_eep_receive_v2();
 packet_t *
 capture_eep_receive_v3(const u_char *pkt, uint32_t size);
 
+/**
+ * @brief Generate pcap frame contents for a received packet
+ *
+ * Packets received through EEP have no real captured frame. When they
+ * need to be stored in a pcap file, a fake Ethernet/IPv4/UDP frame is
+ * built using packet addresses and payload.
+ *
+ * @param pkt Packet structure data
+ * @param frame Synthetic frame of the packet
+ * @return allocated frame contents (must be freed) or NULL on error
+ */
+u_char *
+capture_eep_frame_data(const packet_t *pkt, const frame_t *frame);
+
 /**
  * @brief Set EEP server url
  *
@@ -343,6 +493,7 @@ capture_eep_receive_v3(const u_char *pkt, uint32_t size);
  * For example:
  *  - udp:10.10.0.100:9060
  *  - udp:0.0.0.0:9960
+ *  - tcp:0.0.0.0:9060
  *
  * @param url URL to be parsed
  * @return 0 if url has been parsed, 1 otherwise
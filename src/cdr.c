@@ -0,0 +1,290 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file cdr.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Source code of functions defined in cdr.h
+ *
+ */
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include "cdr.h"
+#include "event.h"
+#include "rtp.h"
+#include "setting.h"
+
+//! CDR output configuration
+cdr_config_t cdr_cfg = { 0 };
+
+int
+cdr_open(const char *filename)
+{
+    FILE *f;
+
+    // Open output file
+    if (!strcmp(filename, "-")) {
+        f = stdout;
+    } else if (!(f = fopen(filename, "w"))) {
+        return 1;
+    }
+
+    // Records are written when the buffer is full or a batch is completed
+    setvbuf(f, NULL, _IOFBF, CDR_BUFFER_SIZE);
+
+    cdr_cfg.f = f;
+    cdr_cfg.close = (f != stdout);
+    cdr_cfg.format = setting_get_enumvalue(SETTING_CDR_FORMAT);
+    cdr_cfg.batch = setting_get_intvalue(SETTING_CDR_BATCH);
+    cdr_cfg.release = setting_enabled(SETTING_CDR_RELEASE);
+    cdr_cfg.pending = 0;
+    cdr_cfg.count = 0;
+
+    if (cdr_cfg.format == CDR_FORMAT_CSV)
+        cdr_write_csv_header(f);
+
+    return 0;
+}
+
+void
+cdr_close()
+{
+    if (!cdr_cfg.f)
+        return;
+
+    if (cdr_cfg.close) {
+        fclose(cdr_cfg.f);
+    } else {
+        fflush(cdr_cfg.f);
+    }
+    cdr_cfg.f = NULL;
+}
+
+bool
+cdr_enabled()
+{
+    return cdr_cfg.f != NULL;
+}
+
+bool
+cdr_release_enabled()
+{
+    return cdr_cfg.f && cdr_cfg.release;
+}
+
+uint64_t
+cdr_count()
+{
+    return cdr_cfg.count;
+}
+
+void
+cdr_flush()
+{
+    if (cdr_cfg.f)
+        fflush(cdr_cfg.f);
+}
+
+bool
+cdr_call_ended(sip_call_t *call, sip_msg_t *msg)
+{
+    // Final response to the INVITE that started the call
+    bool finalrsp = msg->reqresp >= 200 && msg->cseq == call->invitecseq
+                    && msg->cseqmethod == SIP_METHOD_INVITE;
+
+    switch (call->state) {
+        case SIP_CALLSTATE_COMPLETED:
+            return true;
+        case SIP_CALLSTATE_CANCELLED:
+        case SIP_CALLSTATE_BUSY:
+            return finalrsp;
+        case SIP_CALLSTATE_REJECTED:
+            // Authentication challenge, a new INVITE will follow
+            return finalrsp && msg->reqresp != 401 && msg->reqresp != 407;
+        case SIP_CALLSTATE_DIVERTED:
+            // Diverted with a provisional 181 until the call fails or ends
+            return (finalrsp && msg->reqresp >= 300) || msg->reqresp == SIP_METHOD_BYE;
+        default:
+            return false;
+    }
+}
+
+int
+cdr_call(sip_call_t *call, sip_msg_t *msg)
+{
+    cdr_t cdr = { 0 };
+    sip_msg_t *first, *cur;
+    rtp_stream_t *stream;
+    vector_iter_t it;
+
+    if (!cdr_cfg.f)
+        return 1;
+
+    cdr.call = call;
+
+    // Call times
+    if ((first = vector_first(call->msgs)))
+        cdr.setup = msg_get_time(first);
+    if (call->cstart_msg)
+        cdr.answer = msg_get_time(call->cstart_msg);
+    cdr.end = msg_get_time(call->cend_msg ? call->cend_msg : msg);
+
+    // Last final response to the INVITE that started the call
+    it = vector_iterator(call->msgs);
+    vector_iterator_set_last(&it);
+    while ((cur = vector_iterator_prev(&it))) {
+        if (cur->reqresp >= 200 && cur->cseq == call->invitecseq
+            && cur->cseqmethod == SIP_METHOD_INVITE) {
+            cdr.finalrsp = cur->reqresp;
+            break;
+        }
+    }
+
+    // RTP packet counters
+    it = vector_iterator(call->streams);
+    while ((stream = vector_iterator_next(&it))) {
+        cdr.rtpstreams++;
+        cdr.rtppackets += stream->pktcnt;
+    }
+
+    if (cdr_cfg.format == CDR_FORMAT_NDJSON) {
+        cdr_write_json(cdr_cfg.f, &cdr);
+    } else {
+        cdr_write_csv(cdr_cfg.f, &cdr);
+    }
+    cdr_cfg.count++;
+
+    // Write completed batches
+    if (++cdr_cfg.pending >= cdr_cfg.batch) {
+        fflush(cdr_cfg.f);
+        cdr_cfg.pending = 0;
+    }
+
+    return 0;
+}
+
+void
+cdr_write_csv_header(FILE *f)
+{
+    fputs("index,callid,xcallid,sipfrom,sipto,src,dst,state,setup,answer,end,"
+          "totaldur,convdur,finalrsp,reason,warning,rtpstreams,rtppackets\n", f);
+}
+
+void
+cdr_write_csv(FILE *f, cdr_t *cdr)
+{
+    char value[MAX_SIP_PAYLOAD];
+    sip_call_t *call = cdr->call;
+    int attrs[] = { SIP_ATTR_SIPFROM, SIP_ATTR_SIPTO, SIP_ATTR_SRC, SIP_ATTR_DST };
+    size_t i;
+
+    fprintf(f, "%d,", call->index);
+    csv_write_string(f, call->callid);
+    fputc(',', f);
+    csv_write_string(f, call->xcallid);
+    for (i = 0; i < sizeof(attrs) / sizeof(attrs[0]); i++) {
+        value[0] = '\0';
+        fputc(',', f);
+        csv_write_string(f, call_get_attribute(call, attrs[i], value) ? value : "");
+    }
+    fprintf(f, ",%s,%ld.%06ld,", call_state_to_str(call->state),
+            (long) cdr->setup.tv_sec, (long) cdr->setup.tv_usec);
+    if (cdr->answer.tv_sec)
+        fprintf(f, "%ld.%06ld", (long) cdr->answer.tv_sec, (long) cdr->answer.tv_usec);
+    fprintf(f, ",%ld.%06ld,%.3f,", (long) cdr->end.tv_sec, (long) cdr->end.tv_usec,
+            (cdr->end.tv_sec - cdr->setup.tv_sec) + (cdr->end.tv_usec - cdr->setup.tv_usec) / 1000000.0);
+    if (cdr->answer.tv_sec)
+        fprintf(f, "%.3f", (cdr->end.tv_sec - cdr->answer.tv_sec)
+                + (cdr->end.tv_usec - cdr->answer.tv_usec) / 1000000.0);
+    fputc(',', f);
+    if (cdr->finalrsp)
+        fprintf(f, "%d", cdr->finalrsp);
+    fputc(',', f);
+    csv_write_string(f, call->reasontxt ? call->reasontxt : "");
+    fputc(',', f);
+    if (call->warning)
+        fprintf(f, "%d", call->warning);
+    fprintf(f, ",%d,%lu\n", cdr->rtpstreams, (unsigned long) cdr->rtppackets);
+}
+
+void
+cdr_write_json(FILE *f, cdr_t *cdr)
+{
+    char value[MAX_SIP_PAYLOAD];
+    sip_call_t *call = cdr->call;
+    int attrs[] = { SIP_ATTR_SIPFROM, SIP_ATTR_SIPTO, SIP_ATTR_SRC, SIP_ATTR_DST };
+    size_t i;
+
+    fprintf(f, "{\"index\":%d,\"callid\":", call->index);
+    json_write_string(f, call->callid);
+    if (strlen(call->xcallid)) {
+        fputs(",\"xcallid\":", f);
+        json_write_string(f, call->xcallid);
+    }
+    for (i = 0; i < sizeof(attrs) / sizeof(attrs[0]); i++) {
+        value[0] = '\0';
+        if (call_get_attribute(call, attrs[i], value)) {
+            fprintf(f, ",\"%s\":", sip_attr_get_name(attrs[i]));
+            json_write_string(f, value);
+        }
+    }
+    fprintf(f, ",\"state\":\"%s\",\"setup\":%ld.%06ld", call_state_to_str(call->state),
+            (long) cdr->setup.tv_sec, (long) cdr->setup.tv_usec);
+    if (cdr->answer.tv_sec)
+        fprintf(f, ",\"answer\":%ld.%06ld", (long) cdr->answer.tv_sec, (long) cdr->answer.tv_usec);
+    fprintf(f, ",\"end\":%ld.%06ld,\"totaldur\":%.3f", (long) cdr->end.tv_sec, (long) cdr->end.tv_usec,
+            (cdr->end.tv_sec - cdr->setup.tv_sec) + (cdr->end.tv_usec - cdr->setup.tv_usec) / 1000000.0);
+    if (cdr->answer.tv_sec)
+        fprintf(f, ",\"convdur\":%.3f", (cdr->end.tv_sec - cdr->answer.tv_sec)
+                + (cdr->end.tv_usec - cdr->answer.tv_usec) / 1000000.0);
+    if (cdr->finalrsp)
+        fprintf(f, ",\"finalrsp\":%d", cdr->finalrsp);
+    if (call->reasontxt) {
+        fputs(",\"reason\":", f);
+        json_write_string(f, call->reasontxt);
+    }
+    if (call->warning)
+        fprintf(f, ",\"warning\":%d", call->warning);
+    fprintf(f, ",\"rtpstreams\":%d,\"rtppackets\":%lu}\n",
+            cdr->rtpstreams, (unsigned long) cdr->rtppackets);
+}
+
+void
+csv_write_string(FILE *f, const char *str)
+{
+    const char *c;
+
+    // Only quote fields with separators, quotes or line breaks
+    if (!strpbrk(str, ",\"\r\n")) {
+        fputs(str, f);
+        return;
+    }
+
+    fputc('"', f);
+    for (c = str; *c; c++) {
+        if (*c == '"')
+            fputc('"', f);
+        fputc(*c, f);
+    }
+    fputc('"', f);
+}
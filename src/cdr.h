@@ -0,0 +1,190 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file cdr.h
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Functions to write Call Detail Records
+ *
+ * A record is written when an INVITE dialog reaches a final state
+ * (completed, cancelled, rejected, busy or diverted). Records are
+ * buffered and written in batches as CSV or JSON lines.
+ *
+ * When calls are released, the call and its messages are removed from
+ * memory once its record has been written and the transaction that
+ * ended it has finished, so long captures only keep the calls in progress.
+ */
+#ifndef __SNGREP_CDR_H
+#define __SNGREP_CDR_H
+
+#include "config.h"
+#include <stdio.h>
+#include <stdbool.h>
+#include <sys/time.h>
+#include "sip.h"
+
+//! Size of the CDR output file buffer
+#define CDR_BUFFER_SIZE (256 * 1024)
+
+//! Shorter declaration of cdr structure
+typedef struct cdr cdr_t;
+//! Shorter declaration of cdr_config structure
+typedef struct cdr_config cdr_config_t;
+
+//! Available CDR output formats
+enum cdr_format {
+    CDR_FORMAT_CSV = 0,
+    CDR_FORMAT_NDJSON,
+};
+
+/**
+ * @brief Call Detail Record data
+ *
+ * Text fields are taken from the call when the record is written
+ */
+struct cdr {
+    //! Call of this record
+    sip_call_t *call;
+    //! Time of the first call message
+    struct timeval setup;
+    //! Time when the conversation started (zero if not answered)
+    struct timeval answer;
+    //! Time when the call reached its final state
+    struct timeval end;
+    //! Last final response code to the INVITE (0 if none)
+    int finalrsp;
+    //! Number of RTP streams of the call
+    int rtpstreams;
+    //! Number of RTP packets of all call streams
+    uint64_t rtppackets;
+};
+
+/**
+ * @brief CDR output configuration
+ */
+struct cdr_config {
+    //! Output file (NULL if CDRs are disabled)
+    FILE *f;
+    //! Output file must be closed when CDRs are disabled
+    bool close;
+    //! Output format (@see cdr_format)
+    int format;
+    //! Flush the output after this number of records
+    int batch;
+    //! Records written since last flush
+    int pending;
+    //! Remove calls from memory after writing their record
+    bool release;
+    //! Number of records written
+    uint64_t count;
+};
+
+/**
+ * @brief Start writing CDRs to given file
+ *
+ * @param filename Output file path or "-" for standard output
+ * @return 0 if the file has been opened, 1 otherwise
+ */
+int
+cdr_open(const char *filename);
+
+/**
+ * @brief Write pending records and close the CDR file
+ */
+void
+cdr_close();
+
+/**
+ * @brief Check if CDRs are being written
+ */
+bool
+cdr_enabled();
+
+/**
+ * @brief Check if calls must be removed after writing their CDR
+ */
+bool
+cdr_release_enabled();
+
+/**
+ * @brief Number of written records
+ */
+uint64_t
+cdr_count();
+
+/**
+ * @brief Write buffered records to the output file
+ */
+void
+cdr_flush();
+
+/**
+ * @brief Check if given message ends the call
+ *
+ * Completed calls end with the BYE request. Other final states end when
+ * the INVITE gets its final response, so cancelled calls include the 487
+ * and calls diverted with a provisional 181 are not ended until they
+ * fail or are hung up. Calls rejected with an authentication challenge
+ * (401, 407) are not finished, as they are usually followed by an
+ * authenticated INVITE.
+ *
+ * @param call Call of the message, with its state already updated
+ * @param msg Last received message of the call
+ */
+bool
+cdr_call_ended(sip_call_t *call, sip_msg_t *msg);
+
+/**
+ * @brief Write the CDR of an ended call
+ *
+ * @param call Call that has reached a final state
+ * @param msg Message that caused the final state
+ * @return 0 if the record has been written, 1 otherwise
+ */
+int
+cdr_call(sip_call_t *call, sip_msg_t *msg);
+
+/**
+ * @brief Write CSV column names
+ */
+void
+cdr_write_csv_header(FILE *f);
+
+/**
+ * @brief Write a record as a CSV line
+ */
+void
+cdr_write_csv(FILE *f, cdr_t *cdr);
+
+/**
+ * @brief Write a record as a single line JSON object
+ */
+void
+cdr_write_json(FILE *f, cdr_t *cdr);
+
+/**
+ * @brief Write a CSV field, quoting it if required
+ */
+void
+csv_write_string(FILE *f, const char *str);
+
+#endif /* __SNGREP_CDR_H */
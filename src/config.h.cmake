@@ -42,6 +42,12 @@
 /* Define if you have the `fopencookie' function */
 #cmakedefine HAVE_FOPENCOOKIE
 
+/* Define if you have the `epoll_create1' function */
+#cmakedefine HAVE_EPOLL_CREATE1
+
+/* Define if you have the `sendmmsg' function */
+#cmakedefine HAVE_SENDMMSG
+
 /* Compile With Unicode compatibility */
 #cmakedefine WITH_UNICODE
 
@@ -100,8 +100,9 @@ call_flow_create(ui_t *ui)
 
     // Create vectors for columns and flow arrows
     info->columns = vector_create(2, 1);
-    info->arrows = vector_create(20, 5);
-    vector_set_sorter(info->arrows, call_flow_arrow_sorter);
+    info->arrows = vector_create(200, 50);
+    info->arrowsidx = htable_create(CF_ARROWS_HASH_SIZE);
+    info->cursors = vector_create(5, 2);
 
     // Store it into panel userptr
     set_panel_userptr(ui->panel, (void*) info);
@@ -117,7 +118,11 @@ call_flow_destroy(ui_t *ui)
         // Delete panel columns
         vector_destroy_items(info->columns);
         // Delete panel arrows
-        vector_destroy_items(info->arrows);
+        call_flow_arrows_clear(ui);
+        vector_destroy(info->arrows);
+        htable_destroy(info->arrowsidx);
+        vector_destroy(info->cursors);
+        free(info->offsets);
         // Delete panel windows
         delwin(info->flow_win);
         delwin(info->raw_win);
@@ -185,11 +190,11 @@ call_flow_draw(ui_t *ui)
     }
 
     // Print color mode in title
-    if (setting_has_value(SETTING_COLORMODE, "request"))
+    if (setting_get_enumvalue(SETTING_COLORMODE) == SETTING_COLORMODE_REQUEST)
         strcat(title, " (Color by Request/Response)");
-    if (setting_has_value(SETTING_COLORMODE, "callid"))
+    if (setting_get_enumvalue(SETTING_COLORMODE) == SETTING_COLORMODE_CALLID)
         strcat(title, " (Color by Call-Id)");
-    if (setting_has_value(SETTING_COLORMODE, "cseq"))
+    if (setting_get_enumvalue(SETTING_COLORMODE) == SETTING_COLORMODE_CSEQ)
         strcat(title, " (Color by CSeq)");
 
     // Draw panel title
@@ -198,6 +203,9 @@ call_flow_draw(ui_t *ui)
     // Show some keybinding
     call_flow_draw_footer(ui);
 
+    // Create arrows and columns for new messages and streams
+    call_flow_arrows_update(ui);
+
     // Redraw columns
     call_flow_draw_columns(ui);
 
@@ -208,16 +216,8 @@ call_flow_draw(ui_t *ui)
     call_flow_draw_preview(ui);
 
     // Draw the scrollbar
-    vector_iter_t it = vector_iterator(info->darrows);
-    call_flow_arrow_t *arrow = NULL;
-    info->scroll.max = info->scroll.pos = 0;
-    while ((arrow = vector_iterator_next(&it))) {
-        // Store current position arrow
-        if (vector_iterator_current(&it) == info->first_arrow) {
-            info->scroll.pos = info->scroll.max;
-        }
-        info->scroll.max += call_flow_arrow_height(ui, arrow);
-    }
+    info->scroll.max = call_flow_arrow_offset(ui, vector_count(info->darrows));
+    info->scroll.pos = call_flow_arrow_offset(ui, info->first_arrow);
     ui_scrollbar_draw(info->scroll);
 
     // Redraw flow win
@@ -250,48 +250,12 @@ call_flow_draw_columns(ui_t *ui)
 {
     call_flow_info_t *info;
     call_flow_column_t *column;
-    sip_call_t *call = NULL;
-    rtp_stream_t *stream;
-    sip_msg_t *msg = NULL;
-    vector_iter_t streams;
     vector_iter_t columns;
     char coltext[MAX_SETTING_LEN];
-    address_t addr;
 
     // Get panel information
     info = call_flow_info(ui);
 
-    // In extended call flow, columns can have multiple call-ids
-    if (info->group->callid) {
-        info->maxcallids = call_group_count(info->group);
-    } else {
-        info->maxcallids = 2;
-    }
-
-    // Load columns
-    while((msg = call_group_get_next_msg(info->group, msg))) {
-        call_flow_column_add(ui, msg->call->callid, msg->packet->src);
-        call_flow_column_add(ui, msg->call->callid, msg->packet->dst);
-    }
-
-    // Add RTP columns FIXME Really
-    if (!setting_disabled(SETTING_CF_MEDIA)) {
-        while ((call = call_group_get_next(info->group, call)) ) {
-            streams = vector_iterator(call->streams);
-
-            while ((stream = vector_iterator_next(&streams))) {
-                if (stream->type == PACKET_RTP && stream_get_count(stream)) {
-                    addr = stream->src;
-                    addr.port = 0;
-                    call_flow_column_add(ui, NULL, addr);
-                    addr = stream->dst;
-                    addr.port = 0;
-                    call_flow_column_add(ui, NULL, addr);
-                }
-            }
-        }
-    }
-
     // Draw columns
     columns = vector_iterator(info->columns);
     while ((column = vector_iterator_next(&columns))) {
@@ -342,23 +306,6 @@ call_flow_draw_arrows(ui_t *ui)
     // Get panel information
     info = call_flow_info(ui);
 
-    // Create pending SIP arrows
-    sip_msg_t *msg = NULL;
-    while ((msg = call_group_get_next_msg(info->group, msg))) {
-        if (!call_flow_arrow_find(ui, msg)) {
-            arrow = call_flow_arrow_create(ui, msg, CF_ARROW_SIP);
-            vector_append(info->arrows, arrow);
-        }
-    }
-    // Create pending RTP arrows
-    rtp_stream_t *stream = NULL;
-    while ((stream = call_group_get_next_stream(info->group, stream))) {
-        if (!call_flow_arrow_find(ui, stream)) {
-            arrow = call_flow_arrow_create(ui, stream, CF_ARROW_RTP);
-            vector_append(info->arrows, arrow);
-        }
-    }
-
     // Copy displayed arrows
     // vector_destroy(info->darrows);
     //info->darrows = vector_copy_if(info->arrows, call_flow_arrow_filter);
@@ -468,13 +415,13 @@ call_flow_draw_message(ui_t *ui, call_flow_arrow_t *arrow, int cline)
     snprintf(method, METHOD_MAXLEN, "%.*s", METHOD_MAXLEN-1, msg_method);
 
     // If message has sdp information
-    if (msg_has_sdp(msg) && setting_has_value(SETTING_CF_SDP_INFO, "off")) {
+    if (msg_has_sdp(msg) && setting_get_enumvalue(SETTING_CF_SDP_INFO) == SETTING_SDP_INFO_OFF) {
         // Show sdp tag in title
         snprintf(method, METHOD_MAXLEN, "%.*s (SDP)", METHOD_MAXLEN-7, msg_method );
     }
 
     // If message has sdp information
-    if (setting_has_value(SETTING_CF_SDP_INFO, "compressed")) {
+    if (setting_get_enumvalue(SETTING_CF_SDP_INFO) == SETTING_SDP_INFO_COMPRESSED) {
         // Show sdp tag in title
         if (msg_has_sdp(msg)) {
             snprintf(method, METHOD_MAXLEN, "%.*s (SDP)", 12, msg_method);
@@ -483,14 +430,14 @@ call_flow_draw_message(ui_t *ui, call_flow_arrow_t *arrow, int cline)
         }
     }
 
-    if (msg_has_sdp(msg) && setting_has_value(SETTING_CF_SDP_INFO, "first")) {
+    if (msg_has_sdp(msg) && setting_get_enumvalue(SETTING_CF_SDP_INFO) == SETTING_SDP_INFO_FIRST) {
         snprintf(method, METHOD_MAXLEN, "%.3s (%s:%u)",
 		 msg_method,
 		 media->address.ip,
 		 media->address.port);
     }
 
-    if (msg_has_sdp(msg) && setting_has_value(SETTING_CF_SDP_INFO, "full")) {
+    if (msg_has_sdp(msg) && setting_get_enumvalue(SETTING_CF_SDP_INFO) == SETTING_SDP_INFO_FULL) {
         snprintf(method, METHOD_MAXLEN, "%.3s (%s)", msg_method, media->address.ip);
     }
 
@@ -520,32 +467,32 @@ call_flow_draw_message(ui_t *ui, call_flow_arrow_t *arrow, int cline)
 
     // Highlight current message
     if (arrow == vector_item(info->darrows, info->cur_arrow)) {
-        if (setting_has_value(SETTING_CF_HIGHTLIGHT, "reverse")) {
+        if (setting_get_enumvalue(SETTING_CF_HIGHTLIGHT) == SETTING_HIGHLIGHT_REVERSE) {
             wattron(flow_win, A_REVERSE);
         }
-        if (setting_has_value(SETTING_CF_HIGHTLIGHT, "bold")) {
+        if (setting_get_enumvalue(SETTING_CF_HIGHTLIGHT) == SETTING_HIGHLIGHT_BOLD) {
             wattron(flow_win, A_BOLD);
         }
-        if (setting_has_value(SETTING_CF_HIGHTLIGHT, "reversebold")) {
+        if (setting_get_enumvalue(SETTING_CF_HIGHTLIGHT) == SETTING_HIGHLIGHT_REVERSEBOLD) {
             wattron(flow_win, A_REVERSE);
             wattron(flow_win, A_BOLD);
         }
     }
 
     // Color the message {
-    if (setting_has_value(SETTING_COLORMODE, "request")) {
+    if (setting_get_enumvalue(SETTING_COLORMODE) == SETTING_COLORMODE_REQUEST) {
         // Color by request / response
         color = (msg_is_request(msg)) ? CP_RED_ON_DEF : CP_GREEN_ON_DEF;
-    } else if (setting_has_value(SETTING_COLORMODE, "callid")) {
+    } else if (setting_get_enumvalue(SETTING_COLORMODE) == SETTING_COLORMODE_CALLID) {
         // Color by call-id
         color = call_group_color(info->group, msg->call);
-    } else if (setting_has_value(SETTING_COLORMODE, "cseq")) {
+    } else if (setting_get_enumvalue(SETTING_COLORMODE) == SETTING_COLORMODE_CSEQ) {
         // Color by CSeq within the same call
         color = msg->cseq % 7 + 1;
     }
 
     // Print arrow in the same line than message
-    if (setting_has_value(SETTING_CF_SDP_INFO, "compressed")) {
+    if (setting_get_enumvalue(SETTING_CF_SDP_INFO) == SETTING_SDP_INFO_COMPRESSED) {
         aline = cline;
     }
 
@@ -563,7 +510,7 @@ call_flow_draw_message(ui_t *ui, call_flow_arrow_t *arrow, int cline)
     }
 
     // Draw media information
-    if (msg_has_sdp(msg) && setting_has_value(SETTING_CF_SDP_INFO, "full")) {
+    if (msg_has_sdp(msg) && setting_get_enumvalue(SETTING_CF_SDP_INFO) == SETTING_SDP_INFO_FULL) {
         medias = vector_iterator(msg->medias);
         while ((media = vector_iterator_next(&medias))) {
             sprintf(mediastr, "%s %d (%s)",
@@ -615,7 +562,7 @@ call_flow_draw_message(ui_t *ui, call_flow_arrow_t *arrow, int cline)
         }
     }
 
-    if (setting_has_value(SETTING_CF_SDP_INFO, "compressed"))
+    if (setting_get_enumvalue(SETTING_CF_SDP_INFO) == SETTING_SDP_INFO_COMPRESSED)
         mvwprintw(flow_win, cline, startpos + distance / 2 - msglen / 2 + 2, " %.26s ", method);
 
     // Turn off colors
@@ -639,7 +586,7 @@ call_flow_draw_message(ui_t *ui, call_flow_arrow_t *arrow, int cline)
         }
 
         // Print delta from selected message
-        if (!setting_has_value(SETTING_CF_SDP_INFO, "compressed")) {
+        if (setting_get_enumvalue(SETTING_CF_SDP_INFO) != SETTING_SDP_INFO_COMPRESSED) {
             if (info->selected == -1) {
                 if (setting_enabled(SETTING_CF_DELTA)) {
                     struct timeval selts, curts;
@@ -779,7 +726,7 @@ call_flow_draw_rtp_stream(ui_t *ui, call_flow_arrow_t *arrow, int cline)
     if (startpos != endpos) {
         // In compressed mode, we display the src and dst port inside the arrow
         // so fixup the stard and end position
-        if (!setting_has_value(SETTING_CF_SDP_INFO, "compressed")) {
+        if (setting_get_enumvalue(SETTING_CF_SDP_INFO) != SETTING_SDP_INFO_COMPRESSED) {
             startpos += 5;
             endpos -= 5;
         }
@@ -800,13 +747,13 @@ call_flow_draw_rtp_stream(ui_t *ui, call_flow_arrow_t *arrow, int cline)
 
     // Highlight current message
     if (arrow == vector_item(info->darrows, info->cur_arrow)) {
-        if (setting_has_value(SETTING_CF_HIGHTLIGHT, "reverse")) {
+        if (setting_get_enumvalue(SETTING_CF_HIGHTLIGHT) == SETTING_HIGHLIGHT_REVERSE) {
             wattron(win, A_REVERSE);
         }
-        if (setting_has_value(SETTING_CF_HIGHTLIGHT, "bold")) {
+        if (setting_get_enumvalue(SETTING_CF_HIGHTLIGHT) == SETTING_HIGHLIGHT_BOLD) {
             wattron(win, A_BOLD);
         }
-        if (setting_has_value(SETTING_CF_HIGHTLIGHT, "reversebold")) {
+        if (setting_get_enumvalue(SETTING_CF_HIGHTLIGHT) == SETTING_HIGHLIGHT_REVERSEBOLD) {
             wattron(win, A_REVERSE);
             wattron(win, A_BOLD);
         }
@@ -820,7 +767,7 @@ call_flow_draw_rtp_stream(ui_t *ui, call_flow_arrow_t *arrow, int cline)
     // Draw RTP arrow text
     mvwprintw(win, cline, startpos + (distance) / 2 - strlen(text) / 2 + 2, "%s", text);
 
-    if (!setting_has_value(SETTING_CF_SDP_INFO, "compressed"))
+    if (setting_get_enumvalue(SETTING_CF_SDP_INFO) != SETTING_SDP_INFO_COMPRESSED)
         cline++;
 
     // Draw line between columns
@@ -831,7 +778,7 @@ call_flow_draw_rtp_stream(ui_t *ui, call_flow_arrow_t *arrow, int cline)
 
     // Write the arrow at the end of the message (two arrows if this is a retrans)
     if (arrow->dir == CF_ARROW_RIGHT) {
-        if (!setting_has_value(SETTING_CF_SDP_INFO, "compressed")) {
+        if (setting_get_enumvalue(SETTING_CF_SDP_INFO) != SETTING_SDP_INFO_COMPRESSED) {
             mvwprintw(win, cline, startpos - 4, "%d", stream->src.port);
             mvwprintw(win, cline, endpos, "%d", stream->dst.port);
         }
@@ -842,7 +789,7 @@ call_flow_draw_rtp_stream(ui_t *ui, call_flow_arrow_t *arrow, int cline)
             mvwaddch(win, cline, startpos + arrow->rtp_ind_pos + 2, '>');
         }
     } else {
-        if (!setting_has_value(SETTING_CF_SDP_INFO, "compressed")) {
+        if (setting_get_enumvalue(SETTING_CF_SDP_INFO) != SETTING_SDP_INFO_COMPRESSED) {
             mvwprintw(win, cline, endpos, "%d", stream->src.port);
             mvwprintw(win, cline, startpos - 4, "%d", stream->dst.port);
         }
@@ -854,7 +801,7 @@ call_flow_draw_rtp_stream(ui_t *ui, call_flow_arrow_t *arrow, int cline)
         }
     }
 
-    if (setting_has_value(SETTING_CF_SDP_INFO, "compressed"))
+    if (setting_get_enumvalue(SETTING_CF_SDP_INFO) == SETTING_SDP_INFO_COMPRESSED)
         mvwprintw(win, cline, startpos + (distance) / 2 - strlen(text) / 2 + 2, " %s ", text);
 
     wattroff(win, A_BOLD | A_REVERSE);
@@ -888,27 +835,195 @@ call_flow_arrow_create(ui_t *ui, void *item, int type)
     memset(arrow, 0, sizeof(call_flow_arrow_t));
     arrow->type = type;
     arrow->item = item;
+    arrow->seq = call_flow_info(ui)->arrowseq++;
+    sprintf(arrow->key, "%p", item);
     return arrow;
 }
 
+void
+call_flow_arrows_update(ui_t *ui)
+{
+    call_flow_info_t *info;
+    call_flow_cursor_t *cursor;
+    call_flow_arrow_t *arrow, *cur, *first, *selected;
+    vector_t *pending;
+    sip_call_t *call;
+    sip_msg_t *msg;
+    rtp_stream_t *stream;
+    address_t addr;
+    int i, j, k, count;
+
+    // Get panel information
+    if (!(info = call_flow_info(ui)) || !info->group)
+        return;
+
+    // In extended call flow, columns can have multiple call-ids
+    if (info->group->callid) {
+        info->maxcallids = call_group_count(info->group);
+    } else {
+        info->maxcallids = 2;
+    }
+
+    // Start from scratch if the calls of the group have changed
+    for (i = 0; i < vector_count(info->cursors); i++) {
+        cursor = vector_item(info->cursors, i);
+        if (cursor->call != vector_item(info->group->calls, i)) {
+            call_flow_arrows_clear(ui);
+            vector_clear(info->columns);
+            break;
+        }
+    }
+
+    pending = vector_create(50, 50);
+
+    for (i = 0; i < vector_count(info->group->calls); i++) {
+        call = vector_item(info->group->calls, i);
+
+        // Create a cursor for calls added to the group
+        if (!(cursor = vector_item(info->cursors, i))) {
+            cursor = malloc(sizeof(call_flow_cursor_t));
+            memset(cursor, 0, sizeof(call_flow_cursor_t));
+            cursor->call = call;
+            vector_append(info->cursors, cursor);
+        }
+
+        // Create pending SIP arrows
+        for (; cursor->msgpos < vector_count(call->msgs); cursor->msgpos++) {
+            msg = sip_parse_msg(vector_item(call->msgs, cursor->msgpos));
+            if (info->group->sdp_only && !msg_has_sdp(msg))
+                continue;
+            arrow = call_flow_arrow_create(ui, msg, CF_ARROW_SIP);
+            htable_insert(info->arrowsidx, arrow->key, arrow);
+            vector_append(pending, arrow);
+        }
+
+        // Create pending RTP arrows
+        for (j = cursor->streampos; j < vector_count(call->streams); j++) {
+            stream = vector_item(call->streams, j);
+            if (stream->type != PACKET_RTP || call_flow_arrow_find(ui, stream)) {
+                // Don't check again leading streams already processed
+                if (j == cursor->streampos)
+                    cursor->streampos++;
+                continue;
+            }
+            // Wait until the stream has packets
+            if (!stream_get_count(stream))
+                continue;
+            arrow = call_flow_arrow_create(ui, stream, CF_ARROW_RTP);
+            htable_insert(info->arrowsidx, arrow->key, arrow);
+            vector_append(pending, arrow);
+            if (j == cursor->streampos)
+                cursor->streampos++;
+        }
+    }
+
+    // Nothing new to display
+    if (!(count = vector_count(pending))) {
+        vector_destroy(pending);
+        return;
+    }
+
+    // Sort new arrows and add their columns in chronological order
+    vector_sort(pending, call_flow_arrow_sorter);
+    for (j = 0; j < count; j++) {
+        arrow = vector_item(pending, j);
+        if (arrow->type == CF_ARROW_SIP) {
+            msg = arrow->item;
+            call_flow_column_add(ui, msg->call->callid, msg->packet->src);
+            call_flow_column_add(ui, msg->call->callid, msg->packet->dst);
+        }
+    }
+
+    // Add RTP columns FIXME Really
+    if (!setting_disabled(SETTING_CF_MEDIA)) {
+        for (j = 0; j < count; j++) {
+            arrow = vector_item(pending, j);
+            if (arrow->type == CF_ARROW_RTP) {
+                stream = arrow->item;
+                addr = stream->src;
+                addr.port = 0;
+                call_flow_column_add(ui, NULL, addr);
+                addr = stream->dst;
+                addr.port = 0;
+                call_flow_column_add(ui, NULL, addr);
+            }
+        }
+    }
+
+    // Remember arrows pointed by panel positions
+    cur = vector_item(info->arrows, info->cur_arrow);
+    first = vector_item(info->arrows, info->first_arrow);
+    selected = vector_item(info->arrows, info->selected);
+
+    // Merge new arrows from the end, only moving newer existing arrows
+    i = vector_count(info->arrows) - 1;
+    for (j = 0; j < count; j++)
+        vector_append(info->arrows, vector_item(pending, j));
+    k = vector_count(info->arrows) - 1;
+    for (j = count - 1; j >= 0; k--) {
+        arrow = vector_item(info->arrows, i);
+        if (i >= 0 && call_flow_arrow_cmp(arrow, vector_item(pending, j)) > 0) {
+            vector_set_item(info->arrows, k, arrow);
+            if (arrow == cur) info->cur_arrow = k;
+            if (arrow == first) info->first_arrow = k;
+            if (arrow == selected) info->selected = k;
+            i--;
+        } else {
+            vector_set_item(info->arrows, k, vector_item(pending, j--));
+        }
+    }
+
+    // Offsets of moved arrows must be calculated again
+    if (k + 1 < info->offsetsdirty)
+        info->offsetsdirty = k + 1;
+
+    vector_destroy(pending);
+}
+
+void
+call_flow_arrows_clear(ui_t *ui)
+{
+    call_flow_info_t *info;
+    call_flow_arrow_t *arrow;
+    vector_iter_t it;
+
+    if (!(info = call_flow_info(ui)))
+        return;
+
+    it = vector_iterator(info->arrows);
+    while ((arrow = vector_iterator_next(&it))) {
+        htable_remove(info->arrowsidx, arrow->key);
+        free(arrow);
+    }
+
+    // Recreate vectors instead of removing items one by one
+    vector_destroy(info->arrows);
+    info->arrows = info->darrows = vector_create(200, 50);
+    vector_destroy_items(info->cursors);
+    info->cursors = vector_create(5, 2);
+    info->offsetsdirty = 0;
+    info->cur_arrow = info->selected = -1;
+    info->first_arrow = 0;
+}
+
 int
 call_flow_arrow_height(ui_t *ui, const call_flow_arrow_t *arrow)
 {
     if (arrow->type == CF_ARROW_SIP) {
         if (setting_enabled(SETTING_CF_ONLYMEDIA))
             return 0;
-        if (setting_has_value(SETTING_CF_SDP_INFO, "compressed"))
+        if (setting_get_enumvalue(SETTING_CF_SDP_INFO) == SETTING_SDP_INFO_COMPRESSED)
             return 1;
         if (!msg_has_sdp(arrow->item))
             return 2;
-        if (setting_has_value(SETTING_CF_SDP_INFO, "off"))
+        if (setting_get_enumvalue(SETTING_CF_SDP_INFO) == SETTING_SDP_INFO_OFF)
             return 2;
-        if (setting_has_value(SETTING_CF_SDP_INFO, "first"))
+        if (setting_get_enumvalue(SETTING_CF_SDP_INFO) == SETTING_SDP_INFO_FIRST)
             return 2;
-        if (setting_has_value(SETTING_CF_SDP_INFO, "full"))
+        if (setting_get_enumvalue(SETTING_CF_SDP_INFO) == SETTING_SDP_INFO_FULL)
             return msg_media_count(arrow->item) + 2;
     } else if (arrow->type == CF_ARROW_RTP || arrow->type == CF_ARROW_RTCP) {
-        if (setting_has_value(SETTING_CF_SDP_INFO, "compressed"))
+        if (setting_get_enumvalue(SETTING_CF_SDP_INFO) == SETTING_SDP_INFO_COMPRESSED)
             return 1;
         if (setting_disabled(SETTING_CF_MEDIA))
             return 0;
@@ -918,12 +1033,75 @@ call_flow_arrow_height(ui_t *ui, const call_flow_arrow_t *arrow)
     return 0;
 }
 
+int
+call_flow_arrow_offset(ui_t *ui, int arrowindex)
+{
+    call_flow_info_t *info;
+    int count, mode, i;
+
+    if (!(info = call_flow_info(ui)))
+        return 0;
+
+    // Settings that change the height of the arrows
+    mode = setting_enabled(SETTING_CF_ONLYMEDIA)
+           | setting_disabled(SETTING_CF_MEDIA) << 1
+           | (setting_get_enumvalue(SETTING_CF_SDP_INFO) == SETTING_SDP_INFO_COMPRESSED) << 2
+           | (setting_get_enumvalue(SETTING_CF_SDP_INFO) == SETTING_SDP_INFO_FULL) << 3;
+
+    if (mode != info->offsetsmode) {
+        info->offsetsmode = mode;
+        info->offsetsdirty = 0;
+    }
+
+    // Make room for all arrows offsets
+    count = vector_count(info->arrows);
+    if (info->offsetslen < count + 1) {
+        info->offsetslen = (count + 1) * 2;
+        info->offsets = realloc(info->offsets, sizeof(int) * info->offsetslen);
+    }
+
+    // Accumulate arrows heights from the first changed arrow
+    info->offsets[0] = 0;
+    for (i = info->offsetsdirty; i < count; i++) {
+        info->offsets[i + 1] = info->offsets[i]
+                               + call_flow_arrow_height(ui, vector_item(info->arrows, i));
+    }
+    info->offsetsdirty = count;
+
+    if (arrowindex < 0)
+        return 0;
+    if (arrowindex > count)
+        arrowindex = count;
+    return info->offsets[arrowindex];
+}
+
+int
+call_flow_arrow_at_offset(ui_t *ui, int offset)
+{
+    call_flow_info_t *info = call_flow_info(ui);
+    int low = 0, high, mid;
+
+    // Update offsets and get the full arrows height
+    high = vector_count(info->arrows);
+    call_flow_arrow_offset(ui, high);
+
+    // Look for the first arrow starting at given offset
+    while (low < high) {
+        mid = (low + high) / 2;
+        if (info->offsets[mid] < offset) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
 call_flow_arrow_t *
 call_flow_arrow_find(ui_t *ui, const void *data)
 {
     call_flow_info_t *info;
-    call_flow_arrow_t *arrow;
-    vector_iter_t arrows;
+    char key[20];
 
     if (!data)
         return NULL;
@@ -931,12 +1109,8 @@ call_flow_arrow_find(ui_t *ui, const void *data)
     if (!(info = call_flow_info(ui)))
         return NULL;
 
-    arrows = vector_iterator(info->arrows);
-    while ((arrow = vector_iterator_next(&arrows)))
-        if (arrow->item == data)
-            return arrow;
-
-    return arrow;
+    sprintf(key, "%p", data);
+    return htable_find(info->arrowsidx, key);
 }
 
 sip_msg_t *
@@ -1350,7 +1524,7 @@ call_flow_set_group(sip_call_group_t *group)
         return -1;
 
     vector_clear(info->columns);
-    vector_clear(info->arrows);
+    call_flow_arrows_clear(ui);
 
     info->group = group;
     info->cur_arrow = info->selected = -1;
@@ -1451,7 +1625,7 @@ call_flow_move(ui_t *ui, int arrowindex)
     call_flow_info_t *info;
     call_flow_arrow_t *arrow;
     int flowh;
-    int curh = 0;
+    int first;
 
     // Get panel info
     if (!(info = call_flow_info(ui)))
@@ -1497,24 +1671,13 @@ call_flow_move(ui_t *ui, int arrowindex)
     if (info->cur_arrow <= info->first_arrow) {
         info->first_arrow = info->cur_arrow;
     } else {
-        // Draw the scrollbar
-        vector_iterator_set_current(&it, info->first_arrow - 1);
-        while ((arrow = vector_iterator_next(&it))) {
-            // Increase current arrow height position
-            curh += call_flow_arrow_height(ui, arrow);
-            // If we have reached current arrow
-            if (vector_iterator_current(&it) == info->cur_arrow) {
-                if (curh > flowh) {
-                    // Go to the next first arrow and check if current arrow
-                    // is still out of bottom bounds
-                    info->first_arrow++;
-                    vector_iterator_set_current(&it, info->first_arrow - 1);
-                    curh = 0;
-                } else {
-                    break;
-                }
-            }
-        }
+        // Find the first arrow that keeps current arrow bottom on screen
+        first = call_flow_arrow_at_offset(ui,
+                    call_flow_arrow_offset(ui, info->cur_arrow + 1) - flowh);
+        if (first > info->cur_arrow)
+            first = info->cur_arrow;
+        if (first > info->first_arrow)
+            info->first_arrow = first;
     }
 }
 
@@ -1552,31 +1715,25 @@ call_flow_arrow_time(call_flow_arrow_t *arrow)
 
 }
 
-void
-call_flow_arrow_sorter(vector_t *vector, void *item)
+int
+call_flow_arrow_cmp(const call_flow_arrow_t *arrow1, const call_flow_arrow_t *arrow2)
 {
-    struct timeval curts, prevts;
-    int count = vector_count(vector);
-    int i;
+    struct timeval ts1, ts2;
 
-    // First item is alway sorted
-    if (vector_count(vector) == 1)
-        return;
+    ts1 = call_flow_arrow_time((call_flow_arrow_t *) arrow1);
+    ts2 = call_flow_arrow_time((call_flow_arrow_t *) arrow2);
 
-    curts = call_flow_arrow_time(item);
-
-    for (i = count - 2 ; i >= 0; i--) {
-        // Get previous arrow
-        prevts = call_flow_arrow_time(vector_item(vector, i));
-        // Check if the item is already in a sorted position
-        if (timeval_is_older(curts, prevts)) {
-            vector_insert(vector, item, i + 1);
-            return;
-        }
-    }
+    if (ts1.tv_sec != ts2.tv_sec)
+        return (ts1.tv_sec < ts2.tv_sec) ? -1 : 1;
+    if (ts1.tv_usec != ts2.tv_usec)
+        return (ts1.tv_usec < ts2.tv_usec) ? -1 : 1;
+    return arrow1->seq - arrow2->seq;
+}
 
-    // Put this item at the begining of the vector
-    vector_insert(vector, item, 0);
+int
+call_flow_arrow_sorter(const void *item1, const void *item2)
+{
+    return call_flow_arrow_cmp(*(call_flow_arrow_t **) item1, *(call_flow_arrow_t **) item2);
 }
 
 int
@@ -1594,7 +1751,7 @@ call_flow_arrow_filter(void *item)
         if (setting_enabled(SETTING_CF_MEDIA))
             return 1;
         // Otherwise only show active streams
-        if (setting_has_value(SETTING_CF_MEDIA, SETTING_ACTIVE))
+        if (setting_get_enumvalue(SETTING_CF_MEDIA) == SETTING_MEDIA_ACTIVE)
             return stream_is_active(arrow->item);
     }
 
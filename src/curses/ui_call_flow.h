@@ -58,14 +58,20 @@
 #include <stdbool.h>
 #include "ui_manager.h"
 #include "group.h"
+#include "hash.h"
 #include "scrollbar.h"
 
+//! Number of buckets of the arrows hash table
+#define CF_ARROWS_HASH_SIZE 16384
+
 //! Sorter declaration of struct call_flow_info
 typedef struct call_flow_info call_flow_info_t;
 //! Sorter declaration of struct call_flow_column
 typedef struct call_flow_column call_flow_column_t;
 //! Sorter declaration of struct call_flow_arrow
 typedef struct call_flow_arrow call_flow_arrow_t;
+//! Sorter declaration of struct call_flow_cursor
+typedef struct call_flow_cursor call_flow_cursor_t;
 
 /**
  * @brief Call flow arrow types
@@ -107,6 +113,27 @@ struct call_flow_arrow {
     call_flow_column_t *scolumn;
     //! Destination column for this arrow
     call_flow_column_t *dcolumn;
+    //! Creation order, to keep arrows with the same time in arrival order
+    int seq;
+    //! Item pointer as text, used as key in the arrows hash table
+    char key[20];
+};
+
+/**
+ * @brief Arrows creation status of one call of the group
+ *
+ * Messages are only appended to calls, so the panel only needs to
+ * remember how many messages of each call already have an arrow.
+ * Streams can start receiving packets in any order, so the position
+ * only skips the leading streams that won't require new arrows.
+ */
+struct call_flow_cursor {
+    //! Call of the group
+    sip_call_t *call;
+    //! Number of call messages already processed
+    int msgpos;
+    //! Number of call streams already processed
+    int streampos;
 };
 
 /**
@@ -146,6 +173,20 @@ struct call_flow_info {
     vector_t *arrows;
     //! List of displayed arrows
     vector_t *darrows;
+    //! Arrows indexed by their item pointer
+    htable_t *arrowsidx;
+    //! Arrows creation status for each call of the group
+    vector_t *cursors;
+    //! Number of created arrows
+    int arrowseq;
+    //! Screen lines used by the arrows before each arrow position
+    int *offsets;
+    //! Allocated entries in the offsets array
+    int offsetslen;
+    //! First arrow position with an outdated offset
+    int offsetsdirty;
+    //! Display settings the arrow offsets were calculated with
+    int offsetsmode;
     //! First displayed arrow in the list
     int first_arrow;
     //! Current arrow index where the cursor is
@@ -313,6 +354,26 @@ call_flow_draw_rtp_stream(ui_t *ui, call_flow_arrow_t *arrow, int cline);
 call_flow_arrow_t *
 call_flow_arrow_create(ui_t *ui, void *item, int type);
 
+/**
+ * @brief Create arrows for new messages and streams of the group
+ *
+ * Only messages and streams not processed in previous calls are
+ * checked. New arrows are sorted and merged into the arrows vector and
+ * the columns they require are added to the panel.
+ *
+ * @param ui UI structure pointer
+ */
+void
+call_flow_arrows_update(ui_t *ui);
+
+/**
+ * @brief Remove all arrows of the panel
+ *
+ * @param ui UI structure pointer
+ */
+void
+call_flow_arrows_clear(ui_t *ui);
+
 /**
  * @brief Get how many lines of screen an arrow will use
  *
@@ -327,6 +388,30 @@ call_flow_arrow_create(ui_t *ui, void *item, int type);
 int
 call_flow_arrow_height(ui_t *ui, const call_flow_arrow_t *arrow);
 
+/**
+ * @brief Get the screen lines used by all arrows before given one
+ *
+ * Offsets are accumulated arrow heights, only recalculated from the
+ * first arrow that changed or when height related settings change.
+ * Requesting the arrow count position returns the height of all arrows.
+ *
+ * @param ui UI structure pointer
+ * @param arrowindex Arrow position in the arrows vector
+ * @return screen line where the arrow starts when drawing from the first one
+ */
+int
+call_flow_arrow_offset(ui_t *ui, int arrowindex);
+
+/**
+ * @brief Get the first arrow starting at or after given offset
+ *
+ * @param ui UI structure pointer
+ * @param offset Screen line when drawing from the first arrow
+ * @return arrow position in the arrows vector
+ */
+int
+call_flow_arrow_at_offset(ui_t *ui, int offset);
+
 /**
  * @brief Return the arrow of a SIP msg or RTP stream
  *
@@ -480,16 +565,24 @@ struct timeval
 call_flow_arrow_time(call_flow_arrow_t *arrow);
 
 /**
- * @brief Sort arrows by timestamp
+ * @brief Compare two arrows by timestamp
  *
- * This function acts as sorter for arrows vector. Each time a new arrow
- * is appended, it's sorted based on its timestamp.
+ * Arrows with the same timestamp are sorted in creation order.
  *
- * @param vector Arrows vector pointer
- * @param item Call Flow arrow structure pointer
+ * @param arrow1 Call Flow arrow structure pointer
+ * @param arrow2 Call Flow arrow structure pointer
+ * @return negative, zero or positive as required by qsort
  */
-void
-call_flow_arrow_sorter(vector_t *vector, void *item);
+int
+call_flow_arrow_cmp(const call_flow_arrow_t *arrow1, const call_flow_arrow_t *arrow2);
+
+/**
+ * @brief Compare two arrows vector items by timestamp
+ *
+ * qsort wrapper of @call_flow_arrow_cmp
+ */
+int
+call_flow_arrow_sorter(const void *item1, const void *item2);
 
 /**
  * @brief Filter displayed arrows based on configuration
@@ -113,6 +113,9 @@ call_list_create(ui_t *ui)
     // Group of selected calls
     info->group = call_group_create();
 
+    // Calls displayed in the list
+    info->dcalls = vector_create(200, 50);
+
     // Get current call list
     info->cur_call = -1;
 
@@ -141,6 +144,7 @@ call_list_destroy(ui_t *ui)
         // Deallocate group data
         call_group_destroy(info->group);
         vector_destroy(info->dcalls);
+        sng_free(info->lines);
 
         // Deallocate panel windows
         delwin(info->list_win);
@@ -159,7 +163,8 @@ call_list_info(ui_t *ui)
 bool
 call_list_redraw(ui_t *ui)
 {
-    return sip_calls_has_changed();
+    // Keep drawing while there are calls pending to be filtered
+    return sip_calls_has_changed() || filter_update_pending();
 }
 
 int
@@ -195,6 +200,7 @@ call_list_draw_header(ui_t *ui)
     char sortind;
     const char *countlb;
     const char *device, *filterexpr, *filterbpf;
+    capture_dump_stats_t dump;
 
     // Get panel info
     call_list_info_t *info = call_list_info(ui);
@@ -234,6 +240,14 @@ call_list_draw_header(ui_t *ui)
     wattroff(ui->win, COLOR_PAIR(CP_GREEN_ON_DEF));
     wattroff(ui->win, COLOR_PAIR(CP_RED_ON_DEF));
 
+    // Warn about captured packets not stored in dump file
+    capture_dump_stats(&dump);
+    if (dump.dropped) {
+        wattron(ui->win, COLOR_PAIR(CP_RED_ON_DEF));
+        wprintw(ui->win, " [O: %lu dropped]", dump.dropped);
+        wattroff(ui->win, COLOR_PAIR(CP_RED_ON_DEF));
+    }
+
     // Label for Display filter
     mvwprintw(ui->win, 3, 2, "Display Filter: ");
 
@@ -306,12 +320,13 @@ call_list_draw_header(ui_t *ui)
     }
 
     // Print calls count (also filtered)
-    sip_stats_t stats = sip_calls_stats();
+    int total = sip_calls_count();
+    int displayed = vector_count(info->dcalls);
     mvwprintw(ui->win, 1, 45, "%*s", 30, "");
-    if (stats.total != stats.displayed) {
-        mvwprintw(ui->win, 1, 45, "%s: %d (%d displayed)", countlb, stats.total, stats.displayed);
+    if (total != displayed) {
+        mvwprintw(ui->win, 1, 45, "%s: %d (%d displayed)", countlb, total, displayed);
     } else {
-        mvwprintw(ui->win, 1, 45, "%s: %d", countlb, stats.total);
+        mvwprintw(ui->win, 1, 45, "%s: %d", countlb, total);
     }
 
 }
@@ -338,31 +353,68 @@ call_list_draw_footer(ui_t *ui)
 }
 
 void
-call_list_draw_list(ui_t *ui)
+call_list_update_calls(ui_t *ui)
 {
-    WINDOW *list_win;
-    int listh, listw, cline = 0;
-    struct sip_call *call = NULL;
-    int i, collen;
-    char coltext[SIP_ATTR_MAXLEN];
-    int colid;
-    int colpos;
-    int color;
+    sip_call_t *call, *selected;
+    vector_iter_t it;
+    bool changed = false;
+    int pending;
 
     // Get panel info
     call_list_info_t *info = call_list_info(ui);
 
-    // Get window of call list panel
-    list_win = info->list_win;
-    getmaxyx(list_win, listh, listw);
-
     // Store selected call
-    if (info->cur_call >= 0)
-        call = vector_item(info->dcalls, info->cur_call);
+    selected = vector_item(info->dcalls, info->cur_call);
+
+    // Evaluate filters on calls after filters have changed
+    pending = filter_update_calls(FILTER_UPDATE_MSEC);
+
+    if (info->calls_version != sip_calls_version()
+        || info->filter_version != filter_get_version() || info->filter_pending) {
+        // Build displayed calls from the whole list. Calls pending to be
+        // evaluated will be added in next updates
+        vector_clear(info->dcalls);
+        vector_set_sorter(info->dcalls, NULL);
+        it = sip_calls_iterator();
+        while ((call = vector_iterator_next(&it))) {
+            call->listed = (pending) ? filter_check_call_cached(call) : filter_check_call(call);
+            if (call->listed)
+                vector_append(info->dcalls, call);
+        }
+        // Calls list is already sorted, only sort new calls
+        vector_set_sorter(info->dcalls, sip_list_sorter);
+        info->calls_version = sip_calls_version();
+        info->filter_version = filter_get_version();
+        changed = true;
+    } else if ((call = sip_calls_last_updated()) && call->updseq > info->updseq) {
+        // Find the first call updated since last update
+        while (call->updprev && call->updprev->updseq > info->updseq)
+            call = call->updprev;
+
+        // Check updated calls in update order, so new calls are appended
+        // at the end of the sorted list without moving other calls
+        for (; call; call = call->updnext) {
+            if (filter_check_call(call)) {
+                if (!call->listed) {
+                    vector_append(info->dcalls, call);
+                    call->listed = changed = true;
+                }
+            } else if (call->listed) {
+                vector_remove(info->dcalls, call);
+                call->listed = false;
+                changed = true;
+            }
+        }
+    }
+
+    // Store last checked update
+    if ((call = sip_calls_last_updated()))
+        info->updseq = call->updseq;
+    info->filter_pending = pending;
 
-    // Get the list of calls that are goint to be displayed
-    vector_destroy(info->dcalls);
-    info->dcalls = vector_copy_if(sip_calls_vector(), filter_check_call);
+    // Calls have been added or removed, keep the same call selected
+    if (changed && selected)
+        call_list_move(ui, vector_index(info->dcalls, selected));
 
     // If no active call, use the fist one (if exists)
     if (info->cur_call == -1 && vector_count(info->dcalls)) {
@@ -377,12 +429,107 @@ call_list_draw_list(ui_t *ui)
         } else {
             call_list_move(ui, 0);
         }
-    } else if (call) {
-        call_list_move(ui, vector_index(info->dcalls, call));
+    }
+}
+
+unsigned int
+call_list_layout(ui_t *ui)
+{
+    int listh, listw, i;
+    unsigned int layout;
+
+    // Get panel info
+    call_list_info_t *info = call_list_info(ui);
+    getmaxyx(info->list_win, listh, listw);
+
+    // Calculate the layout of the lines (including scrollbar visibility)
+    layout = listw * 31 + setting_enabled(SETTING_CL_COLORATTR) * 2
+             + (vector_count(info->dcalls) >= listh);
+    for (i = 0; i < info->columncnt; i++)
+        layout = layout * 31 + info->columns[i].id * 256 + info->columns[i].width;
+
+    return layout;
+}
+
+int
+call_list_line_flags(ui_t *ui, sip_call_t *call, int index)
+{
+    int flags = 0;
+
+    // Get panel info
+    call_list_info_t *info = call_list_info(ui);
+
+    if (call_group_exists(info->group, call))
+        flags |= CL_LINE_GROUPED;
+    if (info->cur_call == index)
+        flags |= CL_LINE_CURRENT;
+
+    return flags;
+}
+
+bool
+call_list_rows_changed(ui_t *ui)
+{
+    sip_call_t *call;
+    call_list_line_t *line;
+    int cline = 0;
+
+    // Get panel info
+    call_list_info_t *info = call_list_info(ui);
+
+    // Layout or scrollbar have changed
+    if (call_list_layout(ui) != info->layout || getmaxy(info->list_win) != info->linecnt
+        || info->scroll.max != vector_count(info->dcalls))
+        return true;
+
+    // Compare visible calls with the drawn ones
+    vector_iter_t it = vector_iterator(info->dcalls);
+    vector_iterator_set_current(&it, info->scroll.pos - 1);
+    while (cline < info->linecnt && (call = vector_iterator_next(&it))) {
+        if (!call_msg_count(call))
+            continue;
+        line = &info->lines[cline++];
+        if (line->call != call || line->updseq != call->updseq
+            || line->flags != call_list_line_flags(ui, call, vector_iterator_current(&it)))
+            return true;
     }
 
-    // Clear call list before redrawing
-    werase(list_win);
+    // Lines without calls have been cleared
+    return cline < info->linecnt && info->lines[cline].call;
+}
+
+void
+call_list_draw_list(ui_t *ui)
+{
+    WINDOW *list_win;
+    int listh, listw, cline = 0;
+    struct sip_call *call = NULL;
+    int i, collen;
+    const char *coltext;
+    int colid;
+    int colpos;
+    int color;
+    int flags;
+    unsigned int layout;
+    call_list_line_t *line;
+
+    // Get panel info
+    call_list_info_t *info = call_list_info(ui);
+
+    // Get window of call list panel
+    list_win = info->list_win;
+    getmaxyx(list_win, listh, listw);
+    layout = call_list_layout(ui);
+
+    // Layout has changed, draw all lines again
+    if (layout != info->layout || listh != info->linecnt) {
+        info->lines = realloc(info->lines, sizeof(call_list_line_t) * listh);
+        memset(info->lines, 0, sizeof(call_list_line_t) * listh);
+        info->linecnt = listh;
+        info->layout = layout;
+        // Clear call list before redrawing
+        werase(list_win);
+    }
 
     // Set the iterator position to the first call
     vector_iter_t it = vector_iterator(info->dcalls);
@@ -398,12 +545,27 @@ call_list_draw_list(ui_t *ui)
         if (!call_msg_count(call))
             continue;
 
+        // Get line flags
+        flags = call_list_line_flags(ui, call, vector_iterator_current(&it));
+
+        // Line has not changed since it was drawn
+        line = &info->lines[cline];
+        if (line->call == call && line->updseq == call->updseq && line->flags == flags) {
+            cline++;
+            continue;
+        }
+
+        // Store drawn line information
+        line->call = call;
+        line->updseq = call->updseq;
+        line->flags = flags;
+
         // Show bold selected rows
-        if (call_group_exists(info->group, call))
+        if (flags & CL_LINE_GROUPED)
             wattron(list_win, A_BOLD | COLOR_PAIR(CP_DEFAULT));
 
         // Highlight active call
-        if (info->cur_call == vector_iterator_current(&it)) {
+        if (flags & CL_LINE_CURRENT) {
             wattron(list_win, COLOR_PAIR(CP_WHITE_ON_BLUE));
             // Reverse colors on monochrome terminals
             if (!has_colors())
@@ -412,7 +574,7 @@ call_list_draw_list(ui_t *ui)
         // Set current line background
         mvwprintw(list_win, cline, 0, "%*s", listw, "");
         // Set current line selection box
-        mvwprintw(list_win, cline, 2, call_group_exists(info->group, call) ? "[*]" : "[ ]");
+        mvwprintw(list_win, cline, 2, (flags & CL_LINE_GROUPED) ? "[*]" : "[ ]");
 
         // Print requested columns
         colpos = 6;
@@ -425,19 +587,16 @@ call_list_draw_list(ui_t *ui)
             if (colpos + collen >= listw)
                 break;
 
-            // Initialize column text
-            memset(coltext, 0, sizeof(coltext));
-
             // Get call attribute for current column
-            if (!call_get_attribute(call, colid, coltext)) {
+            if (!(coltext = call_get_attribute_cached(call, colid))) {
                 colpos += collen + 1;
                 continue;
             }
 
             // Enable attribute color (if not current one)
             color = 0;
-            if (info->cur_call != vector_iterator_current(&it)) {
-                if ((color = sip_attr_get_color(colid, coltext)) > 0) {
+            if (!(flags & CL_LINE_CURRENT)) {
+                if ((color = call_get_attribute_color(call, colid)) > 0) {
                     wattron(list_win, color);
                 }
             }
@@ -457,6 +616,16 @@ call_list_draw_list(ui_t *ui)
         wattroff(list_win, A_BOLD | A_REVERSE);
     }
 
+    // Clear lines without calls
+    for (; cline < listh; cline++) {
+        line = &info->lines[cline];
+        if (line->call) {
+            wmove(list_win, cline, 0);
+            wclrtoeol(list_win);
+            line->call = NULL;
+        }
+    }
+
     // Draw scrollbar to the right
     info->scroll.max = vector_count(info->dcalls);
     ui_scrollbar_draw(info->scroll);
@@ -474,12 +643,19 @@ call_list_draw(ui_t *ui)
     // Store cursor position
     getyx(ui->win, cury, curx);
 
+    // Update displayed calls with new or changed calls
+    call_list_update_calls(ui);
+
     // Draw the header
     call_list_draw_header(ui);
-    // Draw the footer
-    call_list_draw_footer(ui);
-    // Draw the list content
-    call_list_draw_list(ui);
+
+    // Only header counters have changed since last draw
+    if (ui->changed || call_list_rows_changed(ui)) {
+        // Draw the footer
+        call_list_draw_footer(ui);
+        // Draw the list content
+        call_list_draw_list(ui);
+    }
 
     // Restore cursor position
     wmove(ui->win, cury, curx);
@@ -516,8 +692,7 @@ const char *
 call_list_line_text(ui_t *ui, sip_call_t *call, char *text)
 {
     int i, collen;
-    char call_attr[SIP_ATTR_MAXLEN];
-    char coltext[SIP_ATTR_MAXLEN];
+    const char *call_attr;
     int colid;
 
     // Get panel info
@@ -540,16 +715,11 @@ call_list_line_text(ui_t *ui, sip_call_t *call, char *text)
         if (collen <= 0)
             break;
 
-        // Initialize column text
-        memset(coltext, 0, sizeof(coltext));
-        memset(call_attr, 0, sizeof(call_attr));
-
         // Get call attribute for current column
-        if (call_get_attribute(call, colid, call_attr)) {
-            sprintf(coltext, "%.*s", collen, call_attr);
-        }
+        call_attr = call_get_attribute_cached(call, colid);
+
         // Add the column text to the existing columns
-        sprintf(text + strlen(text), "%-*s ", collen, coltext);
+        sprintf(text + strlen(text), "%-*.*s ", collen, collen, call_attr ? call_attr : "");
     }
 
     return text;
@@ -663,6 +833,9 @@ call_list_handle_key(ui_t *ui, int key)
             case ACTION_SHOW_STATS:
                 ui_create_panel(PANEL_STATS);
                 break;
+            case ACTION_SHOW_PIPELINE:
+                ui_create_panel(PANEL_PIPELINE);
+                break;
             case ACTION_SAVE:
                 if (capture_sources_count() > 1) {
                     dialog_run("Saving is not possible when multiple input sources are specified.");
@@ -965,6 +1138,7 @@ call_list_help(ui_t *ui)
     mvwprintw(help_win, 21, 2, "F10/t       Select displayed columns");
     mvwprintw(help_win, 22, 2, "i/I         Set display filter to invite");
     mvwprintw(help_win, 23, 2, "p           Stop/Resume packet capture");
+    mvwprintw(help_win, 24, 2, "L           Show packet pipeline stage timers");
 
     // Press any key to close
     wgetch(help_win);
@@ -1005,56 +1179,37 @@ call_list_clear(ui_t *ui)
 
     // Clear Displayed lines
     werase(info->list_win);
+    info->linecnt = 0;
 }
 
 void
 call_list_move(ui_t *ui, int line)
 {
     call_list_info_t *info;
+    int count, listh;
 
     // Get panel info
     if (!(info = call_list_info(ui)))
         return;
 
-    // Already in this position?
-    if (info->cur_call == line)
+    // Nothing to select
+    if (!(count = vector_count(info->dcalls)))
         return;
 
-    // Moving down or up?
-    bool move_down = (info->cur_call < line);
-
-    vector_iter_t it = vector_iterator(info->dcalls);
-    vector_iterator_set_current(&it, info->cur_call);
-
-    if (move_down) {
-        while (info->cur_call < line) {
-            // Check if there is a call below us
-            if (!vector_iterator_next(&it))
-               break;
+    // Move to the nearest existing call
+    if (line >= count)
+        line = count - 1;
+    if (line < 0)
+        line = 0;
 
-            // Increase current call position
-            info->cur_call++;
+    info->cur_call = line;
+    listh = getmaxy(info->list_win);
 
-            // If we are out of the bottom of the displayed list
-            // refresh it starting in the next call
-            if (info->cur_call - info->scroll.pos == getmaxy(info->list_win)) {
-               info->scroll.pos++;
-            }
-        }
-    } else {
-        while (info->cur_call > line) {
-            // Check if there is a call above us
-            if (!vector_iterator_prev(&it))
-              break;
-            // If we are out of the top of the displayed list
-            // refresh it starting in the previous (in fact current) call
-            if (info->cur_call ==  info->scroll.pos) {
-              info->scroll.pos--;
-            }
-            // Move current call position
-            info->cur_call--;
-        }
-    }
+    // Scroll the list to keep the selected call visible
+    if (info->scroll.pos < 0 || info->cur_call < info->scroll.pos)
+        info->scroll.pos = info->cur_call;
+    if (info->cur_call - info->scroll.pos >= listh)
+        info->scroll.pos = info->cur_call - listh + 1;
 }
 
 void
@@ -46,10 +46,22 @@ enum call_list_field_list {
     FLD_LIST_COUNT
 };
 
+/**
+ * @brief Flags of drawn call list lines
+ */
+enum call_list_line_flags {
+    //! Line is the selected call
+    CL_LINE_CURRENT = 1 << 0,
+    //! Line call is in selected calls group
+    CL_LINE_GROUPED = 1 << 1,
+};
+
 //! Sorter declaration of call_list_column struct
 typedef struct call_list_column call_list_column_t;
 //! Sorter declaration of call_list_info struct
 typedef struct call_list_info call_list_info_t;
+//! Sorter declaration of call_list_line struct
+typedef struct call_list_line call_list_line_t;
 
 /**
  * @brief Call List column information
@@ -65,6 +77,21 @@ struct call_list_column {
     int width;
 };
 
+/**
+ * @brief Call List drawn line information
+ *
+ * Stores what was drawn in each line of the list, so lines are only
+ * drawn again when their content changes.
+ */
+struct call_list_line {
+    //! Call drawn in this line
+    sip_call_t *call;
+    //! Call update sequence when the line was drawn
+    uint64_t updseq;
+    //! Line flags when the line was drawn (@see call_list_line_flags)
+    int flags;
+};
+
 /**
  * @brief Call List panel status information
  *
@@ -74,6 +101,12 @@ struct call_list_column {
 struct call_list_info {
     //! Displayed calls vector
     vector_t *dcalls;
+    //! Call list and filters versions used to build displayed calls
+    unsigned int calls_version, filter_version;
+    //! Sequence of the last call update checked in displayed calls
+    uint64_t updseq;
+    //! Calls were pending filter evaluation in last update
+    int filter_pending;
     //! Selected call in the list
     int cur_call;
     //! Selected calls with space
@@ -100,6 +133,12 @@ struct call_list_info {
     int autoscroll;
     //! List scrollbar
     scrollbar_t scroll;
+    //! Drawn lines information
+    call_list_line_t *lines;
+    //! Number of lines in drawn lines information
+    int linecnt;
+    //! Hash of the layout used to draw the lines
+    unsigned int layout;
 };
 
 /**
@@ -181,6 +220,49 @@ call_list_draw_header(ui_t *ui);
 void
 call_list_draw_footer(ui_t *ui);
 
+/**
+ * @brief Update the displayed calls of the panel
+ *
+ * Displayed calls are only built from the whole call list when the
+ * list or the filters change. Otherwise only the calls updated since
+ * the last invocation are checked and added or removed.
+ *
+ * @param ui UI structure pointer
+ */
+void
+call_list_update_calls(ui_t *ui);
+
+/**
+ * @brief Hash of the attributes used to draw the list lines
+ *
+ * Any change in window width, columns or scrollbar visibility will
+ * change the layout and all lines will be drawn again.
+ *
+ * @param ui UI structure pointer
+ */
+unsigned int
+call_list_layout(ui_t *ui);
+
+/**
+ * @brief Get the flags of a list line
+ *
+ * @param ui UI structure pointer
+ * @param call Call displayed in the line
+ * @param index Position of the call in displayed calls
+ * @return line flags (@see call_list_line_flags)
+ */
+int
+call_list_line_flags(ui_t *ui, sip_call_t *call, int index);
+
+/**
+ * @brief Check if visible lines differ from the drawn ones
+ *
+ * @param ui UI structure pointer
+ * @return true if the list must be drawn again
+ */
+bool
+call_list_rows_changed(ui_t *ui);
+
 /**
  * @brief Draw panel list contents
  *
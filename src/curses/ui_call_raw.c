@@ -102,17 +102,31 @@ call_raw_draw(ui_t *ui)
 {
     call_raw_info_t *info;
     sip_msg_t *msg = NULL;
+    int lines = 0;
 
     // Get panel information
     if(!(info = call_raw_info(ui)))
         return -1;
 
     if (info->group) {
-        // Print the call group messages into the pad
-        while ((msg = call_group_get_next_msg(info->group, info->last)))
-            call_raw_print_msg(ui, msg);
-    } else {
-        call_raw_set_msg(info->msg);
+        // A message has been merged before the last printed one
+        if (info->last && call_group_msg_number(info->group, info->last) != info->printed - 1)
+            call_raw_clear(ui);
+
+        // Make room for all new messages at once
+        for (msg = info->last; (msg = call_group_get_next_msg(info->group, msg));)
+            lines += call_raw_msg_lines(msg, getmaxx(info->pad)) + 2;
+        call_raw_reserve(ui, lines);
+
+        // Print only the messages received since last draw into the pad
+        while ((msg = call_group_get_next_msg(info->group, info->last))) {
+            // Stop when the pad can't grow anymore
+            if (call_raw_print_msg(ui, msg) != 0)
+                break;
+        }
+    } else if (!info->printed && info->msg) {
+        // Print the message in the pad
+        call_raw_print_msg(ui, info->msg);
     }
 
     // Copy the visible part of the pad into the panel window
@@ -121,14 +135,72 @@ call_raw_draw(ui_t *ui)
     return 0;
 }
 
+void
+call_raw_clear(ui_t *ui)
+{
+    call_raw_info_t *info = call_raw_info(ui);
+
+    // Remove all printed messages from the pad
+    werase(info->pad);
+    info->padline = 0;
+    info->printed = 0;
+    info->last = NULL;
+}
+
+int
+call_raw_msg_lines(sip_msg_t *msg, int width)
+{
+    const char *payload;
+    int lines = 1, column = 0;
+
+    // Count lines the same way draw_message_pos wraps them
+    for (payload = msg_get_payload(msg); *payload; payload++) {
+        if (*payload == '\r')
+            continue;
+        if (column > width - 1 || *payload == '\n') {
+            lines++;
+            column = 0;
+        }
+        if (*payload != '\n')
+            column++;
+    }
+
+    return lines;
+}
+
+int
+call_raw_reserve(ui_t *ui, int lines)
+{
+    int height, width;
+    call_raw_info_t *info = call_raw_info(ui);
+
+    // Get current pad dimensions
+    getmaxyx(info->pad, height, width);
+
+    // Already enough space in the pad
+    if (info->padline + lines <= height)
+        return 0;
+
+    // Double pad size, so it's only resized a few times
+    while (info->padline + lines > height && height < CALL_RAW_MAX_LINES)
+        height *= 2;
+    if (height > CALL_RAW_MAX_LINES)
+        height = CALL_RAW_MAX_LINES;
+
+    // Add more lines to the pad, keeping the printed ones
+    if (height > getmaxy(info->pad) && wresize(info->pad, height, width) != OK)
+        return 1;
+
+    return (info->padline + lines <= height) ? 0 : 1;
+}
+
 int
 call_raw_print_msg(ui_t *ui, sip_msg_t *msg)
 {
     call_raw_info_t *info;
-    int payload_lines, i, column, height, width;
+    int payload_lines;
     // Message ngrep style Header
     char header[256];
-    char payload[MAX_SIP_PAYLOAD];
     int color = 0;
 
     // Get panel information
@@ -138,48 +210,26 @@ call_raw_print_msg(ui_t *ui, sip_msg_t *msg)
     // Get the pad window
     WINDOW *pad = info->pad;
 
-    // Get current pad dimensions
-    getmaxyx(pad, height, width);
-
-    // Get message payload
-    strcpy(payload, msg_get_payload(msg));
-
-    // Check how many lines we well need to draw this message
-    payload_lines = 0;
-    column = 0;
-    for (i = 0; i < strlen(payload); i++) {
-        if (column == width || payload[i] == '\n') {
-            payload_lines++;
-            column = 0;
-            continue;
-        }
-        column++;
-    }
+    // Check how many lines we well need to draw this message (header,
+    // payload and separator)
+    payload_lines = call_raw_msg_lines(msg, getmaxx(pad)) + 2;
 
     // Check if we have enough space in our huge pad to store this message
-    if (info->padline + payload_lines > height) {
-        // Create a new pad with more lines!
-        pad = newpad(height + 500, COLS);
-        // And copy all previous information
-        overwrite(info->pad, pad);
-        // Delete previous pad
-        delwin(info->pad);
-        // And store the new pad
-        info->pad = pad;
-    }
+    if (call_raw_reserve(ui, payload_lines) != 0)
+        return -1;
 
     // Color the message {
-    if (setting_has_value(SETTING_COLORMODE, "request")) {
+    if (setting_get_enumvalue(SETTING_COLORMODE) == SETTING_COLORMODE_REQUEST) {
         // Determine arrow color
         if (msg_is_request(msg)) {
             color = CP_RED_ON_DEF;
         } else {
             color = CP_GREEN_ON_DEF;
         }
-    } else if (info->group && setting_has_value(SETTING_COLORMODE, "callid")) {
+    } else if (info->group && setting_get_enumvalue(SETTING_COLORMODE) == SETTING_COLORMODE_CALLID) {
         // Color by call-id
         color = call_group_color(info->group, msg->call);
-    } else if (setting_has_value(SETTING_COLORMODE, "cseq")) {
+    } else if (setting_get_enumvalue(SETTING_COLORMODE) == SETTING_COLORMODE_CSEQ) {
         // Color by CSeq within the same call
         color = msg->cseq % 7 + 1;
     }
@@ -199,6 +249,7 @@ call_raw_print_msg(ui_t *ui, sip_msg_t *msg)
 
     // Set this as the last printed message
     info->last = msg;
+    info->printed++;
 
     return 0;
 }
@@ -254,16 +305,8 @@ call_raw_handle_key(ui_t *ui, int key)
             case ACTION_CYCLE_COLOR:
                 // Handle colors using default handler
                 ui_default_handle_key(ui, key);
-                // Create a new pad (forces messages draw)
-                delwin(info->pad);
-                info->pad = newpad(500, COLS);
-                info->last = NULL;
-                // Force refresh panel
-                if (info->group) {
-                    call_raw_set_group(info->group);
-                } else {
-                    call_raw_set_msg(info->msg);
-                }
+                // Print all messages again with new colors
+                call_raw_clear(ui);
                 break;
             case ACTION_CLEAR_CALLS:
             case ACTION_CLEAR_CALLS_SOFT:
@@ -271,16 +314,8 @@ call_raw_handle_key(ui_t *ui, int key)
                 return KEY_PROPAGATED;
             case ACTION_SHOW_ALIAS:
                 setting_toggle(SETTING_DISPLAY_ALIAS);
-                // Create a new pad (forces messages draw)
-                delwin(info->pad);
-                info->pad = newpad(500, COLS);
-                info->last = NULL;
-                // Force refresh panel
-                if (info->group) {
-                    call_raw_set_group(info->group);
-                } else {
-                    call_raw_set_msg(info->msg);
-                }
+                // Print all messages again with addresses or aliases
+                call_raw_clear(ui);
                 break;
             default:
                 // Parse next action
@@ -322,8 +357,7 @@ call_raw_set_group(sip_call_group_t *group)
     info->msg = NULL;
 
     // Initialize internal pad
-    info->padline = 0;
-    wclear(info->pad);
+    call_raw_clear(ui);
 
     return 0;
 }
@@ -348,8 +382,7 @@ call_raw_set_msg(sip_msg_t *msg)
     info->msg = msg;
 
     // Initialize internal pad
-    info->padline = 0;
-    wclear(info->pad);
+    call_raw_clear(ui);
 
     // Print the message in the pad
     call_raw_print_msg(ui, msg);
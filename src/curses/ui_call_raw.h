@@ -35,6 +35,9 @@
 #include "config.h"
 #include "ui_manager.h"
 
+//! ncurses pads can't have more lines than this
+#define CALL_RAW_MAX_LINES 32767
+
 //! Sorter declaration of struct call_raw_info
 typedef struct call_raw_info call_raw_info_t;
 
@@ -55,6 +58,8 @@ struct call_raw_info {
     WINDOW *pad;
     //! Already used lines of the window pad
     int padline;
+    //! Number of messages printed in the window pad
+    int printed;
     //! Scroll position of the window pad
     int scroll;
 };
@@ -115,6 +120,39 @@ call_raw_redraw(ui_t *ui);
 int
 call_raw_draw(ui_t *ui);
 
+/**
+ * @brief Remove all printed messages from the pad
+ *
+ * Messages will be printed again in the next draw.
+ *
+ * @param ui UI structure pointer
+ */
+void
+call_raw_clear(ui_t *ui);
+
+/**
+ * @brief Get the number of lines required to print a message payload
+ *
+ * @param msg Message to be printed
+ * @param width Width of the pad
+ * @return number of payload lines
+ */
+int
+call_raw_msg_lines(sip_msg_t *msg, int width);
+
+/**
+ * @brief Make room in the pad for more lines
+ *
+ * Pad size is doubled when required, keeping already printed lines,
+ * up to CALL_RAW_MAX_LINES.
+ *
+ * @param ui UI structure pointer
+ * @param lines Number of lines to be printed after the used ones
+ * @return 0 if the pad has room for the lines, 1 otherwise
+ */
+int
+call_raw_reserve(ui_t *ui, int lines);
+
 /**
  * @brief Draw a message in call Raw
  *
@@ -122,7 +160,7 @@ call_raw_draw(ui_t *ui);
  *
  * @param panel Ncurses panel pointer
  * @param msg New message to be printed
- * @return 0 in call cases
+ * @return 0 if the message has been printed, -1 if the pad is full
  */
 int
 call_raw_print_msg(ui_t *ui, sip_msg_t *msg);
@@ -35,9 +35,11 @@
 #include <math.h>
 #include <stdlib.h>
 #include <locale.h>
+#include <time.h>
 #include "setting.h"
 #include "ui_manager.h"
 #include "capture.h"
+#include "filter.h"
 #include "ui_call_list.h"
 #include "ui_call_flow.h"
 #include "ui_call_raw.h"
@@ -63,7 +65,8 @@ static ui_t *panel_pool[] = {
     &ui_msg_diff,
     &ui_column_select,
     &ui_settings,
-    &ui_stats
+    &ui_stats,
+    &ui_pipeline
 };
 
 int
@@ -185,6 +188,11 @@ ui_find_by_type(enum panel_types type)
     return NULL;
 }
 
+/**
+ * @brief Redraw scheduler state
+ */
+static ui_frame_t frame = { 0 };
+
 int
 ui_wait_for_input()
 {
@@ -201,24 +209,9 @@ ui_wait_for_input()
         // Get panel interface structure
         ui = ui_find_by_panel(panel);
 
-        // Set character input timeout 200 ms
-        halfdelay(REFRESHTHSECS);
-
-        // Avoid parsing any packet while UI is being drawn
-        capture_lock();
-        // Query the interface if it needs to be redrawn
-        if (ui_draw_redraw(ui)) {
-            // Redraw this panel
-            if (ui_draw_panel(ui) != 0) {
-                capture_unlock();
-                return -1;
-            }
-        }
-        capture_unlock();
-
-        // Update panel stack
-        update_panels();
-        doupdate();
+        // Draw pending changes if next frame is due
+        if (ui_frame_draw(ui) != 0)
+            return -1;
 
         // Get topmost panel
         panel = panel_below(NULL);
@@ -227,6 +220,9 @@ ui_wait_for_input()
         win = panel_window(panel);
         keypad(win, TRUE);
 
+        // Wait for a key until next frame is due
+        wtimeout(win, ui_frame_timeout());
+
         // Get pressed key
         int c = wgetch(win);
 
@@ -234,6 +230,10 @@ ui_wait_for_input()
         if (c == ERR)
             continue;
 
+        // Draw user actions without waiting for next frame
+        frame.pending = true;
+        frame.next = 0;
+
         capture_lock();
         // Handle received key
         int hld = KEY_NOT_HANDLED;
@@ -260,6 +260,94 @@ ui_wait_for_input()
     return 0;
 }
 
+uint64_t
+ui_frame_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int
+ui_frame_budget()
+{
+    int fps = setting_get_intvalue(SETTING_MAXFPS);
+
+    if (fps < UI_MIN_FPS)
+        fps = UI_MIN_FPS;
+    if (fps > UI_MAX_FPS)
+        fps = UI_MAX_FPS;
+
+    return 1000 / fps;
+}
+
+int
+ui_frame_draw(ui_t *ui)
+{
+    uint64_t start;
+    int budget;
+
+    // Avoid parsing any packet while UI is being drawn
+    capture_lock();
+
+    // Query the interface if it needs to be redrawn
+    if (ui_draw_redraw(ui))
+        frame.pending = true;
+
+    // Nothing to draw or too early for next frame
+    start = ui_frame_now();
+    if (!frame.pending || start < frame.next) {
+        capture_unlock();
+        return 0;
+    }
+
+    // Redraw this panel
+    if (ui_draw_panel(ui) != 0) {
+        capture_unlock();
+        return -1;
+    }
+    capture_unlock();
+
+    // Update panel stack
+    update_panels();
+    doupdate();
+
+    // Schedule next frame. If this one took longer than its budget, leave
+    // the same time for packet parsing before drawing again
+    budget = ui_frame_budget();
+    frame.cost = ui_frame_now() - start;
+    if (frame.cost > (uint64_t) budget) {
+        frame.next = start + 2 * frame.cost;
+    } else {
+        frame.next = start + budget;
+    }
+    frame.pending = false;
+
+    return 0;
+}
+
+int
+ui_frame_timeout()
+{
+    uint64_t now;
+    int timeout;
+
+    if (!frame.pending) {
+        // Nothing to draw, check for changes once per frame
+        timeout = ui_frame_budget();
+    } else {
+        // Wake up when next frame is due
+        now = ui_frame_now();
+        timeout = (frame.next > now) ? frame.next - now : 0;
+    }
+
+    // Check for changes more often while filtering calls
+    if (filter_update_pending() && timeout > UI_FILTER_TIMEOUT)
+        timeout = UI_FILTER_TIMEOUT;
+
+    return timeout;
+}
+
 int
 ui_default_handle_key(ui_t *ui, int key)
 {
@@ -352,8 +440,9 @@ draw_message(WINDOW *win, sip_msg_t *msg)
 int
 draw_message_pos(WINDOW *win, sip_msg_t *msg, int starting)
 {
-    int height, width, line, column, i;
-    const char *cur_line, *payload, *method = NULL;
+    int height, width, line, column, i, len, methodlen = 0;
+    const char *cur_line, *payload, *method = NULL, *colon;
+    bool sdp;
     int syntax = setting_enabled(SETTING_SYNTAX);
     const char *nonascii = setting_get_value(SETTING_CR_NON_ASCII);
 
@@ -368,15 +457,21 @@ draw_message_pos(WINDOW *win, sip_msg_t *msg, int starting)
     // Get message method (if request)
     if (msg_is_request(msg)) {
         method = sip_method_str(msg->reqresp);
+        methodlen = strlen(method);
     }
 
     // Get packet payload
     cur_line = payload = (const char *) msg_get_payload(msg);
+    len = strlen(payload);
+
+    // Syntax of the current line only depends on its beginning
+    colon = strchr(cur_line, ':');
+    sdp = strcspn(cur_line, "=") == 1;
 
     // Print msg payload
     line = starting;
     column = 0;
-    for (i = 0; i < strlen(payload); i++) {
+    for (i = 0; i < len; i++) {
         // If syntax highlighting is enabled
         if (syntax) {
             // First line highlight
@@ -390,13 +485,13 @@ draw_message_pos(WINDOW *win, sip_msg_t *msg, int starting)
                     attrs = A_BOLD | COLOR_PAIR(CP_RED_ON_DEF);
 
                 // SIP URI syntax
-                if (method && i == strlen(method) + 1) {
+                if (method && i == methodlen + 1) {
                     attrs = A_BOLD | COLOR_PAIR(CP_CYAN_ON_DEF);
                 }
             } else {
 
                 // Header syntax
-                if (strchr(cur_line, ':') && payload + i < strchr(cur_line, ':'))
+                if (colon && payload + i < colon)
                     attrs = A_NORMAL | COLOR_PAIR(CP_GREEN_ON_DEF);
 
                 // Call-ID Header syntax
@@ -428,7 +523,7 @@ draw_message_pos(WINDOW *win, sip_msg_t *msg, int starting)
                 }
 
                 // SDP syntax
-                if (strcspn(cur_line, "=") == 1)
+                if (sdp)
                     attrs = A_NORMAL | COLOR_PAIR(CP_DEFAULT);
             }
 
@@ -447,8 +542,11 @@ draw_message_pos(WINDOW *win, sip_msg_t *msg, int starting)
             continue;
 
         // Store where the line begins
-        if (payload[i] == '\n')
-            cur_line =payload + i + 1;
+        if (payload[i] == '\n') {
+            cur_line = payload + i + 1;
+            colon = strchr(cur_line, ':');
+            sdp = strcspn(cur_line, "=") == 1;
+        }
 
         // Move to the next line if line is filled or a we reach a line break
         if (column > width - 1 || payload[i] == '\n') {
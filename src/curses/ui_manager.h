@@ -43,12 +43,34 @@
 #include "keybinding.h"
 #include "setting.h"
 
-//! Refresh UI every 200 ms
-#define REFRESHTHSECS   2
+//! Limits of the redraw rate setting
+#define UI_MIN_FPS      1
+#define UI_MAX_FPS      60
+//! Check for changes every 100 ms while filtering calls
+#define UI_FILTER_TIMEOUT 100
 //! Default dialog dimensions
 #define DIALOG_MAX_WIDTH 100
 #define DIALOG_MIN_WIDTH 40
 
+//! Shorter declaration of ui_frame struct
+typedef struct ui_frame ui_frame_t;
+
+/**
+ * @brief Redraw scheduler state
+ *
+ * Changes in the displayed data are not drawn as soon as they happen.
+ * They are accumulated until the next frame is due, so the screen is
+ * drawn at most maxfps times per second whatever the packet rate is.
+ */
+struct ui_frame {
+    //! There are changes not yet drawn on screen
+    bool pending;
+    //! Time (ms) when next frame can be drawn
+    uint64_t next;
+    //! Time (ms) spent drawing last frame
+    uint64_t cost;
+};
+
 /**
  * Define existing panels
  */
@@ -61,6 +83,7 @@ extern ui_t ui_msg_diff;
 extern ui_t ui_column_select;
 extern ui_t ui_settings;
 extern ui_t ui_stats;
+extern ui_t ui_pipeline;
 
 /**
  * @brief Initialize ncurses mode
@@ -117,6 +140,40 @@ ui_find_by_type(enum panel_types type);
 int
 ui_wait_for_input();
 
+/**
+ * @brief Current monotonic time in milliseconds
+ */
+uint64_t
+ui_frame_now();
+
+/**
+ * @brief Time budget (ms) of each frame based on maxfps setting
+ */
+int
+ui_frame_budget();
+
+/**
+ * @brief Draw the panel if a frame is pending and due
+ *
+ * Redraw requests are accumulated until next frame time. When a frame
+ * takes longer to draw than its budget, next frames are delayed so
+ * drawing never uses more than half of the capture lock time.
+ *
+ * @param ui Panel to be drawn
+ * @return 0 if panel was drawn or not due, -1 on draw error
+ */
+int
+ui_frame_draw(ui_t *ui);
+
+/**
+ * @brief Milliseconds to wait for input before next frame is due
+ *
+ * While calls are being filtered the wait is shortened, so the
+ * filter progress is checked more often.
+ */
+int
+ui_frame_timeout();
+
 /**
  * @brief Default handler for keys
  *
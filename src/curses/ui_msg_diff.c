@@ -100,6 +100,7 @@ msg_diff_create(ui_t *ui)
 void
 msg_diff_destroy(ui_t *ui)
 {
+    msg_diff_clear(ui);
     sng_free(msg_diff_info(ui));
     ui_panel_destroy(ui);
 }
@@ -110,36 +111,250 @@ msg_diff_info(ui_t *ui)
     return (msg_diff_info_t*) panel_userptr(ui->panel);
 }
 
+msg_diff_line_t *
+msg_diff_split_lines(const char *payload, int *count)
+{
+    msg_diff_line_t *lines;
+    const char *c;
+    int cnt = 0;
+
+    // Count payload lines (last one may not end with a line break)
+    for (c = payload; *c; c++) {
+        if (*c == '\n')
+            cnt++;
+    }
+    if (c > payload && *(c - 1) != '\n')
+        cnt++;
+
+    if (!(lines = sng_malloc(sizeof(msg_diff_line_t) * (cnt + 1))))
+        return NULL;
+
+    // Store each line position and FNV-1a hash of its content
+    for (c = payload, *count = 0; *c; (*count)++) {
+        lines[*count].text = c;
+        lines[*count].hash = 2166136261u;
+        do {
+            lines[*count].hash = (lines[*count].hash ^ (unsigned char) *c) * 16777619u;
+        } while (*c++ != '\n' && *c);
+        lines[*count].len = c - lines[*count].text;
+    }
+
+    return lines;
+}
+
+bool
+msg_diff_line_equals(msg_diff_line_t *line1, msg_diff_line_t *line2)
+{
+    return line1->hash == line2->hash && line1->len == line2->len
+           && !memcmp(line1->text, line2->text, line1->len);
+}
+
+void
+msg_diff_compare_lines(msg_diff_line_t *one, int onecnt, msg_diff_line_t *two, int twocnt)
+{
+    int i, x, y;
+
+    // Skip common lines at the beginning
+    while (onecnt && twocnt && msg_diff_line_equals(one, two)) {
+        one++; two++;
+        onecnt--; twocnt--;
+    }
+
+    // Skip common lines at the end
+    while (onecnt && twocnt && msg_diff_line_equals(one + onecnt - 1, two + twocnt - 1)) {
+        onecnt--; twocnt--;
+    }
+
+    // Split both lists and compare each half, unless there's nothing in common
+    if (onecnt && twocnt && msg_diff_bisect(one, onecnt, two, twocnt, &x, &y) == 0) {
+        msg_diff_compare_lines(one, x, two, y);
+        msg_diff_compare_lines(one + x, onecnt - x, two + y, twocnt - y);
+        return;
+    }
+
+    // Remaining lines are only in one of the messages
+    for (i = 0; i < onecnt; i++)
+        one[i].changed = true;
+    for (i = 0; i < twocnt; i++)
+        two[i].changed = true;
+}
+
 int
-msg_diff_line_highlight(const char* payload1, const char* payload2, char *highlight)
+msg_diff_bisect(msg_diff_line_t *one, int onecnt, msg_diff_line_t *two, int twocnt,
+                int *x, int *y)
 {
-    char search[MAX_SIP_PAYLOAD];
-    int len, i;
-
-    // Initialize search terms
-    memset(search, 0, sizeof(search));
-    len = 0;
-
-    for (i = 0; i < strlen(payload1); i++) {
-        // Store this char in the search term
-        search[len++] = payload1[i];
-        // If we have a full line in search array
-        if (payload1[i] == '\n') {
-            // Check if this line is in the other payload
-            if (strstr(payload2, search) == NULL) {
-                // Highlight this line as different from the other payload
-                memset(highlight + i - len + 1, '1', len);
+    int maxd = (onecnt + twocnt + 1) / 2;
+    int vlen = 2 * maxd + 2;
+    int delta = onecnt - twocnt;
+    bool front = (delta % 2 != 0);
+    int kfstart = 0, kfend = 0, kbstart = 0, kbend = 0;
+    int d, k, kpos, xf, yf, xb, yb, i, ret = 1;
+    int *vf, *vb;
+
+    // Furthest reaching x position in each diagonal, forward and backward
+    vf = sng_malloc(sizeof(int) * vlen);
+    vb = sng_malloc(sizeof(int) * vlen);
+    for (i = 0; i < vlen; i++)
+        vf[i] = vb[i] = -1;
+    vf[maxd + 1] = vb[maxd + 1] = 0;
+
+    for (d = 0; d < maxd && ret; d++) {
+        // Walk the forward path one step
+        for (k = -d + kfstart; k <= d - kfend && ret; k += 2) {
+            kpos = maxd + k;
+            if (k == -d || (k != d && vf[kpos - 1] < vf[kpos + 1])) {
+                xf = vf[kpos + 1];
+            } else {
+                xf = vf[kpos - 1] + 1;
             }
+            yf = xf - k;
+            while (xf < onecnt && yf < twocnt && msg_diff_line_equals(&one[xf], &two[yf])) {
+                xf++; yf++;
+            }
+            vf[kpos] = xf;
+
+            if (xf > onecnt) {
+                // Ran off the right of the graph
+                kfend += 2;
+            } else if (yf > twocnt) {
+                // Ran off the bottom of the graph
+                kfstart += 2;
+            } else if (front) {
+                // Check if path overlaps with the backward one
+                kpos = maxd + delta - k;
+                if (kpos >= 0 && kpos < vlen && vb[kpos] != -1 && xf >= onecnt - vb[kpos]) {
+                    *x = xf; *y = yf;
+                    ret = 0;
+                }
+            }
+        }
 
-            // Reset search terms
-            memset(search, 0, sizeof(search));
-            len = 0;
+        // Walk the backward path one step
+        for (k = -d + kbstart; k <= d - kbend && ret; k += 2) {
+            kpos = maxd + k;
+            if (k == -d || (k != d && vb[kpos - 1] < vb[kpos + 1])) {
+                xb = vb[kpos + 1];
+            } else {
+                xb = vb[kpos - 1] + 1;
+            }
+            yb = xb - k;
+            while (xb < onecnt && yb < twocnt
+                   && msg_diff_line_equals(&one[onecnt - xb - 1], &two[twocnt - yb - 1])) {
+                xb++; yb++;
+            }
+            vb[kpos] = xb;
+
+            if (xb > onecnt) {
+                // Ran off the left of the graph
+                kbend += 2;
+            } else if (yb > twocnt) {
+                // Ran off the top of the graph
+                kbstart += 2;
+            } else if (!front) {
+                // Check if path overlaps with the forward one
+                kpos = maxd + delta - k;
+                if (kpos >= 0 && kpos < vlen && vf[kpos] != -1 && vf[kpos] >= onecnt - xb) {
+                    *x = vf[kpos];
+                    *y = vf[kpos] - (kpos - maxd);
+                    ret = 0;
+                }
+            }
         }
     }
 
+    sng_free(vf);
+    sng_free(vb);
+    return ret;
+}
+
+vector_t *
+msg_diff_hunks(msg_diff_line_t *one, int onecnt, msg_diff_line_t *two, int twocnt)
+{
+    vector_t *hunks = vector_create(0, 10);
+    msg_diff_hunk_t *hunk;
+    int i = 0, j = 0;
+
+    while (i < onecnt || j < twocnt) {
+        // Common lines appear in the same order in both messages
+        if (i < onecnt && j < twocnt && !one[i].changed && !two[j].changed) {
+            i++; j++;
+            continue;
+        }
+
+        // Group all consecutive changed lines of both messages
+        hunk = sng_malloc(sizeof(msg_diff_hunk_t));
+        hunk->one_pos = i;
+        hunk->two_pos = j;
+        while (i < onecnt && one[i].changed)
+            i++;
+        while (j < twocnt && two[j].changed)
+            j++;
+        hunk->one_len = i - hunk->one_pos;
+        hunk->two_len = j - hunk->two_pos;
+        vector_append(hunks, hunk);
+    }
+
+    return hunks;
+}
+
+int
+msg_diff_compare(ui_t *ui)
+{
+    msg_diff_info_t *info = msg_diff_info(ui);
+    msg_diff_line_t *one, *two, *line;
+    msg_diff_hunk_t *hunk;
+    const char *payload1, *payload2;
+    int onecnt = 0, twocnt = 0, i;
+    vector_iter_t it;
+
+    // Messages already compared
+    if (info->hunks)
+        return 0;
+
+    if (!info->one || !info->two)
+        return -1;
+
+    payload1 = msg_get_payload(info->one);
+    payload2 = msg_get_payload(info->two);
+
+    // Compare message lines
+    one = msg_diff_split_lines(payload1, &onecnt);
+    two = msg_diff_split_lines(payload2, &twocnt);
+    msg_diff_compare_lines(one, onecnt, two, twocnt);
+    info->hunks = msg_diff_hunks(one, onecnt, two, twocnt);
+
+    // Highlight the lines of each hunk
+    info->one_hl = sng_malloc(strlen(payload1) + 1);
+    info->two_hl = sng_malloc(strlen(payload2) + 1);
+    it = vector_iterator(info->hunks);
+    while ((hunk = vector_iterator_next(&it))) {
+        for (i = 0; i < hunk->one_len; i++) {
+            line = &one[hunk->one_pos + i];
+            memset(info->one_hl + (line->text - payload1), '1', line->len);
+        }
+        for (i = 0; i < hunk->two_len; i++) {
+            line = &two[hunk->two_pos + i];
+            memset(info->two_hl + (line->text - payload2), '1', line->len);
+        }
+    }
+
+    sng_free(one);
+    sng_free(two);
     return 0;
 }
 
+void
+msg_diff_clear(ui_t *ui)
+{
+    msg_diff_info_t *info = msg_diff_info(ui);
+
+    vector_destroy_items(info->hunks);
+    sng_free(info->one_hl);
+    sng_free(info->two_hl);
+    info->hunks = NULL;
+    info->one_hl = info->two_hl = NULL;
+}
+
 void
 msg_diff_draw_footer(ui_t *ui)
 {
@@ -156,16 +371,15 @@ msg_diff_draw(ui_t *ui)
 {
     // Get panel information
     msg_diff_info_t *info = msg_diff_info(ui);
-    char highlight[MAX_SIP_PAYLOAD];
+
+    // Compare messages (only the first time)
+    if (msg_diff_compare(ui) != 0)
+        return -1;
 
     // Draw first message
-    memset(highlight, 0, sizeof(highlight));
-    msg_diff_line_highlight(msg_get_payload(info->one), msg_get_payload(info->two), highlight);
-    msg_diff_draw_message(info->one_win, info->one, highlight);
+    msg_diff_draw_message(info->one_win, info->one, info->one_hl);
     // Draw second message
-    memset(highlight, 0, sizeof(highlight));
-    msg_diff_line_highlight(msg_get_payload(info->two), msg_get_payload(info->one), highlight);
-    msg_diff_draw_message(info->two_win, info->two, highlight);
+    msg_diff_draw_message(info->two_win, info->two, info->two_hl);
 
     // Redraw footer
     msg_diff_draw_footer(ui);
@@ -179,6 +393,7 @@ msg_diff_draw_message(WINDOW *win, sip_msg_t *msg, char *highlight)
     int height, width, line, column, i;
     char header[MAX_SIP_PAYLOAD];
     const char * payload = msg_get_payload(msg);
+    int len = strlen(payload);
 
     // Clear the window
     werase(win);
@@ -193,7 +408,7 @@ msg_diff_draw_message(WINDOW *win, sip_msg_t *msg, char *highlight)
     // Print msg payload
     line = 2;
     column = 0;
-    for (i = 0; i < strlen(payload); i++) {
+    for (i = 0; i < len; i++) {
         if (payload[i] == '\r')
             continue;
 
@@ -232,6 +447,9 @@ msg_diff_set_msgs(ui_t *ui, sip_msg_t *one, sip_msg_t *two)
     info->one = one;
     info->two = two;
 
+    // Compare the new messages in next draw
+    msg_diff_clear(ui);
+
     return 0;
 }
 
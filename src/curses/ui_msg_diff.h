@@ -33,6 +33,42 @@
 
 //! Sorter declaration of struct msg_diff_info
 typedef struct msg_diff_info msg_diff_info_t;
+//! Sorter declaration of struct msg_diff_line
+typedef struct msg_diff_line msg_diff_line_t;
+//! Sorter declaration of struct msg_diff_hunk
+typedef struct msg_diff_hunk msg_diff_hunk_t;
+
+/**
+ * @brief Payload line compared between messages
+ */
+struct msg_diff_line {
+    //! Line beginning in the payload
+    const char *text;
+    //! Line length (including line break)
+    int len;
+    //! Hash of the line content
+    uint32_t hash;
+    //! Line is not in the other message payload
+    bool changed;
+};
+
+/**
+ * @brief Consecutive lines that differ between both messages
+ *
+ * Hunks with only lines of the first message are deletions, with only
+ * lines of the second message are insertions and with lines of both
+ * messages are changes.
+ */
+struct msg_diff_hunk {
+    //! First changed line in the first message
+    int one_pos;
+    //! Number of changed lines in the first message
+    int one_len;
+    //! First changed line in the second message
+    int two_pos;
+    //! Number of changed lines in the second message
+    int two_len;
+};
 
 /**
  * @brief Call raw status information
@@ -49,6 +85,12 @@ struct msg_diff_info {
     WINDOW *one_win;
     //! Right displayed subwindow
     WINDOW *two_win;
+    //! Differences between both messages (NULL if not compared yet)
+    vector_t *hunks;
+    //! Highlighted characters of first message payload
+    char *one_hl;
+    //! Highlighted characters of second message payload
+    char *two_hl;
 };
 
 /**
@@ -90,6 +132,81 @@ msg_diff_destroy(ui_t *ui);
 msg_diff_info_t *
 msg_diff_info(ui_t *ui);
 
+/**
+ * @brief Split a payload into hashed lines
+ *
+ * @param payload Message payload
+ * @param count Number of lines of the payload
+ * @return allocated array of lines
+ */
+msg_diff_line_t *
+msg_diff_split_lines(const char *payload, int *count);
+
+/**
+ * @brief Check if two payload lines have the same content
+ */
+bool
+msg_diff_line_equals(msg_diff_line_t *line1, msg_diff_line_t *line2);
+
+/**
+ * @brief Flag the lines that differ between two list of lines
+ *
+ * Myers diff algorithm in linear space: common lines at the beginning
+ * and end are skipped, then the list is split at the middle snake of
+ * the shortest edit script and both halves are compared recursively.
+ * This takes O((N+M)D) time, being D the number of different lines.
+ *
+ * @param one Lines of the first message
+ * @param onecnt Number of lines of the first message
+ * @param two Lines of the second message
+ * @param twocnt Number of lines of the second message
+ */
+void
+msg_diff_compare_lines(msg_diff_line_t *one, int onecnt, msg_diff_line_t *two, int twocnt);
+
+/**
+ * @brief Find the middle snake of the shortest edit script
+ *
+ * @param one Lines of the first message
+ * @param onecnt Number of lines of the first message
+ * @param two Lines of the second message
+ * @param twocnt Number of lines of the second message
+ * @param x Split position in first message lines
+ * @param y Split position in second message lines
+ * @return 0 if a split has been found, 1 if lists have no common lines
+ */
+int
+msg_diff_bisect(msg_diff_line_t *one, int onecnt, msg_diff_line_t *two, int twocnt,
+                int *x, int *y);
+
+/**
+ * @brief Group changed lines of both messages into hunks
+ *
+ * @return a vector of hunks
+ */
+vector_t *
+msg_diff_hunks(msg_diff_line_t *one, int onecnt, msg_diff_line_t *two, int twocnt);
+
+/**
+ * @brief Compare panel messages
+ *
+ * Differences are only calculated once for each pair of messages. The
+ * panel highlight buffers are filled from the resulting hunks.
+ *
+ * @param ui UI structure pointer
+ * @return 0 if messages have been compared, -1 otherwise
+ */
+int
+msg_diff_compare(ui_t *ui);
+
+/**
+ * @brief Remove the cached differences of the panel messages
+ *
+ * @param ui UI structure pointer
+ */
+void
+msg_diff_clear(ui_t *ui);
+
 /**
  * @brief Redraw panel data
  *
@@ -83,10 +83,8 @@ ui_draw_redraw(ui_t *ui)
         return false;
 
     // If ui has changed, force redraw. Don't even ask.
-    if (ui->changed) {
-        ui->changed = false;
+    if (ui->changed)
         return true;
-    }
 
     // Query the panel if its needs to be redrawn
     if (ui->redraw) {
@@ -98,18 +96,23 @@ ui_draw_redraw(ui_t *ui)
 int
 ui_draw_panel(ui_t *ui)
 {
+    int ret = 0;
+
     //! Sanity check, this should not happen
     if (!ui || !ui->panel)
         return -1;
 
     // Request the panel to draw on the scren
     if (ui->draw) {
-        return ui->draw(ui);
+        ret = ui->draw(ui);
     } else {
         touchwin(ui->win);
     }
 
-    return 0;
+    // Panel changes are drawn now
+    ui->changed = false;
+
+    return ret;
 }
 
 int
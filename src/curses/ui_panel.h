@@ -74,6 +74,8 @@ enum panel_types {
     PANEL_SETTINGS,
     //! Stats panel
     PANEL_STATS,
+    //! Pipeline timers panel
+    PANEL_PIPELINE,
     //! Panel Counter
     PANEL_COUNT,
 };
@@ -102,7 +104,7 @@ struct ui {
     int y;
     //! Panel Type @see panel_types enum
     enum panel_types type;
-    //! Flag this panel as redraw required
+    //! Flag this panel as redraw required (until next draw)
     bool changed;
 
     //! Constructor for this panel
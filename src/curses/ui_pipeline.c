@@ -0,0 +1,114 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file ui_pipeline.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Source of functions defined in ui_pipeline.h
+ */
+/*
+ * +--------------------------------------------------------------------------+
+ * |                          Packet Pipeline Timers                          |
+ * +--------------------------------------------------------------------------+
+ * |  Stage             Count    Avg(us)    P50(us)    P90(us)    P99(us)     |
+ * |  reasm_ip         123456       0.21       0.20       0.31       0.88     |
+ * |  reasm_tcp          1234       0.45       0.41       0.62       1.25     |
+ * |  ...                                                                     |
+ * +--------------------------------------------------------------------------+
+ * |                            Press ESC to leave                            |
+ * +--------------------------------------------------------------------------+
+ *
+ */
+#include "config.h"
+#include <string.h>
+#include "metrics.h"
+#include "ui_manager.h"
+#include "ui_pipeline.h"
+
+/**
+ * Ui Structure definition for Pipeline timers panel
+ */
+ui_t ui_pipeline = {
+    .type = PANEL_PIPELINE,
+    .panel = NULL,
+    .create = pipeline_create,
+    .destroy = ui_panel_destroy,
+    .draw = pipeline_draw,
+    .handle_key = NULL
+};
+
+void
+pipeline_create(ui_t *ui)
+{
+    // Calculate window dimensions
+    ui_panel_create(ui, METRICS_STAGE_COUNT + 9, 78);
+
+    // Set the window title and boxes
+    mvwprintw(ui->win, 1, ui->width / 2 - 11, "Packet Pipeline Timers");
+    wattron(ui->win, COLOR_PAIR(CP_BLUE_ON_DEF));
+    title_foot_box(ui->panel);
+    mvwprintw(ui->win, ui->height - 2, ui->width / 2 - 9, "Press ESC to leave");
+    wattroff(ui->win, COLOR_PAIR(CP_BLUE_ON_DEF));
+}
+
+int
+pipeline_draw(ui_t *ui)
+{
+    metrics_histogram_t *histogram;
+    uint64_t count;
+    int i, line;
+
+    // Clear previous data
+    for (line = 3; line < ui->height - 3; line++)
+        mvwhline(ui->win, line, 1, ' ', ui->width - 2);
+
+    // Ignore this screen when timers are disabled
+    if (!metrics.stages) {
+        mvwprintw(ui->win, 3, 3, "Stage timers are disabled.");
+        mvwprintw(ui->win, 4, 3, "Add 'set metrics.stages on' to sngreprc to enable them.");
+        return 0;
+    }
+
+    wattron(ui->win, A_BOLD);
+    mvwprintw(ui->win, 3, 3, "%-10s %12s %9s %9s %9s %9s %9s",
+              "Stage", "Count", "Avg(us)", "P50(us)", "P90(us)", "P99(us)", "Max(us)");
+    wattroff(ui->win, A_BOLD);
+
+    for (i = 0; i < METRICS_STAGE_COUNT; i++) {
+        histogram = &metrics.stage[i];
+        count = metrics_histogram_count(histogram);
+        mvwprintw(ui->win, 4 + i, 3, "%-10s %12lu %9.2f %9.2f %9.2f %9.2f %9.2f",
+                  metrics_stage_name(i), (unsigned long) count,
+                  count ? atomic_load(&histogram->sum) / 1000.0 / count : 0,
+                  metrics_histogram_percentile(histogram, 50) / 1000.0,
+                  metrics_histogram_percentile(histogram, 90) / 1000.0,
+                  metrics_histogram_percentile(histogram, 99) / 1000.0,
+                  atomic_load(&histogram->max) / 1000.0);
+    }
+
+    // Where the report is written on SIGUSR2
+    if (strlen(metrics.report))
+        mvwprintw(ui->win, 5 + METRICS_STAGE_COUNT, 3, "SIGUSR2 report: %.*s",
+                  ui->width - 22, metrics.report);
+
+    return 0;
+}
@@ -0,0 +1,51 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file ui_pipeline.h
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Functions to manage ui window for packet pipeline timers display
+ */
+#ifndef __SNGREP_UI_PIPELINE_H
+#define __SNGREP_UI_PIPELINE_H
+
+/**
+ * @brief Creates a new pipeline timers panel
+ *
+ * @param ui UI structure pointer
+ */
+void
+pipeline_create(ui_t *ui);
+
+/**
+ * @brief Draw the pipeline timers panel data
+ *
+ * Stage histograms are updated by capture threads, so the panel
+ * displays current values each time it's drawn.
+ *
+ * @param ui UI structure pointer
+ * @return 0 in all cases
+ */
+int
+pipeline_draw(ui_t *ui);
+
+#endif /* __SNGREP_UI_PIPELINE_H */
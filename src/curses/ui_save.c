@@ -181,6 +181,9 @@ save_destroy(ui_t *ui)
 
     // Get panel information
     if ((info = save_info(ui))) {
+        // Stop any running save
+        save_task_destroy(info->task);
+
         // Remove panel form and fields
         unpost_form(info->form);
         free_form(info->form);
@@ -215,6 +218,10 @@ save_draw(ui_t *ui)
     // Get panel information
     save_info_t *info = save_info(ui);
 
+    // Show save progress instead of the form
+    if (info->task)
+        return save_task_draw(ui);
+
     // Get filter stats
     sip_stats_t stats = sip_calls_stats();
 
@@ -277,6 +284,23 @@ save_handle_key(ui_t *ui, int key)
     // Get panel information
     save_info_t *info = save_info(ui);
 
+    // Form is disabled while saving in background
+    if (info->task) {
+        // Save has finished, any key closes the panel
+        if (atomic_load(&info->task->finished)) {
+            ui_destroy(ui);
+            return KEY_HANDLED;
+        }
+        // Only allow canceling the running save
+        while ((action = key_find_action(key, action)) != ERR) {
+            if (action == ACTION_PREV_SCREEN) {
+                ui_destroy(ui);
+                break;
+            }
+        }
+        return KEY_HANDLED;
+    }
+
     // Get current field id
     field_idx = field_index(current_field(info->form));
 
@@ -351,7 +375,9 @@ save_handle_key(ui_t *ui, int key)
                 break;
             case ACTION_CONFIRM:
                 if (field_idx != FLD_SAVE_CANCEL) {
-                    save_to_file(ui);
+                    // Keep the panel open while saving in background
+                    if (save_to_file(ui) == 0 && info->task)
+                        return KEY_HANDLED;
                 }
                 ui_destroy(ui);
                 return KEY_HANDLED;
@@ -411,15 +437,9 @@ save_to_file(ui_t *ui)
     char savepath[MAX_SETTING_LEN];
     char savefile[MAX_SETTING_LEN];
     char fullfile[MAX_SETTING_LEN*2];
-    sip_call_t *call = NULL;
-    sip_msg_t *msg = NULL;
     pcap_dumper_t *pd = NULL;
     FILE *f = NULL;
-    int cur = 0, total = 0;
-    WINDOW *progress;
-    vector_iter_t calls, msgs, rtps, packets;
-    packet_t *packet;
-    vector_t *sorted;
+    vector_iter_t calls;
 
     // Get panel information
     save_info_t *info = save_info(ui);
@@ -476,14 +496,26 @@ save_to_file(ui_t *ui)
             dialog_run("Error: %s", strerror(errno));
             return 0;
         }
+        setvbuf(f, NULL, _IOFBF, DUMP_BUFFER_SIZE);
+    }
+
+    // Save selected message directly, there is nothing to wait for
+    if (info->savemode == SAVE_MESSAGE) {
+        if (info->saveformat == SAVE_TXT) {
+            // Save selected message to file
+            save_msg_txt(f, info->msg);
+            fclose(f);
+        } else {
+            // Save selected message packet to pcap
+            dump_packet(pd, info->msg->packet);
+            dump_close(pd);
+        }
+        dialog_run("Successfully saved selected SIP message to %s", savefile);
+        return 0;
     }
 
     // Get calls iterator
     switch (info->savemode) {
-        case SAVE_ALL:
-            // Get calls iterator
-            calls = sip_calls_iterator();
-            break;
         case SAVE_SELECTED:
             // Save selected packets to file
             calls = vector_iterator(info->group->calls);
@@ -494,86 +526,189 @@ save_to_file(ui_t *ui)
             vector_iterator_set_filter(&calls, filter_check_call);
             break;
         default:
+            // Get calls iterator
+            calls = sip_calls_iterator();
             break;
     }
 
-    if (info->savemode == SAVE_MESSAGE) {
-        if (info->saveformat == SAVE_TXT) {
-            // Save selected message to file
-            save_msg_txt(f, info->msg);
+    // Save dialogs in background
+    if (!(info->task = save_task_create(ui, calls, pd, f, fullfile))) {
+        if (pd) {
+            dump_close(pd);
         } else {
-            // Save selected message packet to pcap
-            dump_packet(pd, info->msg->packet);
+            fclose(f);
+        }
+        unlink(fullfile);
+        dialog_run("Unable to start saving dialogs to %s", savefile);
+        return 1;
+    }
+
+    // Capture can continue while the file is written
+    capture_set_paused(0);
+    curs_set(0);
+
+    return 0;
+}
+
+save_task_t *
+save_task_create(ui_t *ui, vector_iter_t calls, pcap_dumper_t *pd, FILE *f,
+                 const char *filename)
+{
+    save_task_t *task;
+    sip_call_t *call;
+    sip_msg_t *msg;
+    vector_iter_t it, msgs;
+
+    // Get panel information
+    save_info_t *info = save_info(ui);
+
+    if (!(task = sng_malloc(sizeof(save_task_t))))
+        return NULL;
+
+    task->saveformat = info->saveformat;
+    task->pd = pd;
+    task->f = f;
+    strncpy(task->filename, filename, sizeof(task->filename) - 1);
+
+    if (task->saveformat == SAVE_TXT) {
+        // Count saved messages
+        it = calls;
+        while ((call = vector_iterator_next(&it)))
+            task->total += call_msg_count(call);
+
+        // Copy messages in calls order (lists can be bigger than sng_malloc limit)
+        if (task->total && !(task->msgs = malloc(sizeof(sip_msg_t *) * task->total))) {
+            sng_free(task);
+            return NULL;
         }
-    } else if (info->saveformat == SAVE_TXT) {
-        // Save selected packets to file
+        task->total = 0;
         while ((call = vector_iterator_next(&calls))) {
+            task->dialogs++;
             msgs = vector_iterator(call->msgs);
-            // Save SIP message content
-            while ((msg = vector_iterator_next(&msgs))) {
-                save_msg_txt(f, msg);
-            }
+            while ((msg = vector_iterator_next(&msgs)))
+                task->msgs[task->total++] = msg;
         }
     } else {
-        // Store all messages in a time sorted vector
-        sorted = vector_create(100, 50);
-        vector_set_sorter(sorted, capture_packet_time_sorter);
-
-        // Count packages for progress bar
+        // Merge call messages and packets in time order
+        if (!(task->merge = capture_merge_create())) {
+            sng_free(task);
+            return NULL;
+        }
         while ((call = vector_iterator_next(&calls))) {
-            total += vector_count(call->msgs);
-            if (info->saveformat == SAVE_PCAP_RTP)
-                total += vector_count(call->rtp_packets);
+            task->dialogs++;
+            capture_merge_add(task->merge, call->msgs, true);
+            if (task->saveformat == SAVE_PCAP_RTP)
+                capture_merge_add(task->merge, call->rtp_packets, false);
         }
-        vector_iterator_reset(&calls);
+        task->total = task->merge->total;
+    }
 
-        progress = dialog_progress_run("Saving packets...");
-        dialog_progress_set_value(progress, 0);
+    // Don't free saved messages and packets until the worker has finished
+    sip_calls_hold(true);
+    task->held = true;
 
-        // Save selected packets to file
-        while ((call = vector_iterator_next(&calls))) {
-            msgs = vector_iterator(call->msgs);
-            // Save SIP message content
-            while ((msg = vector_iterator_next(&msgs))) {
-                // Update progress bar dialog
-                dialog_progress_set_value(progress, (++cur * 100) / total);
-                vector_append(sorted, msg->packet);
-            }
+    if (pthread_create(&task->thread, NULL, save_task_run, task) != 0) {
+        sip_calls_hold(false);
+        capture_merge_destroy(task->merge);
+        free(task->msgs);
+        sng_free(task);
+        return NULL;
+    }
 
-            // Save RTP packets
-            if (info->saveformat == SAVE_PCAP_RTP) {
-                rtps = vector_iterator(call->rtp_packets);
-                while ((packet = vector_iterator_next(&rtps))) {
-                    // Update progress bar dialog
-                    dialog_progress_set_value(progress, (++cur * 100) / total);
-                    vector_append(sorted, packet);
-                }
-            }
-        }
+    return task;
+}
 
-        // Save sorted packets
-        packets = vector_iterator(sorted);
-        while ((packet = vector_iterator_next(&packets))) {
-            dump_packet(pd, packet);
-        }
+void
+save_task_destroy(save_task_t *task)
+{
+    if (!task)
+        return;
 
-        dialog_progress_destroy(progress);
-    }
+    // Stop the worker and wait for it
+    atomic_store(&task->cancel, true);
+    pthread_join(task->thread, NULL);
 
-    // Close saved file
-    if (info->saveformat == SAVE_PCAP || info->saveformat == SAVE_PCAP_RTP) {
-        dump_close(pd);
+    // Saved calls can be rotated again
+    if (task->held)
+        sip_calls_hold(false);
+
+    capture_merge_destroy(task->merge);
+    free(task->msgs);
+    sng_free(task);
+}
+
+void *
+save_task_run(void *data)
+{
+    save_task_t *task = (save_task_t *) data;
+    packet_t *packet;
+    int i;
+
+    if (task->saveformat == SAVE_TXT) {
+        // Save SIP message content
+        for (i = 0; i < task->total && !atomic_load(&task->cancel); i++) {
+            save_msg_txt(task->f, task->msgs[i]);
+            atomic_store(&task->saved, i + 1);
+        }
+        fclose(task->f);
     } else {
-        fclose(f);
+        // Save sorted packets
+        while (!atomic_load(&task->cancel) && (packet = capture_merge_next(task->merge))) {
+            dump_packet_frames(task->pd, packet);
+            atomic_fetch_add(&task->saved, 1);
+        }
+        dump_close(task->pd);
     }
 
-    // Show success popup
-    if (info->savemode == SAVE_MESSAGE) {
-      dialog_run("Successfully saved selected SIP message to %s", savefile);
-    } else {
-      dialog_run("Successfully saved %d dialogs to %s", vector_iterator_count(&calls), savefile);
+    // Don't leave partially saved files
+    if (atomic_load(&task->cancel))
+        unlink(task->filename);
+
+    atomic_store(&task->finished, true);
+    return NULL;
+}
+
+int
+save_task_draw(ui_t *ui)
+{
+    ui_t *below;
+    int width, perc = 100;
+
+    // Get panel information
+    save_info_t *info = save_info(ui);
+    save_task_t *task = info->task;
+
+    // Keep the panel below updated while saving
+    if ((below = ui_find_by_panel(panel_below(ui->panel))) && ui_draw_redraw(below))
+        ui_draw_panel(below);
+
+    // Clear buttons line
+    mvwhline(ui->win, ui->height - 2, 1, ' ', ui->width - 2);
+
+    if (atomic_load(&task->finished)) {
+        // Saved messages and packets are no longer required
+        if (task->held) {
+            sip_calls_hold(false);
+            task->held = false;
+        }
+        mvwprintw(ui->win, ui->height - 2, 3, "Saved %d dialogs to %.*s",
+                  task->dialogs, ui->width - 48, sng_basename(task->filename));
+        mvwprintw(ui->win, ui->height - 2, ui->width - 17, "Any key: Close");
+        return 0;
     }
 
+    // Draw progress bar
+    if (task->total)
+        perc = atomic_load(&task->saved) * 100LL / task->total;
+    width = ui->width - 32;
+    mvwprintw(ui->win, ui->height - 2, 3, "Saving");
+    mvwaddch(ui->win, ui->height - 2, 10, '[');
+    mvwhline(ui->win, ui->height - 2, 11, '-', width);
+    mvwhline(ui->win, ui->height - 2, 11, ACS_CKBOARD, width * perc / 100);
+    mvwprintw(ui->win, ui->height - 2, 11 + width, "] %3d%%", perc);
+    mvwprintw(ui->win, ui->height - 2, ui->width - 14, "%s: Cancel",
+              key_action_key_str(ACTION_PREV_SCREEN));
+
     return 0;
 }
 
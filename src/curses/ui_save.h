@@ -34,7 +34,10 @@
 #define __UI_SAVE_PCAP_H
 #include "config.h"
 #include <form.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include "group.h"
+#include "capture.h"
 #include "ui_manager.h"
 
 /**
@@ -79,6 +82,44 @@ enum save_format {
 
 //! Sorter declaration of struct save_info
 typedef struct save_info save_info_t;
+//! Sorter declaration of struct save_task
+typedef struct save_task save_task_t;
+
+/**
+ * @brief Background save of dialogs
+ *
+ * Packets and messages to be saved are copied when the task is created,
+ * with the capture lock held. The worker thread writes them without
+ * the lock, so capture and the call list keep updating during the save.
+ */
+struct save_task {
+    //! Save format @see save_formats
+    enum save_format saveformat;
+    //! Absolute save file name
+    char filename[MAX_SETTING_LEN * 2];
+    //! Pcap dump file (PCAP formats)
+    pcap_dumper_t *pd;
+    //! Text file (TXT format)
+    FILE *f;
+    //! Time ordered packets to be saved (PCAP formats)
+    capture_merge_t *merge;
+    //! SIP messages to be saved (TXT format)
+    sip_msg_t **msgs;
+    //! Number of saved dialogs
+    int dialogs;
+    //! Number of packets or messages to be saved
+    int total;
+    //! Number of packets or messages already saved
+    atomic_int saved;
+    //! Request the worker to stop saving
+    atomic_bool cancel;
+    //! Worker has finished (saved or canceled)
+    atomic_bool finished;
+    //! Saved calls are still held (@see sip_calls_hold)
+    bool held;
+    //! Worker thread
+    pthread_t thread;
+};
 
 /**
  * @brief Save panel private information
@@ -98,6 +139,8 @@ struct save_info {
     sip_call_group_t *group;
     //! Message to be saved
     sip_msg_t *msg;
+    //! Save in progress (NULL if not saving)
+    save_task_t *task;
 };
 
 /**
@@ -199,8 +242,10 @@ save_error_message(ui_t *ui, const char *message);
 /**
  * @brief Save form data to options
  *
- * Save capture packets to a file based on selected modes on screen
- * It will display an error or success dialog before exit
+ * Save capture packets to a file based on selected modes on screen.
+ * Dialogs are saved in background (@see save_task_create), the current
+ * SIP message is saved directly. It will display an error or success
+ * dialog when the save is done.
  *
  * @param ui UI structure pointer
  * @returns 1 in case of error, 0 otherwise.
@@ -208,6 +253,60 @@ save_error_message(ui_t *ui, const char *message);
 int
 save_to_file(ui_t *ui);
 
+/**
+ * @brief Create a background save of the given calls
+ *
+ * Copy the lists of packets or messages of the calls and start a
+ * worker thread to write them to the already opened file. Calls are
+ * held (@see sip_calls_hold) until the task is destroyed.
+ *
+ * This function must be called with the capture lock held.
+ *
+ * @param ui UI structure pointer
+ * @param calls Iterator of the calls to be saved
+ * @param pd Opened dump file for PCAP formats
+ * @param f Opened text file for TXT format
+ * @param filename Absolute save file name
+ * @return new save task or NULL on failure
+ */
+save_task_t *
+save_task_create(ui_t *ui, vector_iter_t calls, pcap_dumper_t *pd, FILE *f,
+                 const char *filename);
+
+/**
+ * @brief Wait the save worker to finish and free its memory
+ *
+ * If the worker has not finished yet, it is requested to stop and the
+ * partially saved file is removed.
+ *
+ * @param task Save task pointer
+ */
+void
+save_task_destroy(save_task_t *task);
+
+/**
+ * @brief Save worker thread function
+ *
+ * Write all task packets or messages to the save file and close it.
+ *
+ * @param data Save task pointer
+ */
+void *
+save_task_run(void *data);
+
+/**
+ * @brief Draw the progress of the running save
+ *
+ * Once the worker has finished, release the saved calls and show the
+ * result until a key is pressed. The panel below keeps being redrawn
+ * while the save panel is displayed.
+ *
+ * @param ui UI structure pointer
+ * @return 0 if the panel has been drawn, -1 otherwise
+ */
+int
+save_task_draw(ui_t *ui);
+
 /**
  * @brief Save one SIP message into open file
  *
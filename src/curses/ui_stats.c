@@ -59,6 +59,13 @@
 #include "ui_manager.h"
 #include "ui_stats.h"
 
+//! Call state counter and its percentage of all calls (0 without calls)
+#define STATS_CALLS(state) \
+    stats->states[state], stats->calls ? (float) stats->states[state] * 100 / stats->calls : 0
+//! Message counter and its percentage of all messages (0 without messages)
+#define STATS_MSGS(counter) \
+    stats->counter, stats->msgs ? (float) stats->counter * 100 / stats->msgs : 0
+
 /**
  * Ui Structure definition for Stats panel
  */
@@ -67,26 +74,13 @@ ui_t ui_stats = {
     .panel = NULL,
     .create = stats_create,
     .destroy = ui_panel_destroy,
+    .draw = stats_draw,
     .handle_key = NULL
 };
 
 void
 stats_create(ui_t *ui)
 {
-    vector_iter_t calls;
-    vector_iter_t msgs;
-    sip_call_t *call;
-    sip_msg_t *msg;
-
-    // Counters!
-    struct {
-        int dtotal, dcalls, completed, cancelled, incall, rejected, setup, busy, diverted;
-        int mtotal, invite, regist, subscribe, update, notify, options;
-        int publish, message, info, ack, bye, cancel;
-        int r100, r200, r300, r400, r500, r600, r700, r800;
-    } stats;
-    memset(&stats, 0, sizeof(stats));
-
     // Calculate window dimensions
     ui_panel_create(ui, 25, 60);
 
@@ -99,102 +93,61 @@ stats_create(ui_t *ui)
     mvwaddch(ui->win, 10, ui->width - 1, ACS_RTEE);
     mvwprintw(ui->win, ui->height - 2, ui->width / 2 - 9, "Press ESC to leave");
     wattroff(ui->win, COLOR_PAIR(CP_BLUE_ON_DEF));
+}
 
-    // Parse the data
-    calls = sip_calls_iterator();
-    stats.dtotal = vector_iterator_count(&calls);
+int
+stats_draw(ui_t *ui)
+{
+    const sip_counters_t *stats = sip_calls_counters();
+    int line;
 
-    // Ignore this screen when no dialog exists
-    if (!stats.dtotal) {
-        mvwprintw(ui->win, 3, 3, "No information to display");
-        return;
+    // Clear previous data
+    for (line = 3; line < ui->height - 3; line++) {
+        if (line != 10)
+            mvwhline(ui->win, line, 1, ' ', ui->width - 2);
     }
 
-    while ((call = vector_iterator_next(&calls))) {
-        // If this dialog is a call
-        if (call->state) {
-            // Increase call counter
-            stats.dcalls++;
-            // Increase call status counter
-            switch (call->state) {
-                case SIP_CALLSTATE_CALLSETUP: stats.setup++; break;
-                case SIP_CALLSTATE_INCALL: stats.incall++; break;
-                case SIP_CALLSTATE_CANCELLED: stats.cancelled++; break;
-                case SIP_CALLSTATE_REJECTED: stats.rejected++; break;
-                case SIP_CALLSTATE_BUSY: stats.busy++; break;
-                case SIP_CALLSTATE_DIVERTED: stats.diverted++; break;
-                case SIP_CALLSTATE_COMPLETED: stats.completed++; break;
-            }
-        }
-        // For each message in call
-        msgs = vector_iterator(call->msgs);
-        while ((msg = vector_iterator_next(&msgs))) {
-            // Increase message counter
-            stats.mtotal++;
-            // Check message type
-            switch (msg->reqresp) {
-                case SIP_METHOD_REGISTER: stats.regist++; break;
-                case SIP_METHOD_INVITE: stats.invite++; break;
-                case SIP_METHOD_SUBSCRIBE: stats.subscribe++; break;
-                case SIP_METHOD_NOTIFY: stats.notify++; break;
-                case SIP_METHOD_OPTIONS: stats.options++; break;
-                case SIP_METHOD_PUBLISH: stats.publish++; break;
-                case SIP_METHOD_MESSAGE: stats.message++; break;
-                case SIP_METHOD_CANCEL: stats.cancel++; break;
-                case SIP_METHOD_BYE: stats.bye++; break;
-                case SIP_METHOD_ACK: stats.ack++; break;
-                // case SIP_METHOD_PRACK:
-                case SIP_METHOD_INFO: stats.info++; break;
-                // case SIP_METHOD_REFER:
-                case SIP_METHOD_UPDATE: stats.update++; break;
-                default:
-                    if (msg->reqresp >= 800) stats.r800++;
-                    else if (msg->reqresp >= 700) stats.r700++;
-                    else if (msg->reqresp >= 600) stats.r600++;
-                    else if (msg->reqresp >= 500) stats.r500++;
-                    else if (msg->reqresp >= 400) stats.r400++;
-                    else if (msg->reqresp >= 300) stats.r300++;
-                    else if (msg->reqresp >= 200) stats.r200++;
-                    else if (msg->reqresp >= 100) stats.r100++;
-            }
-        }
-
-
+    // Ignore this screen when no dialog exists
+    if (!stats->dialogs) {
+        mvwprintw(ui->win, 3, 3, "No information to display");
+        return 0;
     }
 
     // Print parses data
-    mvwprintw(ui->win, 3,  3,  "Dialogs: %d", stats.dtotal);
-    mvwprintw(ui->win, 4,  3,  "Calls: %d (%.1f%%)", stats.dcalls, (float) stats.dcalls * 100 / stats.dtotal);
-    mvwprintw(ui->win, 5,  3,  "Messages: %d", stats.mtotal);
+    mvwprintw(ui->win, 3,  3,  "Dialogs: %d", stats->dialogs);
+    mvwprintw(ui->win, 4,  3,  "Calls: %d (%.1f%%)", stats->calls, (float) stats->calls * 100 / stats->dialogs);
+    mvwprintw(ui->win, 5,  3,  "Messages: %d", stats->msgs);
     // Print status of calls if any
-    if (stats.dcalls) {
-        mvwprintw(ui->win, 3,  33, "COMPLETED:  %d (%.1f%%)", stats.completed, (float) stats.completed * 100 / stats.dcalls);
-        mvwprintw(ui->win, 4,  33, "CANCELLED:  %d (%.1f%%)", stats.cancelled, (float) stats.cancelled * 100 / stats.dcalls);
-        mvwprintw(ui->win, 5,  33, "IN CALL:    %d (%.1f%%)", stats.incall,    (float) stats.incall * 100 / stats.dcalls);
-        mvwprintw(ui->win, 6,  33, "REJECTED:   %d (%.1f%%)", stats.rejected,  (float) stats.rejected * 100 / stats.dcalls);
-        mvwprintw(ui->win, 7,  33, "BUSY:       %d (%.1f%%)", stats.busy,      (float) stats.busy * 100 / stats.dcalls);
-        mvwprintw(ui->win, 8,  33, "DIVERTED:   %d (%.1f%%)", stats.diverted,  (float) stats.diverted * 100 / stats.dcalls);
-        mvwprintw(ui->win, 9,  33, "CALL SETUP: %d (%.1f%%)", stats.setup,     (float) stats.setup * 100 / stats.dcalls);
+    if (stats->calls) {
+        mvwprintw(ui->win, 3,  33, "COMPLETED:  %d (%.1f%%)", STATS_CALLS(SIP_CALLSTATE_COMPLETED));
+        mvwprintw(ui->win, 4,  33, "CANCELLED:  %d (%.1f%%)", STATS_CALLS(SIP_CALLSTATE_CANCELLED));
+        mvwprintw(ui->win, 5,  33, "IN CALL:    %d (%.1f%%)", STATS_CALLS(SIP_CALLSTATE_INCALL));
+        mvwprintw(ui->win, 6,  33, "REJECTED:   %d (%.1f%%)", STATS_CALLS(SIP_CALLSTATE_REJECTED));
+        mvwprintw(ui->win, 7,  33, "BUSY:       %d (%.1f%%)", STATS_CALLS(SIP_CALLSTATE_BUSY));
+        mvwprintw(ui->win, 8,  33, "DIVERTED:   %d (%.1f%%)", STATS_CALLS(SIP_CALLSTATE_DIVERTED));
+        mvwprintw(ui->win, 9,  33, "CALL SETUP: %d (%.1f%%)", STATS_CALLS(SIP_CALLSTATE_CALLSETUP));
     }
 
-    mvwprintw(ui->win, 11, 3, "INVITE:    %d (%.1f%%)", stats.invite,    (float) stats.invite * 100 / stats.mtotal);
-    mvwprintw(ui->win, 12, 3, "REGISTER:  %d (%.1f%%)", stats.regist,    (float) stats.regist * 100 / stats.mtotal);
-    mvwprintw(ui->win, 13, 3, "SUBSCRIBE: %d (%.1f%%)", stats.subscribe, (float) stats.subscribe * 100 / stats.mtotal);
-    mvwprintw(ui->win, 14, 3, "UPDATE:    %d (%.1f%%)", stats.update,    (float) stats.update * 100 / stats.mtotal);
-    mvwprintw(ui->win, 15, 3, "NOTIFY:    %d (%.1f%%)", stats.notify,    (float) stats.notify * 100 / stats.mtotal);
-    mvwprintw(ui->win, 16, 3, "OPTIONS:   %d (%.1f%%)", stats.options,   (float) stats.options * 100 / stats.mtotal);
-    mvwprintw(ui->win, 17, 3, "PUBLISH:   %d (%.1f%%)", stats.publish,   (float) stats.publish * 100 / stats.mtotal);
-    mvwprintw(ui->win, 18, 3, "MESSAGE:   %d (%.1f%%)", stats.message,   (float) stats.message * 100 / stats.mtotal);
-    mvwprintw(ui->win, 19, 3, "INFO:      %d (%.1f%%)", stats.info,      (float) stats.info * 100 / stats.mtotal);
-    mvwprintw(ui->win, 20, 3, "BYE:       %d (%.1f%%)", stats.bye,       (float) stats.bye * 100 / stats.mtotal);
-    mvwprintw(ui->win, 21, 3, "CANCEL:    %d (%.1f%%)", stats.cancel,    (float) stats.cancel * 100 / stats.mtotal);
+    mvwprintw(ui->win, 11, 3, "INVITE:    %d (%.1f%%)", STATS_MSGS(methods[SIP_METHOD_INVITE]));
+    mvwprintw(ui->win, 12, 3, "REGISTER:  %d (%.1f%%)", STATS_MSGS(methods[SIP_METHOD_REGISTER]));
+    mvwprintw(ui->win, 13, 3, "SUBSCRIBE: %d (%.1f%%)", STATS_MSGS(methods[SIP_METHOD_SUBSCRIBE]));
+    mvwprintw(ui->win, 14, 3, "UPDATE:    %d (%.1f%%)", STATS_MSGS(methods[SIP_METHOD_UPDATE]));
+    mvwprintw(ui->win, 15, 3, "NOTIFY:    %d (%.1f%%)", STATS_MSGS(methods[SIP_METHOD_NOTIFY]));
+    mvwprintw(ui->win, 16, 3, "OPTIONS:   %d (%.1f%%)", STATS_MSGS(methods[SIP_METHOD_OPTIONS]));
+    mvwprintw(ui->win, 17, 3, "PUBLISH:   %d (%.1f%%)", STATS_MSGS(methods[SIP_METHOD_PUBLISH]));
+    mvwprintw(ui->win, 18, 3, "MESSAGE:   %d (%.1f%%)", STATS_MSGS(methods[SIP_METHOD_MESSAGE]));
+    mvwprintw(ui->win, 19, 3, "INFO:      %d (%.1f%%)", STATS_MSGS(methods[SIP_METHOD_INFO]));
+    mvwprintw(ui->win, 20, 3, "BYE:       %d (%.1f%%)", STATS_MSGS(methods[SIP_METHOD_BYE]));
+    mvwprintw(ui->win, 21, 3, "CANCEL:    %d (%.1f%%)", STATS_MSGS(methods[SIP_METHOD_CANCEL]));
+
+    mvwprintw(ui->win, 11, 33, "1XX: %d (%.1f%%)", STATS_MSGS(responses[1]));
+    mvwprintw(ui->win, 12, 33, "2XX: %d (%.1f%%)", STATS_MSGS(responses[2]));
+    mvwprintw(ui->win, 13, 33, "3XX: %d (%.1f%%)", STATS_MSGS(responses[3]));
+    mvwprintw(ui->win, 14, 33, "4XX: %d (%.1f%%)", STATS_MSGS(responses[4]));
+    mvwprintw(ui->win, 15, 33, "5XX: %d (%.1f%%)", STATS_MSGS(responses[5]));
+    mvwprintw(ui->win, 16, 33, "6XX: %d (%.1f%%)", STATS_MSGS(responses[6]));
+    mvwprintw(ui->win, 17, 33, "7XX: %d (%.1f%%)", STATS_MSGS(responses[7]));
+    mvwprintw(ui->win, 18, 33, "8XX: %d (%.1f%%)", STATS_MSGS(responses[8]));
 
-    mvwprintw(ui->win, 11, 33, "1XX: %d (%.1f%%)", stats.r100, (float) stats.r100 * 100 / stats.mtotal);
-    mvwprintw(ui->win, 12, 33, "2XX: %d (%.1f%%)", stats.r200, (float) stats.r200 * 100 / stats.mtotal);
-    mvwprintw(ui->win, 13, 33, "3XX: %d (%.1f%%)", stats.r300, (float) stats.r300 * 100 / stats.mtotal);
-    mvwprintw(ui->win, 14, 33, "4XX: %d (%.1f%%)", stats.r400, (float) stats.r400 * 100 / stats.mtotal);
-    mvwprintw(ui->win, 15, 33, "5XX: %d (%.1f%%)", stats.r500, (float) stats.r500 * 100 / stats.mtotal);
-    mvwprintw(ui->win, 16, 33, "6XX: %d (%.1f%%)", stats.r600, (float) stats.r600 * 100 / stats.mtotal);
-    mvwprintw(ui->win, 17, 33, "7XX: %d (%.1f%%)", stats.r700, (float) stats.r700 * 100 / stats.mtotal);
-    mvwprintw(ui->win, 18, 33, "8XX: %d (%.1f%%)", stats.r800, (float) stats.r800 * 100 / stats.mtotal);
+    return 0;
 }
@@ -41,4 +41,16 @@
 void
 stats_create(ui_t *ui);
 
+/**
+ * @brief Draw the stats panel data
+ *
+ * Counters are maintained while packets are parsed, so the panel
+ * displays current values each time it's drawn.
+ *
+ * @param ui UI structure pointer
+ * @return 0 in all cases
+ */
+int
+stats_draw(ui_t *ui);
+
 #endif /* __SNGREP_UI_STATS_H */
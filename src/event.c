@@ -0,0 +1,415 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file event.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Source code of functions defined in event.h
+ *
+ */
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "event.h"
+#include "metrics.h"
+#include "capture.h"
+#include "setting.h"
+#include "util.h"
+
+//! Current event stream (NULL if not streaming)
+event_stream_t *events = NULL;
+
+//! Call attributes stored in message events
+static const enum sip_attr_id event_msg_call_attrs[] = {
+    SIP_ATTR_CALLINDEX, SIP_ATTR_CALLID, SIP_ATTR_XCALLID,
+    SIP_ATTR_SIPFROM, SIP_ATTR_SIPTO, SIP_ATTR_TRANSPORT
+};
+
+//! Message attributes stored in message events
+static const enum sip_attr_id event_msg_attrs[] = {
+    SIP_ATTR_DATE, SIP_ATTR_TIME, SIP_ATTR_METHOD, SIP_ATTR_SRC, SIP_ATTR_DST
+};
+
+//! Call attributes stored in call state events
+static const enum sip_attr_id event_state_attrs[] = {
+    SIP_ATTR_CALLINDEX, SIP_ATTR_CALLID, SIP_ATTR_XCALLID,
+    SIP_ATTR_SIPFROM, SIP_ATTR_SIPTO, SIP_ATTR_CALLSTATE, SIP_ATTR_MSGCNT,
+    SIP_ATTR_CONVDUR, SIP_ATTR_TOTALDUR, SIP_ATTR_REASON_TXT, SIP_ATTR_WARNING
+};
+
+int
+event_stream_open(const char *filename)
+{
+    event_stream_t *stream;
+    int size;
+
+    if (!(stream = sng_malloc(sizeof(event_stream_t))))
+        return 1;
+
+    // Open output file
+    if (!strcmp(filename, "-")) {
+        stream->f = stdout;
+    } else if ((stream->f = fopen(filename, "w"))) {
+        stream->close = true;
+    } else {
+        sng_free(stream);
+        return 1;
+    }
+    setvbuf(stream->f, NULL, _IOFBF, EVENT_BUFFER_SIZE);
+    stream->drop = capture_is_online();
+
+    // Create queues for events pending to be written and events to be reused
+    size = setting_get_intvalue(SETTING_EVENT_QUEUE);
+    stream->queue = queue_create((size > 0) ? size : 1);
+    stream->free = queue_create((size > 0) ? size : 1);
+    if (!stream->queue || !stream->free)
+        goto error;
+    queue_set_destroyer(stream->queue, event_destroyer);
+    queue_set_destroyer(stream->free, event_destroyer);
+
+    // Start the stream thread
+    sem_init(&stream->sem, 0, 0);
+    atomic_init(&stream->running, true);
+    if (pthread_create(&stream->thread, NULL, event_stream_run, stream) != 0) {
+        sem_destroy(&stream->sem);
+        goto error;
+    }
+
+    events = stream;
+    return 0;
+
+error:
+    queue_destroy(stream->queue);
+    queue_destroy(stream->free);
+    if (stream->close)
+        fclose(stream->f);
+    sng_free(stream);
+    return 1;
+}
+
+void
+event_stream_close()
+{
+    event_stream_t *stream = events;
+
+    if (!stream)
+        return;
+
+    // No more events will be queued
+    events = NULL;
+
+    // Stop stream thread after writing pending events
+    atomic_store(&stream->running, false);
+    sem_post(&stream->sem);
+    pthread_join(stream->thread, NULL);
+    sem_destroy(&stream->sem);
+
+    if (stream->close) {
+        fclose(stream->f);
+    } else {
+        fflush(stream->f);
+    }
+    queue_destroy(stream->queue);
+    queue_destroy(stream->free);
+    sng_free(stream);
+}
+
+bool
+event_stream_enabled()
+{
+    return events != NULL;
+}
+
+void
+event_stream_stats(event_stats_t *stats)
+{
+    memset(stats, 0, sizeof(event_stats_t));
+
+    if (!events)
+        return;
+
+    stats->queued = atomic_load(&events->queued);
+    stats->written = atomic_load(&events->written);
+    stats->dropped = atomic_load(&events->dropped);
+    stats->highwater = atomic_load(&events->highwater);
+}
+
+void *
+event_stream_run(void *data)
+{
+    event_stream_t *stream = (event_stream_t *) data;
+    event_t *event, *dropped;
+    struct timespec ts;
+
+    while (1) {
+        if (!(event = queue_pop(stream->queue))) {
+            // No more pending events, make written ones visible to readers
+            fflush(stream->f);
+
+            // Stream has been stopped, finish when all events are written
+            if (!atomic_load(&stream->running)) {
+                if (queue_count(stream->queue) == 0)
+                    break;
+                continue;
+            }
+
+            // Request a notification for the next queued event
+            atomic_store(&stream->waiting, 1);
+            // Events may have been queued before the request was done
+            if (queue_count(stream->queue) == 0) {
+                clock_gettime(CLOCK_REALTIME, &ts);
+                ts.tv_nsec += 100 * 1000 * 1000;
+                if (ts.tv_nsec >= 1000 * 1000 * 1000) {
+                    ts.tv_sec++;
+                    ts.tv_nsec -= 1000 * 1000 * 1000;
+                }
+                sem_timedwait(&stream->sem, &ts);
+            }
+            atomic_store(&stream->waiting, 0);
+            continue;
+        }
+
+        event_write_json(stream->f, event);
+        atomic_fetch_add(&stream->written, 1);
+
+        // Return event for reuse
+        if ((dropped = queue_push(stream->free, event)))
+            event_destroyer(dropped);
+    }
+
+    return NULL;
+}
+
+void
+event_msg(sip_msg_t *msg)
+{
+    char value[MAX_SIP_PAYLOAD];
+    event_t *event;
+    size_t i;
+
+    if (!events)
+        return;
+
+    if (!(event = event_create(events, EVENT_MSG, msg)))
+        return;
+
+    for (i = 0; i < sizeof(event_msg_call_attrs) / sizeof(event_msg_call_attrs[0]); i++) {
+        value[0] = '\0';
+        event_set_attr(event, event_msg_call_attrs[i],
+                       call_get_attribute(msg->call, event_msg_call_attrs[i], value));
+    }
+
+    for (i = 0; i < sizeof(event_msg_attrs) / sizeof(event_msg_attrs[0]); i++) {
+        value[0] = '\0';
+        event_set_attr(event, event_msg_attrs[i],
+                       msg_get_attribute(msg, event_msg_attrs[i], value));
+    }
+
+    event_push(events, event);
+}
+
+void
+event_call_state(sip_call_t *call, sip_msg_t *msg, int prevstate)
+{
+    char value[MAX_SIP_PAYLOAD];
+    event_t *event;
+    size_t i;
+
+    if (!events)
+        return;
+
+    if (!(event = event_create(events, EVENT_CALLSTATE, msg)))
+        return;
+
+    event->prevstate = prevstate;
+    for (i = 0; i < sizeof(event_state_attrs) / sizeof(event_state_attrs[0]); i++) {
+        value[0] = '\0';
+        event_set_attr(event, event_state_attrs[i],
+                       call_get_attribute(call, event_state_attrs[i], value));
+    }
+
+    event_push(events, event);
+}
+
+event_t *
+event_create(event_stream_t *stream, enum event_type type, sip_msg_t *msg)
+{
+    event_t *event;
+    int i;
+
+    // Reuse a written event or create a new one
+    if (!(event = queue_pop(stream->free))) {
+        if (!(event = sng_malloc(sizeof(event_t))))
+            return NULL;
+        metrics_memory_add(METRICS_MEM_EVENTS, sizeof(event_t));
+    }
+
+    event->type = type;
+    event->ts = msg_get_time(msg);
+    event->prevstate = 0;
+    event->len = 0;
+    for (i = 0; i < SIP_ATTR_COUNT; i++)
+        event->values[i] = -1;
+
+    return event;
+}
+
+void
+event_destroyer(void *item)
+{
+    event_t *event = (event_t *) item;
+
+    if (!event)
+        return;
+
+    metrics_memory_add(METRICS_MEM_EVENTS, -(long) (sizeof(event_t) + event->size));
+    free(event->data);
+    sng_free(event);
+}
+
+int
+event_set_attr(event_t *event, enum sip_attr_id id, const char *value)
+{
+    size_t len;
+    char *data;
+
+    if (!value || id >= SIP_ATTR_COUNT)
+        return 1;
+
+    // Remove padding used to display values in columns
+    while (*value == ' ')
+        value++;
+
+    // Make room for the value and its null terminator
+    len = strlen(value) + 1;
+    if (event->len + len > event->size) {
+        if (!(data = realloc(event->data, event->len + len + 256)))
+            return 1;
+        metrics_memory_add(METRICS_MEM_EVENTS, (long) (event->len + len + 256 - event->size));
+        event->data = data;
+        event->size = event->len + len + 256;
+    }
+
+    memcpy(event->data + event->len, value, len);
+    event->values[id] = event->len;
+    event->len += len;
+    return 0;
+}
+
+int
+event_push(event_stream_t *stream, event_t *event)
+{
+    event_t *dropped;
+    size_t pending;
+
+    // Offline captures wait for the stream thread instead of losing events
+    while (!stream->drop && queue_count(stream->queue) >= stream->queue->size) {
+        if (atomic_exchange(&stream->waiting, 0))
+            sem_post(&stream->sem);
+        usleep(1000);
+    }
+
+    // Queue the event, dropping the oldest one if queue is full
+    if ((dropped = queue_push(stream->queue, event))) {
+        atomic_fetch_add(&stream->dropped, 1);
+        event_destroyer(dropped);
+    }
+    atomic_fetch_add(&stream->queued, 1);
+
+    // Update max number of pending events (only updated by this thread)
+    pending = queue_count(stream->queue);
+    if (pending > atomic_load(&stream->highwater))
+        atomic_store(&stream->highwater, pending);
+
+    // Wake up stream thread if it is waiting for events
+    if (atomic_exchange(&stream->waiting, 0))
+        sem_post(&stream->sem);
+
+    return 0;
+}
+
+void
+event_write_json(FILE *f, event_t *event)
+{
+    const char *value;
+    int id;
+
+    fprintf(f, "{\"event\":\"%s\",\"ts\":%ld.%06ld",
+            (event->type == EVENT_MSG) ? "message" : "callstate",
+            (long) event->ts.tv_sec, (long) event->ts.tv_usec);
+
+    for (id = 0; id < SIP_ATTR_COUNT; id++) {
+        if (event->values[id] < 0)
+            continue;
+        value = event->data + event->values[id];
+        fprintf(f, ",\"%s\":", sip_attr_get_name(id));
+        // Numeric attributes are written without quotes
+        if (id == SIP_ATTR_CALLINDEX || id == SIP_ATTR_MSGCNT || id == SIP_ATTR_WARNING) {
+            fputs(value, f);
+        } else {
+            json_write_string(f, value);
+        }
+    }
+
+    if (event->type == EVENT_CALLSTATE && event->prevstate) {
+        fputs(",\"prevstate\":", f);
+        json_write_string(f, call_state_to_str(event->prevstate));
+    }
+
+    fputs("}\n", f);
+}
+
+void
+json_write_string(FILE *f, const char *str)
+{
+    const unsigned char *c;
+
+    fputc('"', f);
+    for (c = (const unsigned char *) str; *c; c++) {
+        switch (*c) {
+            case '"':
+                fputs("\\\"", f);
+                break;
+            case '\\':
+                fputs("\\\\", f);
+                break;
+            case '\n':
+                fputs("\\n", f);
+                break;
+            case '\r':
+                fputs("\\r", f);
+                break;
+            case '\t':
+                fputs("\\t", f);
+                break;
+            default:
+                if (*c < 0x20) {
+                    fprintf(f, "\\u%04x", *c);
+                } else {
+                    fputc(*c, f);
+                }
+                break;
+        }
+    }
+    fputc('"', f);
+}
@@ -0,0 +1,230 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file event.h
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Functions to stream SIP events as JSON lines
+ *
+ * Every parsed SIP message and every call state change generates an
+ * event that is written as a single line JSON object (NDJSON), so the
+ * output can be piped to other tools while capturing.
+ *
+ * Capture threads only copy the attribute values of the event and queue
+ * it. JSON formatting and writing is done by the event stream thread.
+ */
+#ifndef __SNGREP_EVENT_H
+#define __SNGREP_EVENT_H
+
+#include "config.h"
+#include <stdio.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <sys/time.h>
+#include "queue.h"
+#include "sip.h"
+
+//! Size of the event output file buffer
+#define EVENT_BUFFER_SIZE (256 * 1024)
+
+//! Shorter declaration of event structure
+typedef struct event event_t;
+//! Shorter declaration of event_stream structure
+typedef struct event_stream event_stream_t;
+//! Shorter declaration of event_stats structure
+typedef struct event_stats event_stats_t;
+
+//! Available event types
+enum event_type {
+    //! A SIP message has been added to a call
+    EVENT_MSG = 0,
+    //! A call has changed its state
+    EVENT_CALLSTATE,
+};
+
+/**
+ * @brief Copy of an event data pending to be written
+ *
+ * Attribute values are stored one after another in a single buffer,
+ * so events can be reused without freeing them.
+ */
+struct event {
+    //! Event type
+    enum event_type type;
+    //! Time of the message that generated this event
+    struct timeval ts;
+    //! Call state before the change (only for state events)
+    int prevstate;
+    //! Offset of each attribute value in data buffer (-1 if not set)
+    int values[SIP_ATTR_COUNT];
+    //! Attribute values buffer
+    char *data;
+    //! Allocated bytes of values buffer
+    size_t size;
+    //! Used bytes of values buffer
+    size_t len;
+};
+
+/**
+ * @brief Event stream counters
+ */
+struct event_stats {
+    //! Events queued by capture threads
+    uint64_t queued;
+    //! Events written to the output
+    uint64_t written;
+    //! Events discarded because the queue was full
+    uint64_t dropped;
+    //! Max number of events pending to be written at the same time
+    uint64_t highwater;
+};
+
+/**
+ * @brief Event stream output data
+ */
+struct event_stream {
+    //! Output file
+    FILE *f;
+    //! Output file must be closed when the stream is closed
+    bool close;
+    //! Drop oldest events instead of waiting when queue is full
+    bool drop;
+    //! Events pending to be written
+    queue_t *queue;
+    //! Written events to be reused
+    queue_t *free;
+    //! Stream thread
+    pthread_t thread;
+    //! Stream thread is running
+    atomic_bool running;
+    //! Stream thread is waiting for new events
+    atomic_int waiting;
+    //! Semaphore to wake up the stream thread
+    sem_t sem;
+    //! Stream counters (@see event_stats)
+    atomic_ulong queued;
+    atomic_ulong written;
+    atomic_ulong dropped;
+    atomic_ulong highwater;
+};
+
+/**
+ * @brief Start streaming events to given file
+ *
+ * @param filename Output file path or "-" for standard output
+ * @return 0 if the stream has been started, 1 otherwise
+ */
+int
+event_stream_open(const char *filename);
+
+/**
+ * @brief Stop event stream after writing all pending events
+ */
+void
+event_stream_close();
+
+/**
+ * @brief Check if events are being streamed
+ */
+bool
+event_stream_enabled();
+
+/**
+ * @brief Get current event stream counters
+ *
+ * All counters are zero if events are not being streamed
+ */
+void
+event_stream_stats(event_stats_t *stats);
+
+/**
+ * @brief Event stream thread main function
+ *
+ * Format and write queued events until the stream is closed
+ */
+void *
+event_stream_run(void *data);
+
+/**
+ * @brief Queue an event for the given message
+ *
+ * This function must be called after the message has been added to
+ * its call.
+ */
+void
+event_msg(sip_msg_t *msg);
+
+/**
+ * @brief Queue an event for the given call state change
+ *
+ * @param call Call that has changed its state
+ * @param msg Message that caused the change
+ * @param prevstate Call state before the change
+ */
+void
+event_call_state(sip_call_t *call, sip_msg_t *msg, int prevstate);
+
+/**
+ * @brief Get an empty event to be filled
+ *
+ * Written events are reused when available
+ */
+event_t *
+event_create(event_stream_t *stream, enum event_type type, sip_msg_t *msg);
+
+/**
+ * @brief Free event memory
+ */
+void
+event_destroyer(void *item);
+
+/**
+ * @brief Store a copy of an attribute value in the event
+ *
+ * @return 0 if value has been stored, 1 otherwise
+ */
+int
+event_set_attr(event_t *event, enum sip_attr_id id, const char *value);
+
+/**
+ * @brief Queue a filled event to be written by the stream thread
+ *
+ * @return 0 if event has been queued, 1 otherwise
+ */
+int
+event_push(event_stream_t *stream, event_t *event);
+
+/**
+ * @brief Write an event as a single line JSON object
+ */
+void
+event_write_json(FILE *f, event_t *event);
+
+/**
+ * @brief Write a quoted JSON string escaping special characters
+ */
+void
+json_write_string(FILE *f, const char *str);
+
+#endif /* __SNGREP_EVENT_H */
@@ -28,18 +28,135 @@
  */
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
+#include <sys/time.h>
 #include "sip.h"
 #include "curses/ui_call_list.h"
 #include "filter.h"
 
 //! Storage of filter information
 filter_t filters[FILTER_COUNT] = { };
+//! Filters version, increased each time filters change
+static unsigned int filters_version = 1;
+//! Number of calls pending to be evaluated with current filters
+static int filters_pending = 0;
+
+/**
+ * @brief Mark all calls filter status as outdated
+ */
+static void
+filter_version_bump()
+{
+    filters_version++;
+    // Calls will be evaluated in the next update
+    filters_pending = sip_calls_count();
+}
+
+/**
+ * @brief Check if call filter status must be evaluated again
+ */
+static bool
+filter_call_outdated(sip_call_t *call)
+{
+    return call->filter_version != filters_version
+           || call->filter_msgcnt != call_msg_count(call);
+}
+
+/**
+ * @brief Check call messages against payload filter
+ *
+ * Only messages not checked in previous evaluations with the same
+ * filters are checked.
+ *
+ * @return true if any message of the call matches the filter
+ */
+static bool
+filter_check_payload(sip_call_t *call)
+{
+    sip_msg_t *msg;
+    vector_iter_t it;
+
+    // Any of the already checked messages matched
+    if (call->filter_payload)
+        return true;
+
+    // Create an iterator for the call messages not checked yet
+    it = vector_iterator(call->msgs);
+    vector_iterator_set_current(&it, call->filter_payload_cnt - 1);
+    while ((msg = vector_iterator_next(&it))) {
+        call->filter_payload_cnt++;
+        // Check if this payload matches the filter
+        if (filter_check_data(&filters[FILTER_PAYLOAD], msg_get_payload(msg),
+                              packet_payloadlen(msg->packet)) == 0) {
+            call->filter_payload = true;
+            break;
+        }
+    }
+
+    return call->filter_payload;
+}
+
+/**
+ * @brief Get the literal text any matching data must contain
+ *
+ * Only the literal text at the start of the expression is used, and
+ * expressions with alternations have no literal text at all.
+ *
+ * @return allocated literal text or NULL if not found
+ */
+static char *
+filter_expr_literal(const char *expr)
+{
+    const char *c;
+    char *literal;
+    size_t len = 0;
+
+    // Any of the alternatives may match
+    if (strchr(expr, '|'))
+        return NULL;
+
+    literal = sng_malloc(strlen(expr) + 1);
+
+    for (c = expr; *c; c++) {
+        if (c == expr && *c == '^') {
+            // Start anchor doesn't require any text
+            continue;
+#if !defined(WITH_PCRE) && !defined(WITH_PCRE2)
+        } else if (*c == '\\' && c[1] && strchr("<>`'", c[1])) {
+            // GNU regex word and buffer anchors don't require any text
+            c++;
+            continue;
+#endif
+        } else if (*c == '\\' && c[1] && ispunct((unsigned char) c[1])) {
+            // Escaped character
+            literal[len++] = *++c;
+        } else if (strchr(FILTER_REGEX_META, *c)) {
+            // Special character, end of literal text
+            break;
+        } else {
+            literal[len++] = *c;
+        }
+    }
+
+    // Last character is optional if followed by a quantifier
+    if (len && (*c == '?' || *c == '*' || *c == '{'))
+        len--;
+
+    if (len == 0) {
+        sng_free(literal);
+        return NULL;
+    }
+
+    literal[len] = '\0';
+    return literal;
+}
 
 int
 filter_set(int type, const char *expr)
 {
 #ifdef WITH_PCRE
     pcre *regex = NULL;
+    pcre_extra *extra = NULL;
 
     // If we have an expression, check if compiles before changing the filter
     if (expr) {
@@ -50,19 +167,29 @@ filter_set(int type, const char *expr)
         // Check if we have a valid expression
         if (!(regex = pcre_compile(expr, pcre_options, &re_err, &err_offset, 0)))
             return 1;
+
+#ifdef PCRE_STUDY_JIT_COMPILE
+        // Compile to machine code if supported
+        extra = pcre_study(regex, PCRE_STUDY_JIT_COMPILE, &re_err);
+#endif
     }
 
     // Remove previous value
     if (filters[type].expr) {
         sng_free(filters[type].expr);
         pcre_free(filters[type].regex);
+#ifdef PCRE_STUDY_JIT_COMPILE
+        pcre_free_study(filters[type].extra);
+#endif
     }
 
     // Set new expresion values
     filters[type].expr = (expr) ? strdup(expr) : NULL;
     filters[type].regex = regex;
+    filters[type].extra = extra;
 #elif defined(WITH_PCRE2)
     pcre2_code *regex = NULL;
+    pcre2_match_data *match_data = NULL;
 
     // If we have an expression, check if compiles before changing the filter
     if (expr) {
@@ -73,23 +200,34 @@ filter_set(int type, const char *expr)
         // Check if we have a valid expression
         if (!(regex = pcre2_compile((PCRE2_SPTR) expr, PCRE2_ZERO_TERMINATED, pcre_options, &re_err, &err_offset, NULL)))
             return 1;
+
+        // Compile to machine code if supported (interpreted otherwise)
+        pcre2_jit_compile(regex, PCRE2_JIT_COMPLETE);
+
+        // Match data is reused by each check of this expression
+        if (!(match_data = pcre2_match_data_create_from_pattern(regex, NULL))) {
+            pcre2_code_free(regex);
+            return 1;
+        }
     }
 
     // Remove previous value
     if (filters[type].expr) {
         sng_free(filters[type].expr);
         pcre2_code_free(filters[type].regex);
+        pcre2_match_data_free(filters[type].match_data);
     }
 
     // Set new expresion values
     filters[type].expr = (expr) ? strdup(expr) : NULL;
     filters[type].regex = regex;
+    filters[type].match_data = match_data;
 #else
     regex_t regex;
     // If we have an expression, check if compiles before changing the filter
     if (expr) {
         // Check if we have a valid expression
-        if (regcomp(&regex, expr, REG_EXTENDED | REG_ICASE) != 0)
+        if (regcomp(&regex, expr, REG_EXTENDED | REG_ICASE | REG_NOSUB) != 0)
             return 1;
     }
 
@@ -104,6 +242,14 @@ filter_set(int type, const char *expr)
     memcpy(&filters[type].regex, &regex, sizeof(regex));
 #endif
 
+    // Store the text required to match this expression
+    sng_free(filters[type].literal);
+    filters[type].literal = (expr) ? filter_expr_literal(expr) : NULL;
+    filters[type].literal_len = (filters[type].literal) ? strlen(filters[type].literal) : 0;
+
+    // Calls must be evaluated with the new filter
+    filter_version_bump();
+
     return 0;
 }
 
@@ -117,19 +263,28 @@ int
 filter_check_call(void *item)
 {
     int i;
-    char data[MAX_SIP_PAYLOAD];
+    char line[MAX_SIP_PAYLOAD];
+    const char *data;
     sip_call_t *call = (sip_call_t*) item;
-    sip_msg_t *msg;
-    vector_iter_t it;
 
     // Dont filter calls without messages
     if (call_msg_count(call) == 0)
         return 0;
 
     // Filter for this call has already be processed
-    if (call->filtered != -1)
+    if (!filter_call_outdated(call))
         return (call->filtered == 0);
 
+    // Filters have changed since last evaluation, check all messages again
+    if (call->filter_version != filters_version) {
+        call->filter_version = filters_version;
+        call->filter_payload_cnt = 0;
+        call->filter_payload = false;
+    }
+
+    // Store the number of messages for this evaluation
+    call->filter_msgcnt = call_msg_count(call);
+
     // By default, call matches all filters
     call->filtered = 0;
 
@@ -139,62 +294,49 @@ filter_check_call(void *item)
         if (!filters[i].expr)
             continue;
 
-        // Initialize
-        memset(data, 0, sizeof(data));
-
         // Get filtered field
         switch(i) {
             case FILTER_SIPFROM:
-                call_get_attribute(call, SIP_ATTR_SIPFROM, data);
+                data = call_get_attribute_cached(call, SIP_ATTR_SIPFROM);
                 break;
             case FILTER_SIPTO:
-                call_get_attribute(call, SIP_ATTR_SIPTO, data);
+                data = call_get_attribute_cached(call, SIP_ATTR_SIPTO);
                 break;
             case FILTER_SOURCE:
-                call_get_attribute(call, SIP_ATTR_SRC, data);
+                data = call_get_attribute_cached(call, SIP_ATTR_SRC);
                 break;
             case FILTER_DESTINATION:
-                call_get_attribute(call, SIP_ATTR_DST, data);
+                data = call_get_attribute_cached(call, SIP_ATTR_DST);
                 break;
             case FILTER_METHOD:
-                call_get_attribute(call, SIP_ATTR_METHOD, data);
+                data = call_get_attribute_cached(call, SIP_ATTR_METHOD);
                 break;
             case FILTER_PAYLOAD:
-                break;
+                // For payload filtering, check all messages payload
+                if (!filter_check_payload(call))
+                    call->filtered = 1;
+                continue;
             case FILTER_CALL_LIST:
                 // FIXME Maybe call should know how to calculate this line
-                call_list_line_text(ui_find_by_type(PANEL_CALL_LIST), call, data);
+                line[0] = '\0';
+                data = call_list_line_text(ui_find_by_type(PANEL_CALL_LIST), call, line);
                 break;
             default:
                 // Unknown filter id
                 return 0;
         }
 
-        // For payload filtering, check all messages payload
-        if (i == FILTER_PAYLOAD) {
-            // Assume this call doesn't match the filter
+        // Check the filter against given data
+        if (!data)
+            data = "";
+        if (filter_check_data(&filters[i], data, strlen(data)) != 0) {
+            // The data didn't matched the filter
             call->filtered = 1;
-            // Create an iterator for the call messages
-            it = vector_iterator(call->msgs);
-            while ((msg = vector_iterator_next(&it))) {
-                // Copy message payload
-                strcpy(data, msg_get_payload(msg));
-                // Check if this payload matches the filter
-                if (filter_check_expr(filters[i], data) == 0) {
-                    call->filtered = 0;
-                    break;
-                }
-            }
-            if (call->filtered == 1)
-                break;
-        } else {
-            // Check the filter against given data
-            if (filter_check_expr(filters[i], data) != 0) {
-                // The data didn't matched the filter
-                call->filtered = 1;
-                break;
-            }
         }
+
+        // No need to check more filters
+        if (call->filtered == 1)
+            break;
     }
 
     // Return the final filter status
@@ -202,28 +344,140 @@ filter_check_call(void *item)
 }
 
 int
-filter_check_expr(filter_t filter, const char *data)
+filter_check_call_cached(void *item)
+{
+    sip_call_t *call = (sip_call_t*) item;
+
+    // Calls not evaluated with current filters are not displayed yet
+    if (call_msg_count(call) == 0 || call->filter_version != filters_version)
+        return 0;
+
+    return (call->filtered == 0);
+}
+
+int
+filter_update_calls(int msec)
+{
+    sip_call_t *call;
+    struct timeval start, now;
+    int evaluated = 0, pending = 0;
+    bool expired = false;
+    vector_iter_t calls = sip_calls_iterator();
+
+    // All calls are evaluated with current filters
+    if (!filters_pending)
+        return 0;
+
+    gettimeofday(&start, NULL);
+
+    while ((call = vector_iterator_next(&calls))) {
+        // Filter status is up to date
+        if (!filter_call_outdated(call))
+            continue;
+
+        // Time for this update has expired, only count pending calls
+        if (expired) {
+            pending++;
+            continue;
+        }
+
+        filter_check_call(call);
+
+        // Check elapsed time every few evaluated calls
+        if (++evaluated % FILTER_UPDATE_STEP == 0) {
+            gettimeofday(&now, NULL);
+            expired = (now.tv_sec - start.tv_sec) * 1000
+                      + (now.tv_usec - start.tv_usec) / 1000 >= msec;
+        }
+    }
+
+    return (filters_pending = pending);
+}
+
+int
+filter_update_pending()
 {
+    return filters_pending;
+}
+
+unsigned int
+filter_get_version()
+{
+    return filters_version;
+}
+
+/**
+ * @brief Check if data contains the filter literal text
+ *
+ * Filters are case insensitive, so the literal text is compared
+ * ignoring case. Literals without letters are searched using memmem.
+ *
+ * @return true if data contains the literal or filter has no literal
+ */
+static bool
+filter_check_literal(filter_t *filter, const char *data, size_t len)
+{
+    const char *literal = filter->literal;
+    size_t i, llen = filter->literal_len;
+    int first;
+
+    // No literal text in this filter
+    if (!literal)
+        return true;
+
+    if (llen > len)
+        return false;
+
+    for (i = 0; i < llen; i++) {
+        if (isalpha((unsigned char) literal[i]))
+            break;
+    }
+
+    // Nothing to compare ignoring case
+    if (i == llen)
+        return memmem(data, len, literal, llen) != NULL;
+
+    first = tolower((unsigned char) literal[0]);
+    for (i = 0; i <= len - llen; i++) {
+        if (tolower((unsigned char) data[i]) == first
+            && !strncasecmp(data + i + 1, literal + 1, llen - 1))
+            return true;
+    }
+
+    return false;
+}
+
+int
+filter_check_data(filter_t *filter, const char *data, size_t len)
+{
+    // Discard data that can not match before running the expression
+    if (!filter_check_literal(filter, data, len))
+        return 1;
+
 #ifdef WITH_PCRE
-        return pcre_exec(filter.regex, 0, data, strlen(data), 0, 0, 0, 0);
+    return (pcre_exec(filter->regex, filter->extra, data, len, 0, 0, 0, 0) >= 0) ? 0 : 1;
 #elif defined(WITH_PCRE2)
-    pcre2_match_data *match_data = pcre2_match_data_create_from_pattern(filter.regex, NULL);
-    int ret = pcre2_match(filter.regex, (PCRE2_SPTR) data, (PCRE2_SIZE) strlen(data), 0, 0, match_data, NULL);
-    pcre2_match_data_free(match_data);
-    return (ret == PCRE2_ERROR_NOMATCH) ? 1 : 0;
+    int ret = pcre2_match(filter->regex, (PCRE2_SPTR) data, (PCRE2_SIZE) len, 0, 0, filter->match_data, NULL);
+    return (ret >= 0) ? 0 : 1;
+#elif defined(REG_STARTEND)
+    // Match the given length instead of searching the end of the data
+    regmatch_t pmatch = { .rm_so = 0, .rm_eo = len };
+    return regexec(&filter->regex, data, 1, &pmatch, REG_STARTEND);
 #else
-        // Call doesn't match this filter
-        return regexec(&filter.regex, data, 0, NULL, 0);
+    // Call doesn't match this filter
+    return regexec(&filter->regex, data, 0, NULL, 0);
 #endif
 }
 
+int
+filter_check_expr(filter_t filter, const char *data)
+{
+    return filter_check_data(&filter, data, strlen(data));
+}
+
 void
 filter_reset_calls()
 {
-    sip_call_t *call;
-    vector_iter_t calls = sip_calls_iterator();
-
     // Force filter evaluation
-    while ((call = vector_iterator_next(&calls)))
-        call->filtered = -1;
+    filter_version_bump();
 }
@@ -50,6 +50,14 @@
 #endif
 #include "sip.h"
 
+//! Number of calls evaluated between update time checks
+#define FILTER_UPDATE_STEP  256
+//! Maximum time (ms) spent evaluating calls in each call list redraw
+#define FILTER_UPDATE_MSEC  50
+
+//! Regular expression special characters
+#define FILTER_REGEX_META   "\\^$.[]()?*+{}|"
+
 //! Shorter declaration of sip_call_group structure
 typedef struct filter filter_t;
 
@@ -81,12 +89,20 @@ enum filter_type {
 struct filter {
     //! The filter text
     char *expr;
+    //! Literal text any matching data must contain
+    char *literal;
+    //! Literal text length
+    size_t literal_len;
 #ifdef WITH_PCRE
     //! The filter compiled expression
     pcre *regex;
+    //! The filter study data (JIT compiled expression)
+    pcre_extra *extra;
 #elif defined(WITH_PCRE2)
     //! The filter compiled expression
     pcre2_code *regex;
+    //! Match data reused by each check of this filter
+    pcre2_match_data *match_data;
 #else
     //! The filter compiled expression
     regex_t regex;
@@ -125,6 +141,47 @@ filter_get(int type);
 int
 filter_check_call(void *item);
 
+/**
+ * @brief Check if a call is filtered without evaluating filters
+ *
+ * This function only returns the result of the last evaluation of
+ * the current filters. Calls not evaluated yet are never displayed.
+ *
+ * @param call Call to be checked
+ * @return 1 if call is filtered
+ */
+int
+filter_check_call_cached(void *item);
+
+/**
+ * @brief Evaluate filters on calls with outdated filter status
+ *
+ * After filters change, calls are evaluated again with the new
+ * filters. The evaluation stops after the given time, so big call
+ * lists are filtered in several invocations without blocking the
+ * interface. This does nothing if there are no pending calls.
+ *
+ * @param msec Maximum evaluation time in milliseconds
+ * @return number of calls pending to be evaluated
+ */
+int
+filter_update_calls(int msec);
+
+/**
+ * @brief Number of calls pending to be evaluated after last update
+ */
+int
+filter_update_pending();
+
+/**
+ * @brief Return filters version
+ *
+ * Version changes each time a filter changes, so any view of
+ * filtered calls must be rebuilt.
+ */
+unsigned int
+filter_get_version();
+
 /**
  * @brief Check if data matches the filter regexp
  *
@@ -133,11 +190,25 @@ filter_check_call(void *item);
 int
 filter_check_expr(filter_t filter, const char *data);
 
+/**
+ * @brief Check if data of given length matches the filter regexp
+ *
+ * Data is not required to be NULL terminated.
+ *
+ * @param filter Filter to check
+ * @param data Data to be checked
+ * @param len Data length
+ * @return 0 if the given data matches the filter
+ */
+int
+filter_check_data(filter_t *filter, const char *data, size_t len);
+
 /**
  * @brief Reset filtered flag in all calls
  *
  * This function can be used to force reevaluation
- * of filters in all calls.
+ * of filters in all calls. Calls will be evaluated again
+ * the next time they are checked.
  */
 void
 filter_reset_calls();
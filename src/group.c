@@ -38,6 +38,8 @@ call_group_create()
         return NULL;
     }
     group->calls = vector_create(5, 2);
+    group->msgs = vector_create(200, 50);
+    group->entries = vector_create(5, 2);
     return group;
 }
 
@@ -50,6 +52,9 @@ call_group_destroy(sip_call_group_t *group)
         call_group_del(group, call);
     }
     vector_destroy(group->calls);
+    call_group_clear_msgs(group);
+    vector_destroy(group->msgs);
+    vector_destroy(group->entries);
     sng_free(group);
 }
 
@@ -91,6 +96,8 @@ call_group_clone(sip_call_group_t *original)
     }
 
     clone->calls = vector_clone(original->calls);
+    clone->msgs = vector_create(200, 50);
+    clone->entries = vector_create(5, 2);
     return clone;
 }
 
@@ -189,107 +196,196 @@ call_group_count(sip_call_group_t *group)
 int
 call_group_msg_count(sip_call_group_t *group)
 {
-    sip_call_t *call;
-    vector_iter_t msgs;
-    int msgcnt = 0, i;
-
-    for (i = 0; i < vector_count(group->calls); i++) {
-        call = vector_item(group->calls, i);
-        msgs = vector_iterator(call->msgs);
-        if (group->sdp_only) {
-            vector_iterator_set_filter(&msgs, msg_has_sdp);
-        }
-        msgcnt += vector_iterator_count(&msgs);
-    }
-    return msgcnt;
+    call_group_merge_msgs(group);
+    return vector_count(group->msgs);
 }
 
 int
 call_group_msg_number(sip_call_group_t *group, sip_msg_t *msg)
 {
-    int number = 0;
-    sip_msg_t *cur = NULL;
-    while ((cur = call_group_get_next_msg(group, cur))) {
-        if (group->sdp_only && !msg_has_sdp(msg))
-            continue;
-
-        if (cur == msg)
-            return number;
-        number++;
-    }
-    return 0;
+    int pos = call_group_msg_position(group, msg);
+    return (vector_item(group->msgs, pos) == msg) ? pos : 0;
 }
 
-sip_msg_t *
-call_group_get_next_msg(sip_call_group_t *group, sip_msg_t *msg)
+void
+call_group_merge_msgs(sip_call_group_t *group)
 {
-    sip_msg_t *next;
-
-    if (call_group_count(group) == 1) {
-        sip_call_t *call = vector_first(group->calls);
-        vector_iter_t it = vector_iterator(call->msgs);
-        vector_iterator_set_current(&it, vector_index(call->msgs, msg));
-        next = vector_iterator_next(&it);
-    } else {
-        vector_t *messages = vector_create(1,10);
-        vector_set_sorter(messages, call_group_msg_sorter);
-        vector_iter_t callsit = vector_iterator(group->calls);
-        sip_call_t *call;
-        while ((call = vector_iterator_next(&callsit))) {
-            vector_append_vector(messages, call->msgs);
+    sip_call_group_entry_t *entry, *next_entry;
+    sip_msg_t *msg, *next;
+    sip_call_t *call;
+    vector_t *pending;
+    int i, j, k, count;
+
+    // Build the timeline again if group calls or display mode have changed
+    if (group->msgs_sdp_only != group->sdp_only
+        || vector_count(group->entries) > vector_count(group->calls)) {
+        call_group_clear_msgs(group);
+    }
+    for (i = 0; i < vector_count(group->entries); i++) {
+        entry = vector_item(group->entries, i);
+        if (entry->call != vector_item(group->calls, i)) {
+            call_group_clear_msgs(group);
+            break;
         }
+    }
+    group->msgs_sdp_only = group->sdp_only;
 
-        if (msg == NULL) {
-            next = vector_first(messages);
-        } else {
-            next = vector_item(messages, vector_index(messages, msg) + 1);
+    // Add merge status for new calls of the group
+    for (i = vector_count(group->entries); i < vector_count(group->calls); i++) {
+        if (!(entry = sng_malloc(sizeof(sip_call_group_entry_t))))
+            return;
+        entry->call = vector_item(group->calls, i);
+        vector_append(group->entries, entry);
+    }
+
+    // Make room to store new message positions
+    for (i = 0; i < vector_count(group->entries); i++) {
+        entry = vector_item(group->entries, i);
+        count = vector_count(entry->call->msgs);
+        if (entry->poslen < count) {
+            entry->poslen = count * 2;
+            entry->positions = realloc(entry->positions, sizeof(int) * entry->poslen);
         }
-        vector_destroy(messages);
     }
 
-    next = sip_parse_msg(next);
-    if (next && group->sdp_only && !msg_has_sdp(next)) {
-        return call_group_get_next_msg(group, next);
+    // K-way merge of new messages of each call
+    pending = vector_create(50, 50);
+    while (1) {
+        next = NULL;
+        next_entry = NULL;
+        for (i = 0; i < vector_count(group->entries); i++) {
+            entry = vector_item(group->entries, i);
+            call = entry->call;
+            while ((msg = vector_item(call->msgs, entry->msgcnt))) {
+                // Skip messages that are not displayed in this mode
+                if (group->sdp_only && !msg_has_sdp(msg)) {
+                    entry->positions[entry->msgcnt++] = -1;
+                    continue;
+                }
+                // Oldest message wins, calls added first win on ties
+                if (!next || !msg_is_older(msg, next)) {
+                    next = msg;
+                    next_entry = entry;
+                }
+                break;
+            }
+        }
+        if (!next)
+            break;
+        next_entry->msgcnt++;
+        vector_append(pending, next);
     }
 
-    return next;
+    // Calls messages are stored in arrival order, move back late ones
+    for (j = 1; j < vector_count(pending); j++) {
+        next = vector_item(pending, j);
+        for (k = j; k > 0 && !msg_is_older(next, vector_item(pending, k - 1)); k--)
+            vector_set_item(pending, k, vector_item(pending, k - 1));
+        vector_set_item(pending, k, next);
+    }
+
+    // Merge new messages from the end of the timeline
+    if ((count = vector_count(pending))) {
+        i = vector_count(group->msgs) - 1;
+        for (j = 0; j < count; j++)
+            vector_append(group->msgs, vector_item(pending, j));
+        k = vector_count(group->msgs) - 1;
+        for (j = count - 1; j >= 0; k--) {
+            msg = vector_item(group->msgs, i);
+            if (i >= 0 && !msg_is_older(vector_item(pending, j), msg)) {
+                vector_set_item(group->msgs, k, msg);
+                i--;
+            } else {
+                vector_set_item(group->msgs, k, vector_item(pending, j--));
+            }
+        }
+
+        // Update positions of moved and new messages
+        for (k = k + 1; k < vector_count(group->msgs); k++) {
+            msg = vector_item(group->msgs, k);
+            entry = vector_item(group->entries, vector_index(group->calls, msg->call));
+            entry->positions[msg->index] = k;
+        }
+    }
+    vector_destroy(pending);
 }
 
-sip_msg_t *
-call_group_get_prev_msg(sip_call_group_t *group, sip_msg_t *msg)
+void
+call_group_clear_msgs(sip_call_group_t *group)
 {
-    sip_msg_t *prev;
-
-    if (call_group_count(group) == 1) {
-        sip_call_t *call = vector_first(group->calls);
-        vector_iter_t it = vector_iterator(call->msgs);
-        vector_iterator_set_current(&it, vector_index(call->msgs, msg));
-        prev = vector_iterator_prev(&it);
-    } else {
-        vector_t *messages = vector_create(1, 10);
-        vector_set_sorter(messages, call_group_msg_sorter);
-
-
-        vector_iter_t callsit = vector_iterator(group->calls);
-        sip_call_t *call;
-        while ((call = vector_iterator_next(&callsit))) {
-            vector_append_vector(messages, call->msgs);
-        }
+    sip_call_group_entry_t *entry;
+    vector_iter_t it;
+
+    it = vector_iterator(group->entries);
+    while ((entry = vector_iterator_next(&it))) {
+        sng_free(entry->positions);
+        sng_free(entry);
+    }
 
-        if (msg == NULL) {
-            prev = vector_last(messages);
+    // Recreate vectors instead of removing items one by one
+    vector_destroy(group->entries);
+    group->entries = vector_create(5, 2);
+    vector_destroy(group->msgs);
+    group->msgs = vector_create(200, 50);
+}
+
+int
+call_group_msg_position(sip_call_group_t *group, sip_msg_t *msg)
+{
+    sip_call_group_entry_t *entry;
+    int low, high, mid;
+
+    call_group_merge_msgs(group);
+
+    if (!msg)
+        return -1;
+
+    // Merged messages know their position
+    entry = vector_item(group->entries, vector_index(group->calls, msg->call));
+    if (entry && msg->index < entry->msgcnt && entry->positions[msg->index] >= 0)
+        return entry->positions[msg->index];
+
+    // Otherwise, look for the first newer message in the timeline
+    low = 0;
+    high = vector_count(group->msgs);
+    while (low < high) {
+        mid = (low + high) / 2;
+        if (msg_is_older(msg, vector_item(group->msgs, mid))) {
+            low = mid + 1;
         } else {
-            prev = vector_item(messages, vector_index(messages, msg) - 1);
+            high = mid;
         }
-        vector_destroy(messages);
     }
+    return low;
+}
+
+sip_msg_t *
+call_group_get_next_msg(sip_call_group_t *group, sip_msg_t *msg)
+{
+    int pos;
 
-    prev = sip_parse_msg(prev);
-    if (prev && group->sdp_only && !msg_has_sdp(prev)) {
-        return call_group_get_prev_msg(group, prev);
+    if (!msg) {
+        call_group_merge_msgs(group);
+        return sip_parse_msg(vector_first(group->msgs));
     }
 
-    return prev;
+    // Message after given one (or after its position if it's not merged)
+    pos = call_group_msg_position(group, msg);
+    if (vector_item(group->msgs, pos) == msg)
+        pos++;
+
+    return sip_parse_msg(vector_item(group->msgs, pos));
+}
+
+sip_msg_t *
+call_group_get_prev_msg(sip_call_group_t *group, sip_msg_t *msg)
+{
+    if (!msg) {
+        call_group_merge_msgs(group);
+        return sip_parse_msg(vector_last(group->msgs));
+    }
+
+    return sip_parse_msg(vector_item(group->msgs, call_group_msg_position(group, msg) - 1));
 }
 
 rtp_stream_t *
@@ -319,27 +415,3 @@ call_group_get_next_stream(sip_call_group_t *group, rtp_stream_t *stream)
 
     return next;
 }
-
-void
-call_group_msg_sorter(vector_t *vector, void *item)
-{
-    struct timeval curts, prevts;
-    int count = vector_count(vector);
-    int i;
-
-    // Current and last packet times
-    curts = msg_get_time(item);
-
-    for (i = count - 2 ; i >= 0; i--) {
-        // Get previous packet
-        prevts = msg_get_time(vector_item(vector, i));
-        // Check if the item is already in a sorted position
-        if (timeval_is_older(curts, prevts)) {
-            vector_insert(vector, item, i + 1);
-            return;
-        }
-    }
-
-    // Put this item at the begining of the vector
-    vector_insert(vector, item, 0);
-}
@@ -39,6 +39,26 @@
 
 //! Shorter declaration of sip_call_group structure
 typedef struct sip_call_group sip_call_group_t;
+//! Shorter declaration of sip_call_group_entry structure
+typedef struct sip_call_group_entry sip_call_group_entry_t;
+
+/**
+ * @brief Merge status of one call of the group
+ *
+ * Calls only append messages, so each call remembers how many of its
+ * messages are already merged into the group timeline and where each
+ * one of them is.
+ */
+struct sip_call_group_entry {
+    //! Call of the group
+    sip_call_t *call;
+    //! Number of call messages already merged
+    int msgcnt;
+    //! Timeline position of each merged message (-1 if not in timeline)
+    int *positions;
+    //! Allocated entries in positions array
+    int poslen;
+};
 
 /**
  * @brief Contains a list of calls
@@ -56,6 +76,12 @@ struct sip_call_group {
     int color;
     //! Only consider SDP messages from Calls
     int sdp_only;
+    //! Messages of all calls in chronological order
+    vector_t *msgs;
+    //! Merge status of each call of the group (sip_call_group_entry_t *)
+    vector_t *entries;
+    //! SDP only mode of the merged messages
+    int msgs_sdp_only;
 };
 
 /**
@@ -197,6 +223,40 @@ call_group_msg_count(sip_call_group_t *group);
 int
 call_group_msg_number(sip_call_group_t *group, sip_msg_t *msg);
 
+/**
+ * @brief Merge new messages of group calls into the group timeline
+ *
+ * Messages added to the calls since the last merge are merged with
+ * a k-way merge of each call message list and then merged into the
+ * existing timeline. The timeline is built again from scratch if the
+ * group calls or the SDP only mode have changed.
+ *
+ * @param group Pointer to an existing group
+ */
+void
+call_group_merge_msgs(sip_call_group_t *group);
+
+/**
+ * @brief Remove all merged messages from the group timeline
+ *
+ * @param group Pointer to an existing group
+ */
+void
+call_group_clear_msgs(sip_call_group_t *group);
+
+/**
+ * @brief Return the timeline position of a message
+ *
+ * Messages that are not part of the timeline are positioned after the
+ * last timeline message that is not newer than them.
+ *
+ * @param group Pointer to an existing group
+ * @param msg A sip message
+ * @return timeline position of the message
+ */
+int
+call_group_msg_position(sip_call_group_t *group, sip_msg_t *msg);
+
 /**
  * @brief Finds the next msg in a call group.
  *
@@ -230,12 +290,4 @@ call_group_get_prev_msg(sip_call_group_t *group, sip_msg_t *msg);
 rtp_stream_t *
 call_group_get_next_stream(sip_call_group_t *group, rtp_stream_t *stream);
 
-/**
- * @brief Sort messages in a group by message time
- * @param vector sorted vector
- * @param item item to add to the vector
- */
-void
-call_group_msg_sorter(vector_t *vector, void *item);
-
 #endif /* __SNGREP_GROUP_H_ */
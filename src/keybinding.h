@@ -90,6 +90,7 @@ enum key_actions {
     ACTION_SHOW_COLUMNS,
     ACTION_SHOW_SETTINGS,
     ACTION_SHOW_STATS,
+    ACTION_SHOW_PIPELINE,
     ACTION_COLUMN_MOVE_UP,
     ACTION_COLUMN_MOVE_DOWN,
     ACTION_SDP_INFO,
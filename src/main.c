@@ -36,6 +36,9 @@
 #include "vector.h"
 #include "capture.h"
 #include "capture_eep.h"
+#include "event.h"
+#include "cdr.h"
+#include "metrics.h"
 #include "curses/ui_save.h"
 #ifdef WITH_GNUTLS
 #include "capture_gnutls.h"
@@ -53,7 +56,7 @@
 void
 usage()
 {
-    printf("Usage: %s [-hVcivNqrD] [-IO pcap_dump] [-d dev] [-l limit] [-B buffer]"
+    printf("Usage: %s [-hVcivNqrD] [-IO pcap_dump] [-j json_file] [-C cdr_file] [-d dev] [-l limit] [-B buffer]"
 #if defined(WITH_GNUTLS) || defined(WITH_OPENSSL)
            " [-k keyfile]"
 #endif
@@ -65,7 +68,8 @@ usage()
            "    -V --version\t Version information\n"
            "    -d --device\t\t Use this capture device instead of default\n"
            "    -I --input\t\t Read captured data from pcap file\n"
-           "    -O --output\t\t Write captured data to pcap file\n"
+           "    -O --output\t\t Write captured data to pcap file. With dump rotation\n"
+           "    \t\t\t enabled, strftime fields (like %%Y%%m%%d-%%H%%M) are expanded\n"
            "    -B --buffer\t\t Set pcap buffer size in MB (default: 2)\n"
            "    -c --calls\t\t Only display dialogs starting with INVITE\n"
            "    -r --rtp\t\t Capture RTP packets payload\n"
@@ -78,10 +82,12 @@ usage()
            "    -f --config\t\t Read configuration from file\n"
            "    -F --no-config\t Do not read configuration from default config file\n"
            "    -T --text\t Save pcap to text file\n"
+           "    -j --json\t\t Stream SIP events as JSON lines to file (- for stdout)\n"
+           "    -C --cdr\t\t Write Call Detail Records to file (- for stdout)\n"
            "    -R --rotate\t\t Rotate calls when capture limit have been reached\n"
 #ifdef USE_EEP
            "    -H --eep-send\t Homer sipcapture url (udp:X.X.X.X:XXXX)\n"
-           "    -L --eep-listen\t Listen for encapsulated packets (udp:X.X.X.X:XXXX)\n"
+           "    -L --eep-listen\t Listen for encapsulated packets (udp|tcp:X.X.X.X:XXXX)\n"
            "    -E --eep-parse\t Enable EEP parsing in captured packets\n"
 #endif
 #if defined(WITH_GNUTLS) || defined(WITH_OPENSSL)
@@ -130,7 +136,7 @@ int
 main(int argc, char* argv[])
 {
     int opt, idx, limit, only_calls, no_incomplete, pcap_buffer_size, i;
-    const char *device, *outfile, *text_outfile = NULL;
+    const char *device, *outfile, *text_outfile = NULL, *json_outfile = NULL, *cdr_outfile = NULL;
     char bpf[512];
 #if defined(WITH_GNUTLS) || defined(WITH_OPENSSL)
     const char *keyfile;
@@ -141,6 +147,8 @@ main(int argc, char* argv[])
     vector_t *infiles = vector_create(0, 1);
     vector_t *indevices = vector_create(0, 1);
     char *token;
+    capture_dump_stats_t dump;
+    event_stats_t event;
 
     // Program options
     static struct option long_options[] = {
@@ -164,6 +172,8 @@ main(int argc, char* argv[])
         { "config", required_argument, 0, 'f' },
         { "no-config", no_argument, 0, 'F' },
         { "text", required_argument, 0, 'T' },
+        { "json", required_argument, 0, 'j' },
+        { "cdr", required_argument, 0, 'C' },
 #ifdef USE_EEP
         { "eep-listen", required_argument, 0, 'L' },
         { "eep-send", required_argument, 0, 'H' },
@@ -174,7 +184,7 @@ main(int argc, char* argv[])
 
     // Parse command line arguments that have high priority
     opterr = 0;
-    char *options = "hVd:I:O:B:pqtW:k:crl:ivNqDL:H:ERf:FT";
+    char *options = "hVd:I:O:B:pqtW:k:crl:ivNqDL:H:ERf:FTj:C:";
     while ((opt = getopt_long(argc, argv, options, long_options, &idx)) != -1) {
         switch (opt) {
             case 'h':
@@ -234,6 +244,16 @@ main(int argc, char* argv[])
                 no_interface = 1;
                 setting_set_value(SETTING_CAPTURE_STORAGE, "none");
                 break;
+            case 'j':
+                json_outfile = optarg;
+                no_interface = 1;
+                setting_set_value(SETTING_CAPTURE_STORAGE, "none");
+                break;
+            case 'C':
+                cdr_outfile = optarg;
+                no_interface = 1;
+                setting_set_value(SETTING_CAPTURE_STORAGE, "none");
+                break;
             case 'B':
                 if(!(pcap_buffer_size = atoi(optarg))) {
                     fprintf(stderr, "Invalid buffer size.\n");
@@ -403,9 +423,34 @@ main(int argc, char* argv[])
 
     if (outfile)
     {
-        ino_t dump_inode;
-        pcap_dumper_t *dumper = dump_open(outfile, &dump_inode);
-        capture_set_dumper(dumper, dump_inode);
+        if (capture_set_dumpfile(outfile) != 0) {
+            fprintf(stderr, "Couldn't open output dump file %s\n", outfile);
+            return 1;
+        }
+    }
+
+    // Stream SIP events to the json file
+    if (json_outfile) {
+        if (event_stream_open(json_outfile) != 0) {
+            fprintf(stderr, "Couldn't open json output file %s\n", json_outfile);
+            return 1;
+        }
+        // Dialog counter would be mixed with the events
+        if (!strcmp(json_outfile, "-"))
+            quiet = 1;
+    }
+
+    // Write CDRs of ended calls
+    if (cdr_outfile) {
+        // Text output needs all calls at the end of the capture
+        if (text_outfile)
+            setting_set_value(SETTING_CDR_RELEASE, SETTING_OFF);
+        if (cdr_open(cdr_outfile) != 0) {
+            fprintf(stderr, "Couldn't open cdr output file %s\n", cdr_outfile);
+            return 1;
+        }
+        if (!strcmp(cdr_outfile, "-"))
+            quiet = 1;
     }
 
     // Remove Input files vector
@@ -447,6 +492,17 @@ main(int argc, char* argv[])
             }
     }
 
+    // Export internal metrics
+    if (metrics_init(!no_interface) != 0) {
+        fprintf(stderr, "Couldn't start metrics exporter on %s:%d\n",
+                setting_get_value(SETTING_METRICS_ADDRESS), setting_get_intvalue(SETTING_METRICS_PORT));
+        // Close already opened output files
+        capture_close();
+        cdr_close();
+        event_stream_close();
+        return 1;
+    }
+
     // Start a capture thread
     if (capture_launch_thread() != 0) {
         ncurses_deinit();
@@ -462,14 +518,24 @@ main(int argc, char* argv[])
         ui_create_panel(PANEL_CALL_LIST);
         ui_wait_for_input();
     } else {
-        setbuf(stdout, NULL);
+        // Print dialog counter as soon as it changes
+        if (!quiet)
+            setbuf(stdout, NULL);
         while(capture_is_running() && !was_sigterm_received()) {
             if (!quiet)
                 printf("\rDialog count: %d", sip_calls_count_unrotated());
+            // Don't keep CDRs buffered when there are few calls
+            cdr_flush();
             usleep(500 * 1000);
         }
         if (!quiet)
             printf("\rDialog count: %d\n", sip_calls_count_unrotated());
+
+        // Warn about captured packets not stored in dump file
+        capture_dump_stats(&dump);
+        if (dump.dropped)
+            fprintf(stderr, "Dump file: %lu packets dropped (max %lu pending)\n",
+                    dump.dropped, dump.highwater);
     }
 
 
@@ -498,9 +564,27 @@ main(int argc, char* argv[])
         }
         fclose(f);
     }
+    // Stop exporter before removing capture sources
+    metrics_deinit();
+
     // Capture deinit
     capture_deinit();
 
+    // Write pending records
+    cdr_close();
+
+    // Write pending events
+    event_stream_stats(&event);
+    event_stream_close();
+    if (event.dropped)
+        fprintf(stderr, "JSON output: %llu events dropped (max %llu pending)\n",
+                (unsigned long long) event.dropped, (unsigned long long) event.highwater);
+
+#ifdef USE_EEP
+    // Stop EEP sender and close its sockets
+    capture_eep_deinit();
+#endif
+
     // Deinitialize interface
     ncurses_deinit();
 
@@ -0,0 +1,689 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file metrics.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Source code of functions defined in metrics.h
+ *
+ */
+#include "config.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "metrics.h"
+#include "capture.h"
+#include "event.h"
+#include "packet.h"
+#include "setting.h"
+#include "sip.h"
+
+//! Global metrics
+metrics_t metrics = { .sock = -1, .reportfd = -1 };
+
+//! Names of subsystems with tracked memory (@see metrics_memory)
+static const char *metrics_memory_names[METRICS_MEM_COUNT] = {
+    "packets", "dump", "events"
+};
+
+//! Names of pipeline stages (@see metrics_stage)
+static const char *metrics_stage_names[METRICS_STAGE_COUNT] = {
+    "reasm_ip", "reasm_tcp", "tls", "sip", "rtp", "dump", "eep"
+};
+
+//! Stage timers report has been requested
+static atomic_int sigusr2_received = 0;
+
+static void
+sigusr2_handler(int signum)
+{
+    sigusr2_received = 1;
+}
+
+int
+metrics_init(bool interface)
+{
+    const char *filename = setting_get_value(SETTING_METRICS_FILE);
+    int port = setting_get_intvalue(SETTING_METRICS_PORT);
+
+    metrics.filename = (filename && strlen(filename)) ? filename : NULL;
+    metrics.interval = setting_get_intvalue(SETTING_METRICS_INTERVAL);
+    if (metrics.interval <= 0)
+        metrics.interval = 1;
+    metrics.stages = setting_enabled(SETTING_METRICS_STAGES);
+
+    // Exporter is disabled
+    if (!metrics.filename && port <= 0 && !metrics.stages)
+        return 0;
+
+    // Write stage timers report on SIGUSR2
+    if (metrics.stages) {
+        // Don't write to the terminal while ncurses is using it
+        if (interface) {
+            if (metrics.filename) {
+                snprintf(metrics.report, sizeof(metrics.report), "%s.stages", metrics.filename);
+                metrics.reportfd = open(metrics.report, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW, 0600);
+            } else {
+                // Never use a predictable name in the temporary directory
+                snprintf(metrics.report, sizeof(metrics.report), "%s/sngrep-stages-XXXXXX", P_tmpdir);
+                metrics.reportfd = mkstemp(metrics.report);
+                metrics.reporttmp = true;
+            }
+            if (metrics.reportfd < 0)
+                metrics.report[0] = '\0';
+        }
+        metrics.interface = interface;
+        signal(SIGUSR2, sigusr2_handler);
+    }
+
+    // Open HTTP endpoint socket
+    if (port > 0) {
+        if ((metrics.sock = metrics_http_listen(setting_get_value(SETTING_METRICS_ADDRESS), port)) < 0)
+            return 1;
+    }
+
+    atomic_store(&metrics.running, true);
+    if (pthread_create(&metrics.thread, NULL, metrics_run, NULL) != 0) {
+        atomic_store(&metrics.running, false);
+        if (metrics.sock >= 0)
+            close(metrics.sock);
+        metrics.sock = -1;
+        return 1;
+    }
+
+    return 0;
+}
+
+void
+metrics_deinit()
+{
+    if (!atomic_exchange(&metrics.running, false))
+        return;
+
+    pthread_join(metrics.thread, NULL);
+
+    if (metrics.sock >= 0)
+        close(metrics.sock);
+    metrics.sock = -1;
+
+    if (metrics.reportfd >= 0) {
+        close(metrics.reportfd);
+        // Don't leave empty files in the temporary directory
+        if (metrics.reporttmp && !metrics.reported)
+            unlink(metrics.report);
+    }
+    metrics.reportfd = -1;
+}
+
+void *
+metrics_run(void *data)
+{
+    struct pollfd pfd;
+    uint64_t now, next = 0;
+    int client, timeout;
+
+    while (atomic_load(&metrics.running)) {
+        now = metrics_now();
+
+        // Report requested through SIGUSR2
+        if (atomic_exchange(&sigusr2_received, 0))
+            metrics_write_report();
+
+        // Rewrite textfile every interval
+        if (metrics.filename && now >= next) {
+            metrics_write_file(metrics.filename);
+            next = now + (uint64_t) metrics.interval * 1000000000;
+        }
+
+        // Wake up at least each 200ms to check if exporter has been stopped
+        timeout = 200;
+        if (metrics.filename && (next - now) / 1000000 < (uint64_t) timeout)
+            timeout = (next - now) / 1000000;
+
+        if (metrics.sock < 0) {
+            usleep(timeout * 1000);
+            continue;
+        }
+
+        // Wait for HTTP clients
+        pfd.fd = metrics.sock;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, timeout) > 0 && (pfd.revents & POLLIN)) {
+            if ((client = accept(metrics.sock, NULL, NULL)) >= 0) {
+                metrics_http_serve(client);
+                close(client);
+            }
+        }
+    }
+
+    // Last values before leaving
+    if (metrics.filename)
+        metrics_write_file(metrics.filename);
+
+    return NULL;
+}
+
+uint64_t
+metrics_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void
+metrics_histogram_observe(metrics_histogram_t *histogram, uint64_t ns)
+{
+    uint64_t max = atomic_load_explicit(&histogram->max, memory_order_relaxed);
+
+    atomic_fetch_add_explicit(&histogram->buckets[metrics_histogram_index(ns)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->sum, ns, memory_order_relaxed);
+
+    // Update max value (retry if other thread has changed it)
+    while (ns > max && !atomic_compare_exchange_weak_explicit(&histogram->max, &max, ns,
+                                                              memory_order_relaxed, memory_order_relaxed));
+}
+
+int
+metrics_histogram_index(uint64_t value)
+{
+    int bit;
+
+    // First values are stored in their own bucket
+    if (value < METRICS_HISTOGRAM_SUB)
+        return value;
+
+    // Split each power of two in linear sub-buckets using its highest bits
+    bit = 63 - __builtin_clzll(value);
+    return (bit - METRICS_HISTOGRAM_SUBBITS + 1) * METRICS_HISTOGRAM_SUB
+           + ((value >> (bit - METRICS_HISTOGRAM_SUBBITS)) & (METRICS_HISTOGRAM_SUB - 1));
+}
+
+uint64_t
+metrics_histogram_lower(int index)
+{
+    int bit;
+
+    if (index < METRICS_HISTOGRAM_SUB)
+        return index;
+
+    bit = index / METRICS_HISTOGRAM_SUB + METRICS_HISTOGRAM_SUBBITS - 1;
+    return (uint64_t) (METRICS_HISTOGRAM_SUB + index % METRICS_HISTOGRAM_SUB)
+           << (bit - METRICS_HISTOGRAM_SUBBITS);
+}
+
+uint64_t
+metrics_histogram_count(metrics_histogram_t *histogram)
+{
+    uint64_t count = 0;
+    int i;
+
+    for (i = 0; i < METRICS_HISTOGRAM_SIZE; i++)
+        count += atomic_load_explicit(&histogram->buckets[i], memory_order_relaxed);
+    return count;
+}
+
+uint64_t
+metrics_histogram_percentile(metrics_histogram_t *histogram, double percent)
+{
+    uint64_t count, total, max;
+    int i;
+
+    if (!(total = metrics_histogram_count(histogram)))
+        return 0;
+
+    max = atomic_load_explicit(&histogram->max, memory_order_relaxed);
+    count = (uint64_t) (total * percent / 100);
+    if (count < 1)
+        count = 1;
+
+    for (i = 0; i < METRICS_HISTOGRAM_SIZE - 1; i++) {
+        if (atomic_load_explicit(&histogram->buckets[i], memory_order_relaxed) >= count)
+            break;
+        count -= atomic_load_explicit(&histogram->buckets[i], memory_order_relaxed);
+    }
+
+    // Highest value of the bucket, never above the observed max
+    if (i == METRICS_HISTOGRAM_SIZE - 1 || metrics_histogram_lower(i + 1) - 1 > max)
+        return max;
+    return metrics_histogram_lower(i + 1) - 1;
+}
+
+const char *
+metrics_stage_name(enum metrics_stage stage)
+{
+    return metrics_stage_names[stage];
+}
+
+void
+metrics_write_stages(FILE *f)
+{
+    metrics_histogram_t *histogram;
+    uint64_t count;
+    int i;
+
+    fprintf(f, "%-10s %12s %10s %10s %10s %10s %10s\n",
+            "stage", "count", "avg(us)", "p50(us)", "p90(us)", "p99(us)", "max(us)");
+    for (i = 0; i < METRICS_STAGE_COUNT; i++) {
+        histogram = &metrics.stage[i];
+        count = metrics_histogram_count(histogram);
+        fprintf(f, "%-10s %12lu %10.2f %10.2f %10.2f %10.2f %10.2f\n",
+                metrics_stage_names[i], (unsigned long) count,
+                count ? atomic_load(&histogram->sum) / 1000.0 / count : 0,
+                metrics_histogram_percentile(histogram, 50) / 1000.0,
+                metrics_histogram_percentile(histogram, 90) / 1000.0,
+                metrics_histogram_percentile(histogram, 99) / 1000.0,
+                atomic_load(&histogram->max) / 1000.0);
+    }
+}
+
+int
+metrics_write_report()
+{
+    FILE *f;
+    int fd;
+
+    if (metrics.reportfd < 0) {
+        // Report file couldn't be opened
+        if (metrics.interface)
+            return 1;
+        metrics_write_stages(stderr);
+        fflush(stderr);
+        return 0;
+    }
+
+    // Replace previous report, the file is kept open since it was created
+    if (ftruncate(metrics.reportfd, 0) != 0 || lseek(metrics.reportfd, 0, SEEK_SET) != 0)
+        return 1;
+    if ((fd = dup(metrics.reportfd)) < 0)
+        return 1;
+    if (!(f = fdopen(fd, "w"))) {
+        close(fd);
+        return 1;
+    }
+    metrics_write_stages(f);
+    metrics.reported = true;
+    return (fclose(f) == 0) ? 0 : 1;
+}
+
+void
+metrics_lock_wait(uint64_t ns)
+{
+    metrics_histogram_observe(&metrics.lock_wait, ns);
+}
+
+void
+metrics_source_captured(metrics_source_t *source, uint32_t bytes)
+{
+    atomic_fetch_add_explicit(&source->captured, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&source->bytes, bytes, memory_order_relaxed);
+}
+
+void
+metrics_source_drops(metrics_source_t *source, unsigned int kernel, unsigned int interface)
+{
+    atomic_store_explicit(&source->kernel_drops, kernel, memory_order_relaxed);
+    atomic_store_explicit(&source->interface_drops, interface, memory_order_relaxed);
+    atomic_store_explicit(&source->drops, true, memory_order_relaxed);
+}
+
+void
+metrics_source_parsed(metrics_source_t *source)
+{
+    atomic_fetch_add_explicit(&source->parsed, 1, memory_order_relaxed);
+}
+
+void
+metrics_sip_msg(int reqresp)
+{
+    if (reqresp >= 100) {
+        if (reqresp / 100 < METRICS_SIP_RESPONSES)
+            atomic_fetch_add_explicit(&metrics.sip_responses[reqresp / 100], 1, memory_order_relaxed);
+    } else if (reqresp > 0 && reqresp < METRICS_SIP_METHODS) {
+        atomic_fetch_add_explicit(&metrics.sip_methods[reqresp], 1, memory_order_relaxed);
+    }
+}
+
+void
+metrics_packet(int type)
+{
+    if (type == PACKET_RTP) {
+        atomic_fetch_add_explicit(&metrics.rtp_packets, 1, memory_order_relaxed);
+    } else if (type >= 0) {
+        atomic_fetch_add_explicit(&metrics.sip_packets, 1, memory_order_relaxed);
+    } else {
+        atomic_fetch_add_explicit(&metrics.ignored_packets, 1, memory_order_relaxed);
+    }
+}
+
+void
+metrics_rtp_stream()
+{
+    atomic_fetch_add_explicit(&metrics.rtp_streams, 1, memory_order_relaxed);
+}
+
+void
+metrics_set_calls(int dialogs, int active)
+{
+    atomic_store_explicit(&metrics.dialogs, dialogs, memory_order_relaxed);
+    atomic_store_explicit(&metrics.active_calls, active, memory_order_relaxed);
+}
+
+void
+metrics_memory_add(enum metrics_memory subsystem, long bytes)
+{
+    atomic_fetch_add_explicit(&metrics.memory[subsystem], bytes, memory_order_relaxed);
+}
+
+void
+metrics_write(FILE *f)
+{
+    capture_info_t *capinfo;
+    capture_dump_stats_t dump;
+    event_stats_t events;
+    vector_iter_t it;
+    const char *name;
+    char labels[64];
+    int i;
+
+    // Capture sources counters
+    fputs("# HELP sngrep_packets_captured_total Frames received by each capture source\n"
+          "# TYPE sngrep_packets_captured_total counter\n", f);
+    it = capture_sources_iterator();
+    while ((capinfo = vector_iterator_next(&it))) {
+        fputs("sngrep_packets_captured_total{source=", f);
+        metrics_write_label(f, capture_source_name(capinfo));
+        fprintf(f, "} %lu\n", atomic_load(&capinfo->metrics.captured));
+    }
+
+    fputs("# HELP sngrep_bytes_captured_total Bytes received by each capture source\n"
+          "# TYPE sngrep_bytes_captured_total counter\n", f);
+    it = capture_sources_iterator();
+    while ((capinfo = vector_iterator_next(&it))) {
+        fputs("sngrep_bytes_captured_total{source=", f);
+        metrics_write_label(f, capture_source_name(capinfo));
+        fprintf(f, "} %lu\n", atomic_load(&capinfo->metrics.bytes));
+    }
+
+    fputs("# HELP sngrep_packets_parsed_total UDP/TCP packets of each capture source queued to be parsed\n"
+          "# TYPE sngrep_packets_parsed_total counter\n", f);
+    it = capture_sources_iterator();
+    while ((capinfo = vector_iterator_next(&it))) {
+        fputs("sngrep_packets_parsed_total{source=", f);
+        metrics_write_label(f, capture_source_name(capinfo));
+        fprintf(f, "} %lu\n", atomic_load(&capinfo->metrics.parsed));
+    }
+
+    fputs("# HELP sngrep_packets_dropped_total Frames dropped by the kernel or the interface\n"
+          "# TYPE sngrep_packets_dropped_total counter\n", f);
+    it = capture_sources_iterator();
+    while ((capinfo = vector_iterator_next(&it))) {
+        // Only live pcap captures have drop statistics
+        if (!atomic_load_explicit(&capinfo->metrics.drops, memory_order_relaxed))
+            continue;
+        fputs("sngrep_packets_dropped_total{source=", f);
+        metrics_write_label(f, capture_source_name(capinfo));
+        fprintf(f, ",reason=\"kernel\"} %u\n",
+                atomic_load_explicit(&capinfo->metrics.kernel_drops, memory_order_relaxed));
+        fputs("sngrep_packets_dropped_total{source=", f);
+        metrics_write_label(f, capture_source_name(capinfo));
+        fprintf(f, ",reason=\"interface\"} %u\n",
+                atomic_load_explicit(&capinfo->metrics.interface_drops, memory_order_relaxed));
+    }
+
+    fputs("# HELP sngrep_reasm_pending Packets pending reassembly in each capture source\n"
+          "# TYPE sngrep_reasm_pending gauge\n", f);
+    it = capture_sources_iterator();
+    while ((capinfo = vector_iterator_next(&it))) {
+        fputs("sngrep_reasm_pending{source=", f);
+        metrics_write_label(f, capture_source_name(capinfo));
+        fprintf(f, ",proto=\"ip\"} %u\n", atomic_load(&capinfo->metrics.ip_reasm));
+        fputs("sngrep_reasm_pending{source=", f);
+        metrics_write_label(f, capture_source_name(capinfo));
+        fprintf(f, ",proto=\"tcp\"} %u\n", atomic_load(&capinfo->metrics.tcp_reasm));
+    }
+
+    fprintf(f, "# HELP sngrep_capture_pending Packets waiting for the capture lock to be parsed\n"
+               "# TYPE sngrep_capture_pending gauge\n"
+               "sngrep_capture_pending %d\n", capture_pending_count());
+
+    // Parser counters
+    fprintf(f, "# HELP sngrep_packets_handled_total Packets handled by SIP and RTP parsers\n"
+               "# TYPE sngrep_packets_handled_total counter\n"
+               "sngrep_packets_handled_total{type=\"sip\"} %lu\n"
+               "sngrep_packets_handled_total{type=\"rtp\"} %lu\n"
+               "sngrep_packets_handled_total{type=\"ignored\"} %lu\n",
+            atomic_load(&metrics.sip_packets), atomic_load(&metrics.rtp_packets),
+            atomic_load(&metrics.ignored_packets));
+
+    fputs("# HELP sngrep_sip_requests_total SIP requests by method\n"
+          "# TYPE sngrep_sip_requests_total counter\n", f);
+    for (i = 1; i < METRICS_SIP_METHODS; i++) {
+        if (!(name = sip_method_str(i)))
+            continue;
+        fprintf(f, "sngrep_sip_requests_total{method=\"%s\"} %lu\n", name,
+                atomic_load(&metrics.sip_methods[i]));
+    }
+
+    fputs("# HELP sngrep_sip_responses_total SIP responses by class\n"
+          "# TYPE sngrep_sip_responses_total counter\n", f);
+    for (i = 1; i < METRICS_SIP_RESPONSES; i++) {
+        fprintf(f, "sngrep_sip_responses_total{class=\"%dxx\"} %lu\n", i,
+                atomic_load(&metrics.sip_responses[i]));
+    }
+
+    fprintf(f, "# HELP sngrep_dialogs Stored dialogs\n"
+               "# TYPE sngrep_dialogs gauge\n"
+               "sngrep_dialogs %ld\n"
+               "# HELP sngrep_active_calls Calls in setup or in conversation\n"
+               "# TYPE sngrep_active_calls gauge\n"
+               "sngrep_active_calls %ld\n"
+               "# HELP sngrep_rtp_streams_total Detected RTP streams\n"
+               "# TYPE sngrep_rtp_streams_total counter\n"
+               "sngrep_rtp_streams_total %lu\n",
+            atomic_load(&metrics.dialogs), atomic_load(&metrics.active_calls),
+            atomic_load(&metrics.rtp_streams));
+
+    // Output queues
+    capture_dump_stats(&dump);
+    event_stream_stats(&events);
+    fprintf(f, "# HELP sngrep_queue_pending Items pending to be written by output threads\n"
+               "# TYPE sngrep_queue_pending gauge\n"
+               "sngrep_queue_pending{queue=\"dump\"} %lu\n"
+               "sngrep_queue_pending{queue=\"events\"} %llu\n"
+               "# HELP sngrep_queue_dropped_total Items dropped because output queue was full\n"
+               "# TYPE sngrep_queue_dropped_total counter\n"
+               "sngrep_queue_dropped_total{queue=\"dump\"} %lu\n"
+               "sngrep_queue_dropped_total{queue=\"events\"} %llu\n",
+            dump.pending, (unsigned long long) (events.queued - events.written - events.dropped),
+            dump.dropped, (unsigned long long) events.dropped);
+
+    // Memory usage
+    fputs("# HELP sngrep_memory_bytes Memory used by each subsystem\n"
+          "# TYPE sngrep_memory_bytes gauge\n", f);
+    for (i = 0; i < METRICS_MEM_COUNT; i++) {
+        fprintf(f, "sngrep_memory_bytes{subsystem=\"%s\"} %ld\n", metrics_memory_names[i],
+                atomic_load(&metrics.memory[i]));
+    }
+
+    fputs("# HELP sngrep_capture_lock_wait_seconds Time waiting for the capture lock\n"
+          "# TYPE sngrep_capture_lock_wait_seconds histogram\n", f);
+    metrics_write_histogram(f, "sngrep_capture_lock_wait_seconds", NULL, &metrics.lock_wait);
+
+    // Pipeline stage timers
+    if (metrics.stages) {
+        fputs("# HELP sngrep_stage_duration_seconds Time spent in each packet pipeline stage\n"
+              "# TYPE sngrep_stage_duration_seconds histogram\n", f);
+        for (i = 0; i < METRICS_STAGE_COUNT; i++) {
+            snprintf(labels, sizeof(labels), "stage=\"%s\"", metrics_stage_names[i]);
+            metrics_write_histogram(f, "sngrep_stage_duration_seconds", labels, &metrics.stage[i]);
+        }
+    }
+}
+
+void
+metrics_write_histogram(FILE *f, const char *name, const char *labels, metrics_histogram_t *histogram)
+{
+    const char *sep = labels ? "," : "";
+    uint64_t bound, total = 0;
+    int i = 0, b;
+
+    if (!labels)
+        labels = "";
+
+    // Exported buckets are powers of four from 1.024us to ~1s
+    for (b = 0; b < METRICS_EXPORT_BUCKETS; b++) {
+        bound = (uint64_t) 1 << (10 + 2 * b);
+        // Prometheus buckets are cumulative
+        for (; i < metrics_histogram_index(bound); i++)
+            total += atomic_load(&histogram->buckets[i]);
+        fprintf(f, "%s_bucket{%s%sle=\"%.9g\"} %llu\n", name, labels, sep, bound / 1e9,
+                (unsigned long long) total);
+    }
+    for (; i < METRICS_HISTOGRAM_SIZE; i++)
+        total += atomic_load(&histogram->buckets[i]);
+    fprintf(f, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, labels, sep, (unsigned long long) total);
+    fprintf(f, "%s_sum%s%s%s %.9f\n", name, *sep ? "{" : "", labels, *sep ? "}" : "",
+            atomic_load(&histogram->sum) / 1e9);
+    fprintf(f, "%s_count%s%s%s %llu\n", name, *sep ? "{" : "", labels, *sep ? "}" : "",
+            (unsigned long long) total);
+}
+
+void
+metrics_write_label(FILE *f, const char *value)
+{
+    fputc('"', f);
+    for (; value && *value; value++) {
+        if (*value == '\\' || *value == '"') {
+            fputc('\\', f);
+            fputc(*value, f);
+        } else if (*value == '\n') {
+            fputs("\\n", f);
+        } else {
+            fputc(*value, f);
+        }
+    }
+    fputc('"', f);
+}
+
+int
+metrics_write_file(const char *filename)
+{
+    char tmpfile[PATH_MAX];
+    FILE *f;
+
+    if (snprintf(tmpfile, sizeof(tmpfile), "%s.tmp", filename) >= (int) sizeof(tmpfile))
+        return 1;
+
+    if (!(f = fopen(tmpfile, "w")))
+        return 1;
+
+    metrics_write(f);
+
+    if (fclose(f) != 0 || rename(tmpfile, filename) != 0) {
+        unlink(tmpfile);
+        return 1;
+    }
+
+    return 0;
+}
+
+int
+metrics_http_listen(const char *address, int port)
+{
+    struct sockaddr_in addr = { 0 };
+    int sock, reuse = 1;
+
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, address, &addr.sin_addr) != 1)
+        return -1;
+
+    if ((sock = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+        return -1;
+
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    if (bind(sock, (struct sockaddr *) &addr, sizeof(addr)) != 0 || listen(sock, 8) != 0) {
+        close(sock);
+        return -1;
+    }
+
+    return sock;
+}
+
+void
+metrics_http_serve(int sock)
+{
+    char request[METRICS_HTTP_MAXLEN + 1];
+    struct pollfd pfd = { .fd = sock, .events = POLLIN };
+    char header[256];
+    char *body = NULL;
+    size_t bodylen = 0, len = 0;
+    ssize_t rlen;
+    uint64_t deadline, now;
+    FILE *f;
+
+    // Read request headers (give up if the whole request takes too long)
+    deadline = metrics_now() + (uint64_t) METRICS_HTTP_TIMEOUT * 1000000;
+    while (len < METRICS_HTTP_MAXLEN) {
+        if ((now = metrics_now()) >= deadline)
+            return;
+        if (poll(&pfd, 1, (deadline - now) / 1000000 + 1) <= 0)
+            return;
+        if ((rlen = recv(sock, request + len, METRICS_HTTP_MAXLEN - len, 0)) <= 0)
+            return;
+        len += rlen;
+        request[len] = '\0';
+        if (strstr(request, "\r\n\r\n") || strstr(request, "\n\n"))
+            break;
+    }
+    request[len] = '\0';
+
+    if (strncmp(request, "GET ", 4) != 0) {
+        len = snprintf(header, sizeof(header), "HTTP/1.0 405 Method Not Allowed\r\n"
+                       "Allow: GET\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        send(sock, header, len, MSG_NOSIGNAL);
+        return;
+    }
+
+    // Generate metrics
+    if (!(f = open_memstream(&body, &bodylen)))
+        return;
+    metrics_write(f);
+    fclose(f);
+
+    len = snprintf(header, sizeof(header), "HTTP/1.0 200 OK\r\n"
+                   "Content-Type: text/plain; version=0.0.4\r\n"
+                   "Content-Length: %zu\r\nConnection: close\r\n\r\n", bodylen);
+    if (send(sock, header, len, MSG_NOSIGNAL) == (ssize_t) len)
+        send(sock, body, bodylen, MSG_NOSIGNAL);
+    free(body);
+}
@@ -0,0 +1,420 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file metrics.h
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Functions to export sngrep internal metrics
+ *
+ * Counters are updated with relaxed atomic operations. Each capture
+ * source has its own counters, only modified by its capture thread, and
+ * SIP counters are only modified while holding the capture lock, so
+ * updating them never waits for other threads.
+ *
+ * Metrics are exported in Prometheus text format, periodically written
+ * to a file (for node_exporter textfile collector) and optionally
+ * served through a local HTTP endpoint.
+ *
+ * Optional stage timers measure the time spent in each step of the
+ * packet pipeline. They are disabled by default, so the only overhead
+ * of a disabled timer is a flag check.
+ */
+#ifndef __SNGREP_METRICS_H
+#define __SNGREP_METRICS_H
+
+#include "config.h"
+#include <stdio.h>
+#include <limits.h>
+#include <stdint.h>
+#include <time.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+//! Bits of precision of each histogram power of two (8 sub-buckets)
+#define METRICS_HISTOGRAM_SUBBITS 3
+#define METRICS_HISTOGRAM_SUB (1 << METRICS_HISTOGRAM_SUBBITS)
+//! Number of histogram buckets to cover all 64 bits values
+#define METRICS_HISTOGRAM_SIZE ((64 - METRICS_HISTOGRAM_SUBBITS + 1) * METRICS_HISTOGRAM_SUB)
+//! Number of exported histogram buckets (without +Inf)
+#define METRICS_EXPORT_BUCKETS 11
+//! Max number of SIP methods and response classes counters
+#define METRICS_SIP_METHODS 16
+#define METRICS_SIP_RESPONSES 9
+//! Max size of a HTTP request
+#define METRICS_HTTP_MAXLEN 4096
+//! Max time (ms) to receive a HTTP request
+#define METRICS_HTTP_TIMEOUT 1000
+
+//! Shorter declaration of metrics structure
+typedef struct metrics metrics_t;
+//! Shorter declaration of metrics_source structure
+typedef struct metrics_source metrics_source_t;
+//! Shorter declaration of metrics_histogram structure
+typedef struct metrics_histogram metrics_histogram_t;
+
+//! Timed stages of the packet pipeline
+enum metrics_stage {
+    METRICS_STAGE_REASM_IP = 0,
+    METRICS_STAGE_REASM_TCP,
+    METRICS_STAGE_TLS,
+    METRICS_STAGE_SIP,
+    METRICS_STAGE_RTP,
+    METRICS_STAGE_DUMP,
+    METRICS_STAGE_EEP,
+    METRICS_STAGE_COUNT
+};
+
+//! Subsystems with tracked memory usage
+enum metrics_memory {
+    //! Captured packet frames and payloads
+    METRICS_MEM_PACKETS = 0,
+    //! Dump file writer buffer and pending records
+    METRICS_MEM_DUMP,
+    //! Event stream pending events
+    METRICS_MEM_EVENTS,
+    METRICS_MEM_COUNT
+};
+
+/**
+ * @brief Time histogram with log-linear buckets
+ *
+ * Like HDR histograms, each power of two is split in METRICS_HISTOGRAM_SUB
+ * linear buckets, so any value is recorded with a relative error lower
+ * than 12.5% with a fixed number of counters.
+ */
+struct metrics_histogram {
+    //! Observations of each bucket (not cumulative)
+    atomic_ulong buckets[METRICS_HISTOGRAM_SIZE];
+    //! Sum of all observations in nanoseconds
+    atomic_ulong sum;
+    //! Max observed value in nanoseconds
+    atomic_ulong max;
+};
+
+/**
+ * @brief Counters of a capture source
+ *
+ * Only modified by the capture thread of the source
+ */
+struct metrics_source {
+    //! Frames received by the source
+    atomic_ulong captured;
+    //! Bytes received by the source
+    atomic_ulong bytes;
+    //! Packets with valid headers queued to be parsed
+    atomic_ulong parsed;
+    //! Packets pending IP reassembly
+    atomic_uint ip_reasm;
+    //! Packets pending TCP reassembly
+    atomic_uint tcp_reasm;
+    //! Drop statistics are available (live pcap captures)
+    atomic_bool drops;
+    //! Frames dropped by the kernel
+    atomic_uint kernel_drops;
+    //! Frames dropped by the interface
+    atomic_uint interface_drops;
+    //! Capture time of last drop statistics update
+    time_t drops_time;
+};
+
+/**
+ * @brief Global metrics and exporter data
+ */
+struct metrics {
+    //! Parsed SIP requests by method (@see sip_methods)
+    atomic_ulong sip_methods[METRICS_SIP_METHODS];
+    //! Parsed SIP responses by class (1xx to 8xx)
+    atomic_ulong sip_responses[METRICS_SIP_RESPONSES];
+    //! Packets parsed as SIP messages
+    atomic_ulong sip_packets;
+    //! Packets parsed as RTP
+    atomic_ulong rtp_packets;
+    //! Packets not belonging to any dialog or stream
+    atomic_ulong ignored_packets;
+    //! Number of created RTP streams
+    atomic_ulong rtp_streams;
+    //! Number of stored dialogs
+    atomic_long dialogs;
+    //! Number of calls in setup or in call state
+    atomic_long active_calls;
+    //! Memory used by each subsystem (@see metrics_memory)
+    atomic_long memory[METRICS_MEM_COUNT];
+    //! Time waiting for the capture lock
+    metrics_histogram_t lock_wait;
+    //! Stage timers are enabled
+    bool stages;
+    //! Time spent in each pipeline stage (@see metrics_stage)
+    metrics_histogram_t stage[METRICS_STAGE_COUNT];
+    //! Exporter textfile path (empty to disable)
+    const char *filename;
+    //! Stage timers report file name (empty when written to standard error)
+    char report[PATH_MAX];
+    //! ncurses interface is using the terminal, don't write the report there
+    bool interface;
+    //! Stage timers report file descriptor (-1 if not opened)
+    int reportfd;
+    //! Report file has been created in the temporary directory
+    bool reporttmp;
+    //! Report file has been written
+    bool reported;
+    //! Seconds between textfile writes
+    int interval;
+    //! HTTP endpoint listening socket (-1 if disabled)
+    int sock;
+    //! Exporter thread
+    pthread_t thread;
+    //! Exporter thread is running
+    atomic_bool running;
+};
+
+//! Global metrics
+extern metrics_t metrics;
+
+/**
+ * @brief Start metrics exporter thread if enabled in settings
+ *
+ * The exporter thread also writes the stage timers report when SIGUSR2
+ * is received. The report is written to standard error unless the
+ * ncurses interface is using the terminal, then it is written to a file
+ * next to the metrics textfile or to a new file with a random name in the
+ * temporary directory. The file is opened here, without following links,
+ * and its name is displayed in the pipeline timers panel.
+ *
+ * @param interface ncurses interface is using the terminal
+ * @return 0 if exporter is running or disabled, 1 on error
+ */
+int
+metrics_init(bool interface);
+
+/**
+ * @brief Stop metrics exporter thread
+ *
+ * The textfile is written one last time before stopping.
+ */
+void
+metrics_deinit();
+
+/**
+ * @brief Exporter thread main function
+ */
+void *
+metrics_run(void *data);
+
+/**
+ * @brief Current monotonic time in nanoseconds
+ */
+uint64_t
+metrics_now();
+
+/**
+ * @brief Add an observation to a time histogram
+ *
+ * @param ns observed time in nanoseconds
+ */
+void
+metrics_histogram_observe(metrics_histogram_t *histogram, uint64_t ns);
+
+/**
+ * @brief Get the histogram bucket of a value
+ */
+int
+metrics_histogram_index(uint64_t value);
+
+/**
+ * @brief Get the lowest value of a histogram bucket
+ */
+uint64_t
+metrics_histogram_lower(int index);
+
+/**
+ * @brief Get the number of observations of a histogram
+ */
+uint64_t
+metrics_histogram_count(metrics_histogram_t *histogram);
+
+/**
+ * @brief Get the value below which the given percent of observations fall
+ *
+ * @param percent Percentile (0 to 100)
+ * @return highest value of the percentile bucket in nanoseconds
+ */
+uint64_t
+metrics_histogram_percentile(metrics_histogram_t *histogram, double percent);
+
+/**
+ * @brief Start timing a pipeline stage
+ *
+ * Stage timers are inlined in the packet path, so disabled timers only
+ * cost a flag check.
+ *
+ * @return current time or 0 if stage timers are disabled
+ */
+static inline uint64_t
+metrics_stage_start()
+{
+    return metrics.stages ? metrics_now() : 0;
+}
+
+/**
+ * @brief Add the time spent in a pipeline stage
+ *
+ * @param start Value returned by metrics_stage_start
+ */
+static inline void
+metrics_stage_end(enum metrics_stage stage, uint64_t start)
+{
+    if (start)
+        metrics_histogram_observe(&metrics.stage[stage], metrics_now() - start);
+}
+
+/**
+ * @brief Get the name of a pipeline stage
+ */
+const char *
+metrics_stage_name(enum metrics_stage stage);
+
+/**
+ * @brief Write stage timers as a text table
+ */
+void
+metrics_write_stages(FILE *f);
+
+/**
+ * @brief Write stage timers report requested through SIGUSR2
+ *
+ * @return 0 if report has been written, 1 otherwise
+ */
+int
+metrics_write_report();
+
+/**
+ * @brief Add a time waiting for the capture lock
+ */
+void
+metrics_lock_wait(uint64_t ns);
+
+/**
+ * @brief Count a frame received by a capture source
+ *
+ * @param bytes Frame captured length
+ */
+void
+metrics_source_captured(metrics_source_t *source, uint32_t bytes);
+
+/**
+ * @brief Update drop statistics of a live capture source
+ *
+ * Statistics are read by the capture thread, as the pcap handle can not
+ * be used from other threads.
+ */
+void
+metrics_source_drops(metrics_source_t *source, unsigned int kernel, unsigned int interface);
+
+/**
+ * @brief Count a packet of a capture source queued to be parsed
+ */
+void
+metrics_source_parsed(metrics_source_t *source);
+
+/**
+ * @brief Count a parsed SIP message
+ *
+ * @param reqresp Request method or response code of the message
+ */
+void
+metrics_sip_msg(int reqresp);
+
+/**
+ * @brief Count a packet handled by the SIP/RTP parsers
+ *
+ * @param type Packet type (@see packet_type) or -1 if it was ignored
+ */
+void
+metrics_packet(int type);
+
+/**
+ * @brief Count a new RTP stream
+ */
+void
+metrics_rtp_stream();
+
+/**
+ * @brief Update dialog gauges
+ */
+void
+metrics_set_calls(int dialogs, int active);
+
+/**
+ * @brief Add (or remove with negative values) used memory of a subsystem
+ */
+void
+metrics_memory_add(enum metrics_memory subsystem, long bytes);
+
+/**
+ * @brief Write all metrics in Prometheus text format
+ */
+void
+metrics_write(FILE *f);
+
+/**
+ * @brief Write histogram metric lines
+ *
+ * @param labels Extra labels of each line (NULL for none)
+ */
+void
+metrics_write_histogram(FILE *f, const char *name, const char *labels, metrics_histogram_t *histogram);
+
+/**
+ * @brief Write a quoted label value escaping special characters
+ */
+void
+metrics_write_label(FILE *f, const char *value);
+
+/**
+ * @brief Write metrics to the textfile
+ *
+ * Metrics are written to a temporary file and renamed, so readers never
+ * get an incomplete file.
+ *
+ * @return 0 if file has been written, 1 otherwise
+ */
+int
+metrics_write_file(const char *filename);
+
+/**
+ * @brief Open HTTP endpoint listening socket
+ *
+ * @return socket descriptor or -1 on error
+ */
+int
+metrics_http_listen(const char *address, int port);
+
+/**
+ * @brief Reply a HTTP request with current metrics
+ *
+ * @param sock Connected client socket
+ */
+void
+metrics_http_serve(int sock);
+
+#endif /* __SNGREP_METRICS_H */
@@ -30,6 +30,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "packet.h"
+#include "metrics.h"
 
 packet_t *
 packet_create(uint8_t ip_ver, uint8_t proto, address_t src, address_t dst, uint32_t id)
@@ -60,8 +61,13 @@ packet_clone(packet_t *packet)
 
     // Append this frames to the original packet
     vector_iter_t frames = vector_iterator(packet->frames);
-    while ((frame = vector_iterator_next(&frames)))
-        packet_add_frame(clone, frame->header, frame->data);
+    while ((frame = vector_iterator_next(&frames))) {
+        if (frame->synthetic) {
+            packet_add_synthetic_frame(clone, frame->header);
+        } else {
+            packet_add_frame(clone, frame->header, frame->data);
+        }
+    }
 
     return clone;
 }
@@ -77,6 +83,8 @@ packet_destroy(packet_t *packet)
     // Destroy frames
     vector_iter_t it = vector_iterator(packet->frames);
     while ((frame = vector_iterator_next(&it))) {
+        if (frame->data)
+            metrics_memory_add(METRICS_MEM_PACKETS, -(long) frame->header->caplen);
         free(frame->header);
         free(frame->data);
     }
@@ -84,6 +92,8 @@ packet_destroy(packet_t *packet)
     // TODO Free remaining packet data
     vector_set_destroyer(packet->frames, vector_generic_destroyer);
     vector_destroy(packet->frames);
+    if (packet->payload)
+        metrics_memory_add(METRICS_MEM_PACKETS, -(long) (packet->payload_len + 1));
     free(packet->payload);
     free(packet);
 }
@@ -101,6 +111,8 @@ packet_free_frames(packet_t *pkt)
     vector_iter_t it = vector_iterator(pkt->frames);
 
     while ((frame = vector_iterator_next(&it))) {
+        if (frame->data)
+            metrics_memory_add(METRICS_MEM_PACKETS, -(long) frame->header->caplen);
         free(frame->data);
         frame->data = NULL;
     }
@@ -122,6 +134,20 @@ packet_add_frame(packet_t *pkt, const struct pcap_pkthdr *header, const u_char *
     memcpy(frame->header, header, sizeof(struct pcap_pkthdr));
     frame->data = malloc(header->caplen);
     memcpy(frame->data, packet, header->caplen);
+    metrics_memory_add(METRICS_MEM_PACKETS, header->caplen);
+    frame->synthetic = false;
+    vector_append(pkt->frames, frame);
+    return frame;
+}
+
+frame_t *
+packet_add_synthetic_frame(packet_t *pkt, const struct pcap_pkthdr *header)
+{
+    frame_t *frame = malloc(sizeof(frame_t));
+    frame->header = malloc(sizeof(struct pcap_pkthdr));
+    memcpy(frame->header, header, sizeof(struct pcap_pkthdr));
+    frame->data = NULL;
+    frame->synthetic = true;
     vector_append(pkt->frames, frame);
     return frame;
 }
@@ -136,8 +162,11 @@ void
 packet_set_payload(packet_t *packet, u_char *payload, uint32_t payload_len)
 {
     // Free previous payload
-    if (packet->payload)
+    if (packet->payload) {
+        metrics_memory_add(METRICS_MEM_PACKETS, -(long) (packet->payload_len + 1));
         free(packet->payload);
+        packet->payload = NULL;
+    }
     packet->payload_len = 0;
 
     // Set new payload
@@ -147,6 +176,7 @@ packet_set_payload(packet_t *packet, u_char *payload, uint32_t payload_len)
         memcpy(packet->payload, payload, payload_len);
         packet->payload[payload_len] = '\0';
         packet->payload_len = payload_len;
+        metrics_memory_add(METRICS_MEM_PACKETS, payload_len + 1);
     }
 }
 
@@ -37,6 +37,7 @@
 #define __SNGREP_CAPTURE_PACKET_H
 
 #include <time.h>
+#include <stdbool.h>
 #include <sys/types.h>
 #include <pcap.h>
 #include "address.h"
@@ -107,6 +108,8 @@ struct frame {
     struct pcap_pkthdr *header;
     //! PCAP Frame content
     u_char *data;
+    //! Frame content is not captured, it's generated from packet data when stored
+    bool synthetic;
 };
 
 /**
@@ -133,6 +136,15 @@ packet_set_transport_data(packet_t *pkt, uint16_t sport, uint16_t dport);
 frame_t *
 packet_add_frame(packet_t *pkt, const struct pcap_pkthdr *header, const u_char *packet);
 
+/**
+ * @brief Add a new frame without contents to the given packet
+ *
+ * Used for packets that have not been captured from the wire, where the
+ * frame contents can be generated from packet data if required.
+ */
+frame_t *
+packet_add_synthetic_frame(packet_t *pkt, const struct pcap_pkthdr *header);
+
 /**
  * @brief Deallocate a packet structure memory
  */
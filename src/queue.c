@@ -0,0 +1,145 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file queue.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Source code of functions defined in queue.h
+ *
+ * Each slot is swapped atomically both when pushing and popping, so an
+ * item is either taken by the consumer or replaced by the producer, but
+ * never both. This is what makes the drop-oldest policy safe without
+ * any lock between both threads.
+ */
+#include "queue.h"
+#include <stdlib.h>
+
+queue_t *
+queue_create(size_t size)
+{
+    queue_t *q;
+    size_t i, slots = 1;
+
+    // Round size to next power of 2
+    while (slots < size)
+        slots <<= 1;
+
+    // Allocate memory for this queue data
+    if (!(q = malloc(sizeof(queue_t))))
+        return NULL;
+
+    if (!(q->list = malloc(sizeof(*q->list) * slots))) {
+        free(q);
+        return NULL;
+    }
+
+    for (i = 0; i < slots; i++)
+        atomic_init(&q->list[i], NULL);
+
+    q->size = slots;
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    q->destroyer = NULL;
+
+    return q;
+}
+
+void
+queue_destroy(queue_t *queue)
+{
+    void *item;
+
+    // Nothing to free. Done.
+    if (!queue) return;
+
+    // Remove all pending items if a destroyer is set
+    while ((item = queue_pop(queue))) {
+        if (queue->destroyer)
+            queue->destroyer(item);
+    }
+
+    free(queue->list);
+    free(queue);
+}
+
+void
+queue_set_destroyer(queue_t *queue, void (*destroyer) (void *item))
+{
+    queue->destroyer = destroyer;
+}
+
+void *
+queue_push(queue_t *queue, void *item)
+{
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    void *dropped;
+
+    // Store the item, taking whatever was still pending in that slot
+    dropped = atomic_exchange_explicit(&queue->list[tail & (queue->size - 1)],
+                                       item, memory_order_acq_rel);
+
+    // Make the item visible to the consumer
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+
+    return dropped;
+}
+
+void *
+queue_pop(queue_t *queue)
+{
+    size_t head, tail;
+    void *item;
+
+    head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+
+    while (1) {
+        tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+
+        // Queue is empty
+        if (head == tail)
+            return NULL;
+
+        // Producer has overwritten older positions, skip them
+        if (tail - head > queue->size)
+            head = tail - queue->size;
+
+        item = atomic_exchange_explicit(&queue->list[head & (queue->size - 1)],
+                                        NULL, memory_order_acq_rel);
+        head++;
+        atomic_store_explicit(&queue->head, head, memory_order_release);
+
+        // Slot was already dropped by the producer, try next one
+        if (item)
+            return item;
+    }
+}
+
+size_t
+queue_count(queue_t *queue)
+{
+    size_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+
+    if (tail - head > queue->size)
+        return queue->size;
+    return tail - head;
+}
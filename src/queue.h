@@ -0,0 +1,117 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file queue.h
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * @brief Functions to manage bounded queues of pointers
+ *
+ * Queues are fixed size rings used to pass items from one producer
+ * thread to one consumer thread without locking. When the queue is
+ * full the oldest item is replaced, so the producer never waits for
+ * the consumer.
+ *
+ * Only one thread can push and only one thread can pop at the same
+ * time. Multiple producers must serialize the push calls (for example,
+ * capture threads already do it holding the capture lock).
+ */
+
+#ifndef __SNGREP_QUEUE_H_
+#define __SNGREP_QUEUE_H_
+
+#include "config.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+//! Shorter declaration of queue structure
+typedef struct queue queue_t;
+
+/**
+ * @brief Structure to hold a bounded ring of pointers
+ */
+struct queue {
+    //! Number of slots in the ring (power of 2)
+    size_t size;
+    //! Ring slots
+    _Atomic(void *) *list;
+    //! Next position to be read (only modified by consumer)
+    atomic_size_t head;
+    //! Next position to be written (only modified by producer)
+    atomic_size_t tail;
+    //! Function to destroy one item
+    void (*destroyer) (void *item);
+};
+
+/**
+ * @brief Create a new queue
+ *
+ * Requested size will be rounded up to the next power of 2
+ *
+ * @param size Minimum number of items the queue can hold
+ * @return new queue pointer or NULL on allocation failure
+ */
+queue_t *
+queue_create(size_t size);
+
+/**
+ * @brief Free all queue memory
+ *
+ * Pending items will be destroyed if the queue has a destroyer
+ */
+void
+queue_destroy(queue_t *queue);
+
+/**
+ * @brief Set the function to destroy pending items on queue destroy
+ */
+void
+queue_set_destroyer(queue_t *queue, void (*destroyer) (void *item));
+
+/**
+ * @brief Add a new item at the end of the queue
+ *
+ * If the queue is full, the oldest pending item is removed from
+ * the queue and returned, so the caller can free or reuse it.
+ *
+ * @return NULL if no item has been dropped, dropped item otherwise
+ */
+void *
+queue_push(queue_t *queue, void *item);
+
+/**
+ * @brief Get the oldest pending item of the queue
+ *
+ * @return NULL if queue is empty, first pending item otherwise
+ */
+void *
+queue_pop(queue_t *queue);
+
+/**
+ * @brief Number of pending items in the queue
+ *
+ * This is only an approximation when other thread is using the queue
+ */
+size_t
+queue_count(queue_t *queue);
+
+#endif /* __SNGREP_QUEUE_H_ */
@@ -36,78 +36,122 @@
 
 //! Available configurable settings
 setting_t settings[SETTING_COUNT] = {
-    { SETTING_BACKGROUND,         "background",         SETTING_FMT_ENUM,    "dark",      SETTING_ENUM_BACKGROUND },
-    { SETTING_COLORMODE,          "colormode",          SETTING_FMT_ENUM,    "request",   SETTING_ENUM_COLORMODE },
-    { SETTING_SYNTAX,             "syntax",             SETTING_FMT_ENUM,    SETTING_ON,  SETTING_ENUM_ONOFF },
-    { SETTING_SYNTAX_TAG,         "syntax.tag",         SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF },
-    { SETTING_SYNTAX_BRANCH,      "syntax.branch",      SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF },
-    { SETTING_ALTKEY_HINT,        "hintkeyalt",         SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF },
-    { SETTING_EXITPROMPT,         "exitprompt",         SETTING_FMT_ENUM,    SETTING_ON,  SETTING_ENUM_ONOFF },
-    { SETTING_CAPTURE_LIMIT,      "capture.limit",      SETTING_FMT_NUMBER,  "20000",     NULL },
-    { SETTING_CAPTURE_DEVICE,     "capture.device",     SETTING_FMT_STRING,  "any",       NULL },
-    { SETTING_CAPTURE_OUTFILE,    "capture.outfile",    SETTING_FMT_STRING,  "",          NULL },
-    { SETTING_CAPTURE_BUFFER,     "capture.buffer",     SETTING_FMT_NUMBER,  "2",         NULL },
+    { SETTING_BACKGROUND,         "background",         SETTING_FMT_ENUM,    "dark",      SETTING_ENUM_BACKGROUND, { 0 } },
+    { SETTING_COLORMODE,          "colormode",          SETTING_FMT_ENUM,    "request",   SETTING_ENUM_COLORMODE, { 0 } },
+    { SETTING_SYNTAX,             "syntax",             SETTING_FMT_ENUM,    SETTING_ON,  SETTING_ENUM_ONOFF, { 0 } },
+    { SETTING_SYNTAX_TAG,         "syntax.tag",         SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF, { 0 } },
+    { SETTING_SYNTAX_BRANCH,      "syntax.branch",      SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF, { 0 } },
+    { SETTING_ALTKEY_HINT,        "hintkeyalt",         SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF, { 0 } },
+    { SETTING_EXITPROMPT,         "exitprompt",         SETTING_FMT_ENUM,    SETTING_ON,  SETTING_ENUM_ONOFF, { 0 } },
+    { SETTING_MAXFPS,             "maxfps",             SETTING_FMT_NUMBER,  "5",         NULL, { 0 } },
+    { SETTING_CAPTURE_LIMIT,      "capture.limit",      SETTING_FMT_NUMBER,  "20000",     NULL, { 0 } },
+    { SETTING_CAPTURE_DEVICE,     "capture.device",     SETTING_FMT_STRING,  "any",       NULL, { 0 } },
+    { SETTING_CAPTURE_OUTFILE,    "capture.outfile",    SETTING_FMT_STRING,  "",          NULL, { 0 } },
+    { SETTING_CAPTURE_DUMP_QUEUE, "capture.dump.queue", SETTING_FMT_NUMBER,  "16384",     NULL, { 0 } },
+    { SETTING_CAPTURE_DUMP_DIRECT, "capture.dump.direct", SETTING_FMT_ENUM,  SETTING_OFF, SETTING_ENUM_ONOFF, { 0 } },
+    { SETTING_CAPTURE_DUMP_SYNC,  "capture.dump.sync",  SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_DUMPSYNC, { 0 } },
+    { SETTING_CAPTURE_DUMP_SIZE,  "capture.dump.size",  SETTING_FMT_NUMBER,  "0",         NULL, { 0 } },
+    { SETTING_CAPTURE_DUMP_INTERVAL, "capture.dump.interval", SETTING_FMT_NUMBER, "0",    NULL, { 0 } },
+    { SETTING_CAPTURE_BUFFER,     "capture.buffer",     SETTING_FMT_NUMBER,  "2",         NULL, { 0 } },
 #if defined(WITH_GNUTLS) || defined(WITH_OPENSSL)
-    { SETTING_CAPTURE_KEYFILE,    "capture.keyfile",    SETTING_FMT_STRING,  "",          NULL },
-    { SETTING_CAPTURE_TLSSERVER,  "capture.tlsserver",  SETTING_FMT_STRING,  "",          NULL },
+    { SETTING_CAPTURE_KEYFILE,    "capture.keyfile",    SETTING_FMT_STRING,  "",          NULL, { 0 } },
+    { SETTING_CAPTURE_TLSSERVER,  "capture.tlsserver",  SETTING_FMT_STRING,  "",          NULL, { 0 } },
 #endif
 #ifdef USE_EEP
-    { SETTING_CAPTURE_EEP,        "capture.eep",        SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF },
+    { SETTING_CAPTURE_EEP,        "capture.eep",        SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF, { 0 } },
 #endif
-    { SETTING_CAPTURE_RTP,        "capture.rtp",        SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF },
-    { SETTING_CAPTURE_STORAGE,    "capture.storage",    SETTING_FMT_ENUM,    "memory",    SETTING_ENUM_STORAGE },
-    { SETTING_CAPTURE_ROTATE,     "capture.rotate",     SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF },
-    { SETTING_SIP_NOINCOMPLETE,   "sip.noincomplete",   SETTING_FMT_ENUM,    SETTING_ON,  SETTING_ENUM_ONOFF },
-    { SETTING_SIP_HEADER_X_CID,   "sip.xcid",           SETTING_FMT_STRING,  "X-Call-ID|X-CID", NULL },
-    { SETTING_SIP_CALLS,          "sip.calls",          SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF },
-    { SETTING_SAVEPATH,           "savepath",           SETTING_FMT_STRING,  "",          NULL },
-    { SETTING_DISPLAY_ALIAS,      "displayalias",       SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF },
-    { SETTING_ALIAS_PORT,         "aliasport",          SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF },
-    { SETTING_CL_SCROLLSTEP,      "cl.scrollstep",      SETTING_FMT_NUMBER,  "4",         NULL },
-    { SETTING_CL_COLORATTR,       "cl.colorattr",       SETTING_FMT_ENUM,    SETTING_ON,  SETTING_ENUM_ONOFF },
-    { SETTING_CL_AUTOSCROLL,      "cl.autoscroll",      SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF },
-    { SETTING_CL_SORTFIELD,       "cl.sortfield",       SETTING_FMT_STRING,  "index",     NULL },
-    { SETTING_CL_SORTORDER,       "cl.sortorder",       SETTING_FMT_STRING,  "asc",       NULL },
-    { SETTING_CF_FORCERAW,        "cf.forceraw",        SETTING_FMT_ENUM,    SETTING_ON,  SETTING_ENUM_ONOFF },
-    { SETTING_CF_RAWMINWIDTH,     "cf.rawminwidth",     SETTING_FMT_NUMBER,  "40",        NULL },
-    { SETTING_CF_RAWFIXEDWIDTH,   "cf.rawfixedwidth",   SETTING_FMT_NUMBER,  "",          NULL },
-    { SETTING_CF_SPLITCALLID,     "cf.splitcallid",     SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF },
-    { SETTING_CF_HIGHTLIGHT,      "cf.highlight",       SETTING_FMT_ENUM,    "bold",      SETTING_ENUM_HIGHLIGHT },
-    { SETTING_CF_SCROLLSTEP,      "cf.scrollstep",      SETTING_FMT_NUMBER,  "4",         NULL },
-    { SETTING_CF_LOCALHIGHLIGHT,  "cf.localhighlight",  SETTING_FMT_ENUM,    SETTING_ON,  SETTING_ENUM_ONOFF },
-    { SETTING_CF_SDP_INFO,        "cf.sdpinfo",         SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_SDP_INFO },
-    { SETTING_CF_MEDIA,           "cf.media",           SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_MEDIA },
-    { SETTING_CF_ONLYMEDIA,       "cf.onlymedia",       SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF },
-    { SETTING_CF_DELTA,           "cf.deltatime",       SETTING_FMT_ENUM,    SETTING_ON,  SETTING_ENUM_ONOFF },
-    { SETTING_CR_SCROLLSTEP,      "cr.scrollstep",      SETTING_FMT_NUMBER,  "10",        NULL },
-    { SETTING_CR_NON_ASCII,       "cr.nonascii",        SETTING_FMT_STRING,  ".",        NULL },
-    { SETTING_FILTER_PAYLOAD,     "filter.payload",     SETTING_FMT_STRING,  "",          NULL },
-    { SETTING_FILTER_METHODS,     "filter.methods",     SETTING_FMT_STRING,  "",          NULL },
+    { SETTING_CAPTURE_RTP,        "capture.rtp",        SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF, { 0 } },
+    { SETTING_CAPTURE_STORAGE,    "capture.storage",    SETTING_FMT_ENUM,    "memory",    SETTING_ENUM_STORAGE, { 0 } },
+    { SETTING_CAPTURE_ROTATE,     "capture.rotate",     SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF, { 0 } },
+    { SETTING_SIP_NOINCOMPLETE,   "sip.noincomplete",   SETTING_FMT_ENUM,    SETTING_ON,  SETTING_ENUM_ONOFF, { 0 } },
+    { SETTING_SIP_HEADER_X_CID,   "sip.xcid",           SETTING_FMT_STRING,  "X-Call-ID|X-CID", NULL, { 0 } },
+    { SETTING_SIP_CALLS,          "sip.calls",          SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF, { 0 } },
+    { SETTING_EVENT_QUEUE,        "event.queue",        SETTING_FMT_NUMBER,  "8192",      NULL, { 0 } },
+    { SETTING_CDR_FORMAT,         "cdr.format",         SETTING_FMT_ENUM,    "csv",       SETTING_ENUM_CDRFORMAT, { 0 } },
+    { SETTING_CDR_BATCH,          "cdr.batch",          SETTING_FMT_NUMBER,  "100",       NULL, { 0 } },
+    { SETTING_CDR_RELEASE,        "cdr.release",        SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF, { 0 } },
+    { SETTING_METRICS_FILE,       "metrics.file",       SETTING_FMT_STRING,  "",          NULL, { 0 } },
+    { SETTING_METRICS_INTERVAL,   "metrics.interval",   SETTING_FMT_NUMBER,  "15",        NULL, { 0 } },
+    { SETTING_METRICS_ADDRESS,    "metrics.address",    SETTING_FMT_STRING,  "127.0.0.1", NULL, { 0 } },
+    { SETTING_METRICS_PORT,       "metrics.port",       SETTING_FMT_NUMBER,  "0",         NULL, { 0 } },
+    { SETTING_METRICS_STAGES,     "metrics.stages",     SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF, { 0 } },
+    { SETTING_SAVEPATH,           "savepath",           SETTING_FMT_STRING,  "",          NULL, { 0 } },
+    { SETTING_DISPLAY_ALIAS,      "displayalias",       SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF, { 0 } },
+    { SETTING_ALIAS_PORT,         "aliasport",          SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF, { 0 } },
+    { SETTING_CL_SCROLLSTEP,      "cl.scrollstep",      SETTING_FMT_NUMBER,  "4",         NULL, { 0 } },
+    { SETTING_CL_COLORATTR,       "cl.colorattr",       SETTING_FMT_ENUM,    SETTING_ON,  SETTING_ENUM_ONOFF, { 0 } },
+    { SETTING_CL_AUTOSCROLL,      "cl.autoscroll",      SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF, { 0 } },
+    { SETTING_CL_SORTFIELD,       "cl.sortfield",       SETTING_FMT_STRING,  "index",     NULL, { 0 } },
+    { SETTING_CL_SORTORDER,       "cl.sortorder",       SETTING_FMT_STRING,  "asc",       NULL, { 0 } },
+    { SETTING_CF_FORCERAW,        "cf.forceraw",        SETTING_FMT_ENUM,    SETTING_ON,  SETTING_ENUM_ONOFF, { 0 } },
+    { SETTING_CF_RAWMINWIDTH,     "cf.rawminwidth",     SETTING_FMT_NUMBER,  "40",        NULL, { 0 } },
+    { SETTING_CF_RAWFIXEDWIDTH,   "cf.rawfixedwidth",   SETTING_FMT_NUMBER,  "",          NULL, { 0 } },
+    { SETTING_CF_SPLITCALLID,     "cf.splitcallid",     SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF, { 0 } },
+    { SETTING_CF_HIGHTLIGHT,      "cf.highlight",       SETTING_FMT_ENUM,    "bold",      SETTING_ENUM_HIGHLIGHT, { 0 } },
+    { SETTING_CF_SCROLLSTEP,      "cf.scrollstep",      SETTING_FMT_NUMBER,  "4",         NULL, { 0 } },
+    { SETTING_CF_LOCALHIGHLIGHT,  "cf.localhighlight",  SETTING_FMT_ENUM,    SETTING_ON,  SETTING_ENUM_ONOFF, { 0 } },
+    { SETTING_CF_SDP_INFO,        "cf.sdpinfo",         SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_SDP_INFO, { 0 } },
+    { SETTING_CF_MEDIA,           "cf.media",           SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_MEDIA, { 0 } },
+    { SETTING_CF_ONLYMEDIA,       "cf.onlymedia",       SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF, { 0 } },
+    { SETTING_CF_DELTA,           "cf.deltatime",       SETTING_FMT_ENUM,    SETTING_ON,  SETTING_ENUM_ONOFF, { 0 } },
+    { SETTING_CR_SCROLLSTEP,      "cr.scrollstep",      SETTING_FMT_NUMBER,  "10",        NULL, { 0 } },
+    { SETTING_CR_NON_ASCII,       "cr.nonascii",        SETTING_FMT_STRING,  ".",        NULL, { 0 } },
+    { SETTING_FILTER_PAYLOAD,     "filter.payload",     SETTING_FMT_STRING,  "",          NULL, { 0 } },
+    { SETTING_FILTER_METHODS,     "filter.methods",     SETTING_FMT_STRING,  "",          NULL, { 0 } },
 #ifdef USE_EEP
-    { SETTING_EEP_SEND,           "eep.send",           SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF },
-    { SETTING_EEP_SEND_VER,       "eep.send.version",   SETTING_FMT_ENUM,    "3",         SETTING_ENUM_HEPVERSION },
-    { SETTING_EEP_SEND_ADDR,      "eep.send.address",   SETTING_FMT_STRING,  "127.0.0.1",  NULL },
-    { SETTING_EEP_SEND_PORT,      "eep.send.port",      SETTING_FMT_NUMBER,  "9060",      NULL },
-    { SETTING_EEP_SEND_PASS,      "eep.send.pass",      SETTING_FMT_STRING,  "",          NULL },
-    { SETTING_EEP_SEND_ID,        "eep.send.id",        SETTING_FMT_NUMBER,  "2002",      NULL },
-    { SETTING_EEP_LISTEN,         "eep.listen",         SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF },
-    { SETTING_EEP_LISTEN_VER,     "eep.listen.version", SETTING_FMT_ENUM,    "3",         SETTING_ENUM_HEPVERSION },
-    { SETTING_EEP_LISTEN_ADDR,    "eep.listen.address", SETTING_FMT_STRING,  "0.0.0.0",   NULL },
-    { SETTING_EEP_LISTEN_PORT,    "eep.listen.port",    SETTING_FMT_NUMBER,  "9060",      NULL },
-    { SETTING_EEP_LISTEN_PASS,    "eep.listen.pass",    SETTING_FMT_STRING,  "",          NULL },
-    { SETTING_EEP_LISTEN_UUID,    "eep.listen.uuid",    SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF },
+    { SETTING_EEP_SEND,           "eep.send",           SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF, { 0 } },
+    { SETTING_EEP_SEND_VER,       "eep.send.version",   SETTING_FMT_ENUM,    "3",         SETTING_ENUM_HEPVERSION, { 0 } },
+    { SETTING_EEP_SEND_ADDR,      "eep.send.address",   SETTING_FMT_STRING,  "127.0.0.1",  NULL, { 0 } },
+    { SETTING_EEP_SEND_PORT,      "eep.send.port",      SETTING_FMT_NUMBER,  "9060",      NULL, { 0 } },
+    { SETTING_EEP_SEND_PASS,      "eep.send.pass",      SETTING_FMT_STRING,  "",          NULL, { 0 } },
+    { SETTING_EEP_SEND_ID,        "eep.send.id",        SETTING_FMT_NUMBER,  "2002",      NULL, { 0 } },
+    { SETTING_EEP_SEND_QUEUE,     "eep.send.queue",     SETTING_FMT_NUMBER,  "4096",      NULL, { 0 } },
+    { SETTING_EEP_LISTEN,         "eep.listen",         SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF, { 0 } },
+    { SETTING_EEP_LISTEN_VER,     "eep.listen.version", SETTING_FMT_ENUM,    "3",         SETTING_ENUM_HEPVERSION, { 0 } },
+    { SETTING_EEP_LISTEN_ADDR,    "eep.listen.address", SETTING_FMT_STRING,  "0.0.0.0",   NULL, { 0 } },
+    { SETTING_EEP_LISTEN_PORT,    "eep.listen.port",    SETTING_FMT_NUMBER,  "9060",      NULL, { 0 } },
+    { SETTING_EEP_LISTEN_PASS,    "eep.listen.pass",    SETTING_FMT_STRING,  "",          NULL, { 0 } },
+    { SETTING_EEP_LISTEN_UUID,    "eep.listen.uuid",    SETTING_FMT_ENUM,    SETTING_OFF, SETTING_ENUM_ONOFF, { 0 } },
+    { SETTING_EEP_LISTEN_PROTO,   "eep.listen.proto",   SETTING_FMT_ENUM,    "udp",       SETTING_ENUM_HEPPROTO, { 0 } },
+    { SETTING_EEP_LISTEN_TIMEOUT, "eep.listen.timeout", SETTING_FMT_NUMBER,  "60",        NULL, { 0 } },
+    { SETTING_EEP_LISTEN_MAXCONN, "eep.listen.maxconn", SETTING_FMT_NUMBER,  "64",        NULL, { 0 } },
 #endif
 };
 
+void
+init_settings()
+{
+    int i;
+
+    // Parse default values before any thread reads them
+    for (i = 0; i < SETTING_COUNT; i++)
+        setting_parse_value(&settings[i]);
+}
+
 setting_t *
 setting_by_id(int id)
+{
+    if (id < 0 || id >= SETTING_COUNT)
+        return NULL;
+    return &settings[id];
+}
+
+void
+setting_parse_value(setting_t *sett)
 {
     int i;
-    for (i = 0; i < SETTING_COUNT; i++) {
-        if (id == settings[i].id)
-            return &settings[i];
+
+    sett->parsed.enabled = !strcmp(sett->value, SETTING_ON) || !strcmp(sett->value, SETTING_YES);
+    sett->parsed.disabled = !strcmp(sett->value, SETTING_OFF) || !strcmp(sett->value, SETTING_NO);
+    sett->parsed.intvalue = (*sett->value) ? atoi(sett->value) : -1;
+
+    sett->parsed.enumvalue = -1;
+    for (i = 0; sett->valuelist && sett->valuelist[i]; i++) {
+        if (!strcmp(sett->valuelist[i], sett->value)) {
+            sett->parsed.enumvalue = i;
+            break;
+        }
     }
-    return NULL;
 }
 
 setting_t *
@@ -153,14 +197,21 @@ const char *
 setting_get_value(int id)
 {
     const setting_t *sett = setting_by_id(id);
-    return (sett && strlen(sett->value)) ? sett->value : NULL;
+    return (sett && *sett->value) ? sett->value : NULL;
 }
 
 int
 setting_get_intvalue(int id)
 {
     const setting_t *sett = setting_by_id(id);
-    return (sett && strlen(sett->value)) ? atoi(sett->value) : -1;
+    return (sett) ? sett->parsed.intvalue : -1;
+}
+
+int
+setting_get_enumvalue(int id)
+{
+    const setting_t *sett = setting_by_id(id);
+    return (sett) ? sett->parsed.enumvalue : -1;
 }
 
 void
@@ -177,6 +228,7 @@ setting_set_value(int id, const char *value)
                 exit(1);
             }
         }
+        setting_parse_value(sett);
     }
 }
 
@@ -191,15 +243,15 @@ setting_set_intvalue(int id, int value)
 int
 setting_enabled(int id)
 {
-    return setting_has_value(id, "on") ||
-           setting_has_value(id, "yes");
+    const setting_t *sett = setting_by_id(id);
+    return (sett) ? sett->parsed.enabled : 0;
 }
 
 int
 setting_disabled(int id)
 {
-    return setting_has_value(id, "off") ||
-           setting_has_value(id, "no");
+    const setting_t *sett = setting_by_id(id);
+    return (sett) ? sett->parsed.disabled : 0;
 }
 
 int
@@ -42,6 +42,8 @@
 #ifndef __SNGREP_SETTING_H
 #define __SNGREP_SETTING_H
 
+#include <stdbool.h>
+
 //! Max setting value
 #define MAX_SETTING_LEN   1024
 
@@ -60,7 +62,10 @@ typedef struct setting_option setting_t;
 #define SETTING_ENUM_SDP_INFO    (const char *[]){ "off", "first", "full", "compressed", NULL}
 #define SETTING_ENUM_STORAGE     (const char *[]){ "none", "memory", NULL }
 #define SETTING_ENUM_HEPVERSION  (const char *[]){ "2", "3", NULL }
+#define SETTING_ENUM_HEPPROTO    (const char *[]){ "udp", "tcp", NULL }
 #define SETTING_ENUM_MEDIA       (const char *[]){ "off", "on", "active", NULL }
+#define SETTING_ENUM_DUMPSYNC    (const char *[]){ "off", "idle", "batch", NULL }
+#define SETTING_ENUM_CDRFORMAT   (const char *[]){ "csv", "ndjson", NULL }
 
 //! Other useful defines
 #define SETTING_ON  "on"
@@ -69,6 +74,38 @@ typedef struct setting_option setting_t;
 #define SETTING_NO  "no"
 #define SETTING_ACTIVE "active"
 
+//! Positions of enum values (@see setting_get_enumvalue)
+enum setting_colormode {
+    SETTING_COLORMODE_REQUEST = 0,
+    SETTING_COLORMODE_CSEQ,
+    SETTING_COLORMODE_CALLID,
+};
+
+enum setting_highlight {
+    SETTING_HIGHLIGHT_BOLD = 0,
+    SETTING_HIGHLIGHT_REVERSE,
+    SETTING_HIGHLIGHT_REVERSEBOLD,
+};
+
+enum setting_sdp_info {
+    SETTING_SDP_INFO_OFF = 0,
+    SETTING_SDP_INFO_FIRST,
+    SETTING_SDP_INFO_FULL,
+    SETTING_SDP_INFO_COMPRESSED,
+};
+
+enum setting_media {
+    SETTING_MEDIA_OFF = 0,
+    SETTING_MEDIA_ON,
+    SETTING_MEDIA_ACTIVE,
+};
+
+enum setting_dump_sync {
+    SETTING_DUMP_SYNC_OFF = 0,
+    SETTING_DUMP_SYNC_IDLE,
+    SETTING_DUMP_SYNC_BATCH,
+};
+
 
 //! Available setting Options
 enum setting_id {
@@ -79,9 +116,15 @@ enum setting_id {
     SETTING_SYNTAX_BRANCH,
     SETTING_ALTKEY_HINT,
     SETTING_EXITPROMPT,
+    SETTING_MAXFPS,
     SETTING_CAPTURE_LIMIT,
     SETTING_CAPTURE_DEVICE,
     SETTING_CAPTURE_OUTFILE,
+    SETTING_CAPTURE_DUMP_QUEUE,
+    SETTING_CAPTURE_DUMP_DIRECT,
+    SETTING_CAPTURE_DUMP_SYNC,
+    SETTING_CAPTURE_DUMP_SIZE,
+    SETTING_CAPTURE_DUMP_INTERVAL,
     SETTING_CAPTURE_BUFFER,
 #if defined(WITH_GNUTLS) || defined(WITH_OPENSSL)
     SETTING_CAPTURE_KEYFILE,
@@ -96,6 +139,15 @@ enum setting_id {
     SETTING_SIP_NOINCOMPLETE,
     SETTING_SIP_HEADER_X_CID,
     SETTING_SIP_CALLS,
+    SETTING_EVENT_QUEUE,
+    SETTING_CDR_FORMAT,
+    SETTING_CDR_BATCH,
+    SETTING_CDR_RELEASE,
+    SETTING_METRICS_FILE,
+    SETTING_METRICS_INTERVAL,
+    SETTING_METRICS_ADDRESS,
+    SETTING_METRICS_PORT,
+    SETTING_METRICS_STAGES,
     SETTING_SAVEPATH,
     SETTING_DISPLAY_ALIAS,
     SETTING_ALIAS_PORT,
@@ -126,12 +178,16 @@ enum setting_id {
     SETTING_EEP_SEND_PORT,
     SETTING_EEP_SEND_PASS,
     SETTING_EEP_SEND_ID,
+    SETTING_EEP_SEND_QUEUE,
     SETTING_EEP_LISTEN,
     SETTING_EEP_LISTEN_VER,
     SETTING_EEP_LISTEN_ADDR,
     SETTING_EEP_LISTEN_PORT,
     SETTING_EEP_LISTEN_PASS,
     SETTING_EEP_LISTEN_UUID,
+    SETTING_EEP_LISTEN_PROTO,
+    SETTING_EEP_LISTEN_TIMEOUT,
+    SETTING_EEP_LISTEN_MAXCONN,
 #endif
     SETTING_COUNT
 };
@@ -145,6 +201,10 @@ enum setting_fmt {
 
 /**
  * @brief Configurable Setting structure
+ *
+ * Besides its string value, each setting stores its value already parsed
+ * so frequent checks don't need to compare strings. Parsed values are
+ * only updated from init_settings() and setting_set_value().
  */
 struct setting_option {
     //! Setting id
@@ -157,11 +217,44 @@ struct setting_option {
     char value[MAX_SETTING_LEN];
     //! Compa separated valid values
     const char **valuelist;
+    //! Values parsed from value (@see setting_parse_value)
+    struct {
+        //! Value is "on" or "yes"
+        bool enabled;
+        //! Value is "off" or "no"
+        bool disabled;
+        //! Numeric value (-1 if value is empty)
+        int intvalue;
+        //! Position of the value in valuelist (-1 if not found)
+        int enumvalue;
+    } parsed;
 };
 
+/**
+ * @brief Parse default values of all settings
+ *
+ * Must be called before any setting is read
+ */
+void
+init_settings();
+
+/**
+ * @brief Get setting structure from its id
+ *
+ * Settings array is indexed by setting id, so this is a direct access.
+ *
+ * @param id Setting id from settings enum
+ * @return setting structure or NULL if id is not valid
+ */
 setting_t *
 setting_by_id(int id);
 
+/**
+ * @brief Update parsed values of a setting from its string value
+ */
+void
+setting_parse_value(setting_t *sett);
+
 setting_t *
 setting_by_name(const char *name);
 
@@ -195,6 +288,15 @@ setting_get_value(int id);
 int
 setting_get_intvalue(int id);
 
+/**
+ * @brief Get the position of setting value in its valid values
+ *
+ * @param id Setting id from settings enum
+ * @return value position or -1 if value is not valid
+ */
+int
+setting_get_enumvalue(int id);
+
 void
 setting_set_value(int id, const char *value);
 
@@ -36,6 +36,9 @@
 #include "option.h"
 #include "setting.h"
 #include "filter.h"
+#include "event.h"
+#include "cdr.h"
+#include "metrics.h"
 
 /**
  * @brief Linked list of parsed calls
@@ -194,7 +197,7 @@ sip_init(int limit, int only_calls, int no_incomplete)
             "^(X-Call-ID|X-CID):[ ]*([^ ]+)[ ]*\r$", match_flags);
     }
     regcomp(&calls.reg_response, "^SIP/2.0[ ]*(([0-9]{3}) [^\r]*)[ ]*\r", match_flags & ~REG_NEWLINE);
-    regcomp(&calls.reg_cseq, "^CSeq:[ ]*([0-9]{1,10}) .+\r$", match_flags);
+    regcomp(&calls.reg_cseq, "^CSeq:[ ]*([0-9]{1,10}) ([A-Z]+).*\r$", match_flags);
     regcomp(&calls.reg_from, "^(From|f):[ ]*[^:]*:(([^@>]+)@?[^\r>;]+)", match_flags);
     regcomp(&calls.reg_to, "^(To|t):[ ]*[^:]*:(([^@>]+)@?[^\r>;]+)", match_flags);
     regcomp(&calls.reg_valid, "^([A-Z]+ [a-zA-Z]+:|SIP/2.0 [0-9]{3})", match_flags & ~REG_NEWLINE);
@@ -347,6 +350,93 @@ sip_validate_packet(packet_t *packet)
     return VALIDATE_COMPLETE_SIP;
 }
 
+/**
+ * @brief Remove a call from updated calls chain
+ */
+static void
+sip_calls_unlink_updated(sip_call_t *call)
+{
+    if (call->updprev)
+        call->updprev->updnext = call->updnext;
+    if (call->updnext)
+        call->updnext->updprev = call->updprev;
+    if (calls.last_updated == call)
+        calls.last_updated = call->updprev;
+    call->updprev = call->updnext = NULL;
+}
+
+/**
+ * @brief Move a call to the end of the updated calls chain
+ */
+static void
+sip_calls_set_updated(sip_call_t *call)
+{
+    if (calls.last_updated != call) {
+        sip_calls_unlink_updated(call);
+        if ((call->updprev = calls.last_updated))
+            call->updprev->updnext = call;
+        calls.last_updated = call;
+    }
+    call->updseq = ++calls.update_seq;
+}
+
+/**
+ * @brief Keep an ended call until its last transaction has finished
+ *
+ * Messages that finish the transaction (the response to the BYE or the
+ * ACK of a failed INVITE) must still find their call. If they are not
+ * captured, the call is removed after SIP_CALL_LINGER seconds.
+ */
+static void
+sip_calls_set_ended(sip_call_t *call, sip_msg_t *msg)
+{
+    call->ended_msg = msg;
+    call->ended_deadline = msg_get_time(msg).tv_sec + SIP_CALL_LINGER;
+    if ((call->endprev = calls.ended_last)) {
+        call->endprev->endnext = call;
+    } else {
+        calls.ended_first = call;
+    }
+    calls.ended_last = call;
+}
+
+/**
+ * @brief Remove a call from ended calls chain
+ */
+static void
+sip_calls_unlink_ended(sip_call_t *call)
+{
+    if (call->endprev)
+        call->endprev->endnext = call->endnext;
+    if (call->endnext)
+        call->endnext->endprev = call->endprev;
+    if (calls.ended_first == call)
+        calls.ended_first = call->endnext;
+    if (calls.ended_last == call)
+        calls.ended_last = call->endprev;
+    call->endprev = call->endnext = NULL;
+    call->ended_msg = NULL;
+}
+
+/**
+ * @brief Check if given message finishes the transaction that ended its call
+ */
+static bool
+sip_call_ended_transaction(sip_call_t *call, sip_msg_t *msg)
+{
+    sip_msg_t *ended = call->ended_msg;
+
+    if (msg->cseq != ended->cseq)
+        return false;
+
+    // Final response to the request that ended the call
+    if (msg_is_request(ended))
+        return msg->reqresp >= 200 && msg->cseqmethod == ended->reqresp;
+
+    // ACK of the final response that ended the call
+    return msg->reqresp == SIP_METHOD_ACK;
+}
+
 sip_msg_t *
 sip_check_packet(packet_t *packet)
 {
@@ -354,7 +444,23 @@ sip_check_packet(packet_t *packet)
     sip_call_t *call;
     char callid[MAX_CALLID_SIZE], xcallid[MAX_XCALLID_SIZE];
     u_char payload[MAX_SIP_PAYLOAD];
-    bool newcall = false;
+    bool newcall = false, recorded;
+    int oldstate;
+    time_t now;
+
+    if (!calls.held) {
+        // Remove the call ended by previous packet once it is no longer used
+        if (calls.release)
+            sip_calls_remove(calls.release);
+
+        // Remove ended calls whose last transaction was not captured
+        now = packet_time(packet).tv_sec;
+        while ((call = calls.ended_first) && call->ended_deadline <= now) {
+            sip_calls_unlink_ended(call);
+            if (!call->locked)
+                sip_calls_remove(call);
+        }
+    }
 
     // Max SIP payload allowed
     if (packet->payload_len > MAX_SIP_PAYLOAD)
@@ -404,9 +510,10 @@ sip_check_packet(packet_t *packet)
         // Get the Call-ID of this message
         sip_get_xcallid((const char*) payload, xcallid);
 
-        // Rotate call list if limit has been reached
-        if (calls.limit == sip_calls_count())
-            sip_calls_rotate();
+        // Rotate call list if limit has been reached (or exceeded while held)
+        if (calls.limit && !calls.held) {
+            while (sip_calls_count() >= calls.limit && sip_calls_rotate() == 0);
+        }
 
         // Create the call if not found
         if (!(call = call_create(callid, xcallid)))
@@ -437,17 +544,43 @@ sip_check_packet(packet_t *packet)
 
     // Add the message to the call
     call_add_message(call, msg);
+    sip_calls_count_msg(msg, 1);
 
     // check if message is a retransmission
     call_msg_retrans_check(msg);
 
+    // Stream message event
+    event_msg(msg);
+    metrics_sip_msg(msg->reqresp);
+
     if (call_is_invite(call)) {
         // Parse media data
         sip_parse_msg_media(msg, payload);
+        // Parse extra fields (before the state change, to be included in CDRs)
+        sip_parse_extra_headers(msg, payload);
         // Update Call State
+        oldstate = call->state;
+        recorded = call->recorded;
         call_update_state(call, msg);
-        // Parse extra fields
-        sip_parse_extra_headers(msg, payload);
+        if (call->state != oldstate) {
+            if (oldstate) {
+                calls.counters.states[oldstate]--;
+            } else {
+                calls.counters.calls++;
+            }
+            calls.counters.states[call->state]++;
+            // Stream call state event
+            event_call_state(call, msg, oldstate);
+        }
+        // Free ended calls memory once their CDR has been written and
+        // the transaction that ended them has finished
+        if (call->ended_msg && sip_call_ended_transaction(call, msg)) {
+            sip_calls_unlink_ended(call);
+            if (!call->locked)
+                calls.release = call;
+        } else if (call->recorded && !recorded && cdr_release_enabled()) {
+            sip_calls_set_ended(call, msg);
+        }
         // Check if this call should be in active call list
         if (call_is_active(call)) {
             if (sip_call_is_active(call)) {
@@ -464,10 +597,15 @@ sip_check_packet(packet_t *packet)
         // Append this call to the call list
         vector_append(calls.list, call);
         ++calls.call_count_unrotated;
+        calls.counters.dialogs++;
     }
 
+    // Move the call to the end of updated calls chain
+    sip_calls_set_updated(call);
+
     // Mark the list as changed
     calls.changed = true;
+    metrics_set_calls(vector_count(calls.list), vector_count(calls.active));
 
     // Return the loaded message
     return msg;
@@ -529,6 +667,18 @@ sip_active_calls_vector()
     return calls.active;
 }
 
+unsigned int
+sip_calls_version()
+{
+    return calls.version;
+}
+
+sip_call_t *
+sip_calls_last_updated()
+{
+    return calls.last_updated;
+}
+
 sip_stats_t
 sip_calls_stats()
 {
@@ -537,12 +687,48 @@ sip_calls_stats()
 
     // Total number of calls without filtering
     stats.total = vector_iterator_count(&it);
-    // Total number of calls after filtering
-    vector_iterator_set_filter(&it, filter_check_call);
+    // Total number of calls after filtering (already evaluated)
+    vector_iterator_set_filter(&it, filter_check_call_cached);
     stats.displayed = vector_iterator_count(&it);
     return stats;
 }
 
+const sip_counters_t *
+sip_calls_counters()
+{
+    return &calls.counters;
+}
+
+void
+sip_calls_count_call(sip_call_t *call, int delta)
+{
+    vector_iter_t it;
+    sip_msg_t *msg;
+
+    calls.counters.dialogs += delta;
+    if (call->state) {
+        calls.counters.calls += delta;
+        calls.counters.states[call->state] += delta;
+    }
+
+    it = vector_iterator(call->msgs);
+    while ((msg = vector_iterator_next(&it)))
+        sip_calls_count_msg(msg, delta);
+}
+
+void
+sip_calls_count_msg(sip_msg_t *msg, int delta)
+{
+    calls.counters.msgs += delta;
+    if (msg->reqresp >= 800) {
+        calls.counters.responses[8] += delta;
+    } else if (msg->reqresp >= 100) {
+        calls.counters.responses[msg->reqresp / 100] += delta;
+    } else if (msg->reqresp <= SIP_METHOD_PRACK) {
+        calls.counters.methods[msg->reqresp] += delta;
+    }
+}
+
 sip_call_t *
 sip_find_by_index(int index)
 {
@@ -562,6 +748,7 @@ sip_get_msg_reqresp(sip_msg_t *msg, const u_char *payload)
     char resp_str[SIP_ATTR_MAXLEN];
     char reqresp[SIP_ATTR_MAXLEN];
     char cseq[11];
+    char cseqmethod[SIP_ATTR_MAXLEN];
     const char *resp_def;
 
     // Initialize variables
@@ -582,9 +769,13 @@ sip_get_msg_reqresp(sip_msg_t *msg, const u_char *payload)
         }
 
         // CSeq
-        if (regexec(&calls.reg_cseq, (char*)payload, 2, pmatch, 0) == 0) {
+        if (regexec(&calls.reg_cseq, (char*)payload, 3, pmatch, 0) == 0) {
             sprintf(cseq, "%.*s", (int)(pmatch[1].rm_eo - pmatch[1].rm_so), payload + pmatch[1].rm_so);
             msg->cseq = atoi(cseq);
+            if ((int)(pmatch[2].rm_eo - pmatch[2].rm_so) < SIP_ATTR_MAXLEN) {
+                sprintf(cseqmethod, "%.*s", (int)(pmatch[2].rm_eo - pmatch[2].rm_so), payload + pmatch[2].rm_so);
+                msg->cseqmethod = sip_method_from_str(cseqmethod);
+            }
         }
 
 
@@ -784,8 +975,10 @@ sip_parse_extra_headers(sip_msg_t *msg, const u_char *payload)
 
      // Reason text
      if (regexec(&calls.reg_reason, (const char *)payload, 2, pmatch, 0) == 0) {
+         sng_free(msg->call->reasontxt);
          msg->call->reasontxt = sng_malloc((int)pmatch[1].rm_eo - pmatch[1].rm_so + 1);
          strncpy(msg->call->reasontxt, (const char *)payload +  pmatch[1].rm_so, (int)pmatch[1].rm_eo - pmatch[1].rm_so);
+         call_attr_invalidate(msg->call, SIP_ATTR_REASON_TXT);
      }
 
      // Warning code
@@ -800,6 +993,7 @@ sip_parse_extra_headers(sip_msg_t *msg, const u_char *payload)
         warning[warning_match_len] = '\0'; // Ensuring null termination
 
         msg->call->warning = atoi(warning);
+        call_attr_invalidate(msg->call, SIP_ATTR_WARNING);
      }
 }
 
@@ -813,6 +1007,14 @@ sip_calls_clear()
     // Remove all items from vector
     vector_clear(calls.list);
     vector_clear(calls.active);
+    memset(&calls.counters, 0, sizeof(calls.counters));
+    calls.release = NULL;
+    calls.ended_first = calls.ended_last = NULL;
+    metrics_set_calls(0, 0);
+
+    // All calls have been removed
+    calls.last_updated = NULL;
+    calls.version++;
 }
 
 void
@@ -830,27 +1032,67 @@ sip_calls_clear_soft()
         sip_call_t *call;
         vector_iter_t it = vector_iterator(calls.list);
 
+        // Rebuild updated calls chain with remaining calls
+        calls.last_updated = NULL;
+        calls.release = NULL;
+        calls.ended_first = calls.ended_last = NULL;
+        calls.version++;
+        memset(&calls.counters, 0, sizeof(calls.counters));
+
         while ((call = vector_iterator_next(&it)))
         {
                 htable_insert(calls.callids, call->callid, call);
+                call->updprev = call->updnext = NULL;
+                call->endprev = call->endnext = NULL;
+                call->ended_msg = NULL;
+                sip_calls_set_updated(call);
+                sip_calls_count_call(call, 1);
         }
+        metrics_set_calls(vector_count(calls.list), vector_count(calls.active));
 }
 
-void
+int
 sip_calls_rotate()
 {
     sip_call_t *call;
     vector_iter_t it = vector_iterator(calls.list);
     while ((call = vector_iterator_next(&it))) {
         if (!call->locked) {
-            // Remove from callids hash
-            htable_remove(calls.callids, call->callid);
-            // Remove first call from active and call lists
-            vector_remove(calls.active, call);
-            vector_remove(calls.list, call);
-            return;
+            sip_calls_remove(call);
+            return 0;
         }
     }
+    return 1;
+}
+
+void
+sip_calls_remove(sip_call_t *call)
+{
+    sip_call_t *parent;
+
+    // Remove from callids hash
+    htable_remove(calls.callids, call->callid);
+    // Remove from updated and ended calls chains
+    sip_calls_unlink_updated(call);
+    sip_calls_unlink_ended(call);
+    calls.version++;
+    // Remove call and its messages from counters
+    sip_calls_count_call(call, -1);
+    // Remove from the extended calls of its parent
+    if (strlen(call->xcallid) && (parent = sip_find_by_callid(call->xcallid)))
+        vector_remove(parent->xcalls, call);
+    // Remove call from active and call lists
+    if (calls.release == call)
+        calls.release = NULL;
+    vector_remove(calls.active, call);
+    vector_remove(calls.list, call);
+    metrics_set_calls(vector_count(calls.list), vector_count(calls.active));
+}
+
+void
+sip_calls_hold(bool hold)
+{
+    calls.held += (hold) ? 1 : -1;
 }
 
 int
@@ -1023,6 +1265,7 @@ sip_sort_list()
 
     // The new sorted list
     calls.list = clone;
+    calls.version++;
 }
 
 void
@@ -49,6 +49,8 @@
 #define MAX_XCALLID_SIZE 1024
 #define MAX_CONTENT_LENGTH_SIZE 10
 #define MAX_WARNING_SIZE 10
+//! Seconds an ended call waits for its last transaction before removal (Timer B/F)
+#define SIP_CALL_LINGER 32
 
 //! Shorter declaration of sip_call_list structure
 typedef struct sip_call_list sip_call_list_t;
@@ -56,6 +58,8 @@ typedef struct sip_call_list sip_call_list_t;
 typedef struct sip_code sip_code_t;
 //! Shorter declaration of sip stats
 typedef struct sip_stats sip_stats_t;
+//! Shorter declaration of sip counters
+typedef struct sip_counters sip_counters_t;
 //! Shorter declaration of sip sort
 typedef struct sip_sort sip_sort_t;
 
@@ -106,6 +110,28 @@ struct sip_stats
     int displayed;
 };
 
+/**
+ * @brief Counters of stored dialogs and messages
+ *
+ * Counters are updated while packets are parsed and when calls are
+ * removed from the list, so they always match the stored calls.
+ */
+struct sip_counters
+{
+    //! Number of stored dialogs
+    int dialogs;
+    //! Number of dialogs that are calls
+    int calls;
+    //! Number of calls in each state @see call_state
+    int states[SIP_CALLSTATE_COMPLETED + 1];
+    //! Number of stored messages
+    int msgs;
+    //! Number of requests of each method @see sip_methods
+    int methods[SIP_METHOD_PRACK + 1];
+    //! Number of responses of each class (1XX to 8XX)
+    int responses[9];
+};
+
 /**
  * @brief Sorting information for the sip list
  */
@@ -129,15 +155,29 @@ struct sip_call_list {
     vector_t *active;
     //! Changed flag. For interface optimal updates
     bool changed;
+    //! List version, increased each time calls are removed or reordered
+    unsigned int version;
+    //! Most recently updated call (@see sip_calls_last_updated)
+    sip_call_t *last_updated;
+    //! Last call update sequence number
+    uint64_t update_seq;
     //! Sort call list following this options
     sip_sort_t sort;
     //! Last created id
     int last_index;
     //! Call-Ids hash table
     htable_t *callids;
+    //! Dialogs and messages counters
+    sip_counters_t counters;
 
     //! Full count of all captured calls, regardless of rotation
     int call_count_unrotated;
+    //! Calls are being held, don't rotate them (@see sip_calls_hold)
+    int held;
+    //! Ended call to be removed before parsing next packet (@see cdr_release_enabled)
+    sip_call_t *release;
+    //! Ended calls waiting for their last transaction, oldest first
+    sip_call_t *ended_first, *ended_last;
     // Max call limit
     int limit;
     //! Only store dialogs starting with INVITE
@@ -310,6 +350,29 @@ sip_calls_vector();
 vector_t *
 sip_active_calls_vector();
 
+/**
+ * @brief Return the call list version
+ *
+ * Version changes each time calls are removed from the list or the
+ * list is sorted again, so any view of the call list must be rebuilt.
+ * Adding calls or messages doesn't change the version.
+ */
+unsigned int
+sip_calls_version();
+
+/**
+ * @brief Return the most recently updated call
+ *
+ * Calls are chained by update order (@see sip_call::updprev), so the
+ * calls updated since a given sequence number can be found walking
+ * backwards from this call until a call with an older sequence is
+ * found, without checking the whole call list.
+ *
+ * @return most recently updated call or NULL if list is empty
+ */
+sip_call_t *
+sip_calls_last_updated();
+
 /**
  * @brief Return stats from call list
  *
@@ -319,6 +382,35 @@ sip_active_calls_vector();
 sip_stats_t
 sip_calls_stats();
 
+/**
+ * @brief Return dialogs and messages counters of call list
+ *
+ * Counters are maintained while parsing, so this doesn't need
+ * to check stored calls.
+ *
+ * @return pointer to current counters
+ */
+const sip_counters_t *
+sip_calls_counters();
+
+/**
+ * @brief Add or remove a call from list counters
+ *
+ * @param call Call to be added or removed
+ * @param delta 1 to add the call and its messages, -1 to remove them
+ */
+void
+sip_calls_count_call(sip_call_t *call, int delta);
+
+/**
+ * @brief Add or remove a message from list counters
+ *
+ * @param msg Message to be added or removed
+ * @param delta 1 to add the message, -1 to remove it
+ */
+void
+sip_calls_count_msg(sip_msg_t *msg, int delta);
+
 
 /**
  * @brief Find a call structure in calls linked list given a call index
@@ -373,10 +465,36 @@ sip_calls_clear_soft();
  *
  * This function removes the first call in the calls vector avoiding
  * reaching the capture limit.
+ *
+ * @return 0 if a call has been removed, 1 if all calls are locked
  */
-void
+int
 sip_calls_rotate();
 
+/**
+ * @brief Remove a call from the call list
+ *
+ * Call and its messages are freed, so it can not be referenced after
+ * calling this function.
+ */
+void
+sip_calls_remove(sip_call_t *call);
+
+/**
+ * @brief Hold or release the calls in the call list
+ *
+ * While calls are held, rotation is delayed so no call or message is
+ * freed, even if the capture limit is exceeded. This allows reading
+ * them without the capture lock (for example, from a save thread).
+ * Holds can be nested and must be released the same number of times.
+ *
+ * This function must be called with the capture lock held.
+ *
+ * @param hold true to hold the calls, false to release them
+ */
+void
+sip_calls_hold(bool hold);
+
 /**
  * @brief Get message Request/Response code
  *
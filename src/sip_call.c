@@ -32,6 +32,8 @@
 #include "sip_call.h"
 #include "sip.h"
 #include "setting.h"
+#include "cdr.h"
+#include "metrics.h"
 
 sip_call_t *
 call_create(char *callid, char *xcallid)
@@ -72,6 +74,8 @@ call_create(char *callid, char *xcallid)
 void
 call_destroy(sip_call_t *call)
 {
+    int i;
+
     // Remove all call messages
     vector_destroy(call->msgs);
     // Remove all call streams
@@ -84,6 +88,9 @@ call_destroy(sip_call_t *call)
     sng_free(call->callid);
     sng_free(call->xcallid);
     sng_free(call->reasontxt);
+    // Remove cached attribute values
+    for (i = 0; i < SIP_ATTR_COUNT; i++)
+        sng_free(call->attrs[i]);
     sng_free(call);
 }
 
@@ -108,6 +115,9 @@ call_add_message(sip_call_t *call, sip_msg_t *msg)
     msg->index = vector_append(call->msgs, msg);
     // Flag this call as changed
     call->changed = true;
+    // Message dependent attributes must be calculated again
+    call_attr_invalidate(call, SIP_ATTR_MSGCNT);
+    call_attr_invalidate(call, SIP_ATTR_TOTALDUR);
 }
 
 void
@@ -115,6 +125,7 @@ call_add_stream(sip_call_t *call, rtp_stream_t *stream)
 {
     // Store stream
     vector_append(call->streams, stream);
+    metrics_rtp_stream();
     // Flag this call as changed
     call->changed = true;
 }
@@ -196,7 +207,8 @@ call_msg_with_media(sip_call_t *call, address_t dst)
 void
 call_update_state(sip_call_t *call, sip_msg_t *msg)
 {
-    int reqresp;
+    int reqresp, state = call->state;
+    sip_msg_t *cstart_msg = call->cstart_msg, *cend_msg = call->cend_msg;
 
     if (!call_is_invite(call))
         return;
@@ -242,6 +254,18 @@ call_update_state(sip_call_t *call, sip_msg_t *msg)
             call->state = SIP_CALLSTATE_CALLSETUP;
         }
     }
+
+    // Update cached attributes of changed fields
+    if (call->state != state)
+        call_attr_invalidate(call, SIP_ATTR_CALLSTATE);
+    if (call->cstart_msg != cstart_msg || call->cend_msg != cend_msg)
+        call_attr_invalidate(call, SIP_ATTR_CONVDUR);
+
+    // Write the record of calls that have ended
+    if (!call->recorded && cdr_enabled() && cdr_call_ended(call, msg)) {
+        cdr_call(call, msg);
+        call->recorded = true;
+    }
 }
 
 const char *
@@ -296,6 +320,46 @@ call_get_attribute(sip_call_t *call, enum sip_attr_id id, char *value)
     return strlen(value) ? value : NULL;
 }
 
+const char *
+call_get_attribute_cached(sip_call_t *call, enum sip_attr_id id)
+{
+    char value[MAX_SIP_PAYLOAD];
+    sip_attr_hdr_t *header;
+
+    if (!call || id >= SIP_ATTR_COUNT)
+        return NULL;
+
+    // Calculate the value the first time is requested
+    if (!call->attrs[id]) {
+        value[0] = '\0';
+        call->attrs[id] = strdup(call_get_attribute(call, id, value) ? value : "");
+        // Calculate the value color too
+        header = sip_attr_get_header(id);
+        call->attrcolors[id] = (header && header->color) ? header->color(call->attrs[id]) : 0;
+    }
+
+    return strlen(call->attrs[id]) ? call->attrs[id] : NULL;
+}
+
+int
+call_get_attribute_color(sip_call_t *call, enum sip_attr_id id)
+{
+    if (!setting_enabled(SETTING_CL_COLORATTR))
+        return 0;
+
+    if (!call_get_attribute_cached(call, id))
+        return 0;
+
+    return call->attrcolors[id];
+}
+
+void
+call_attr_invalidate(sip_call_t *call, enum sip_attr_id id)
+{
+    sng_free(call->attrs[id]);
+    call->attrs[id] = NULL;
+}
+
 const char *
 call_state_to_str(int state)
 {
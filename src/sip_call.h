@@ -68,6 +68,16 @@ struct sip_call {
     char *xcallid;
     //! Flag this call as filtered so won't be displayed
     signed char filtered;
+    //! Filters version used to evaluate the filtered flag
+    unsigned int filter_version;
+    //! Number of call messages when filtered flag was evaluated
+    int filter_msgcnt;
+    //! Number of call messages checked against payload filter
+    int filter_payload_cnt;
+    //! Any of the checked messages matched the payload filter
+    bool filter_payload;
+    //! Call is listed in call list displayed calls
+    bool listed;
     //! Call State. For dialogs starting with an INVITE method
     int state;
     //! Changed flag. For interface optimal updates
@@ -90,6 +100,22 @@ struct sip_call {
     vector_t *streams;
     //! RTP packets for this call (capture_packet_t *)
     vector_t *rtp_packets;
+    //! Cached attribute values (@see call_get_attribute_cached)
+    char *attrs[SIP_ATTR_COUNT];
+    //! Cached attribute colors (@see call_get_attribute_color)
+    int attrcolors[SIP_ATTR_COUNT];
+    //! Sequence number of the last call update
+    uint64_t updseq;
+    //! Previous and next calls in update order
+    sip_call_t *updprev, *updnext;
+    //! Call Detail Record of this call has been written
+    bool recorded;
+    //! Message that ended the call, removed when its transaction finishes
+    sip_msg_t *ended_msg;
+    //! Capture time when the ended call is removed even if its transaction didn't finish
+    time_t ended_deadline;
+    //! Previous and next calls waiting for their last transaction
+    sip_call_t *endprev, *endnext;
 };
 
 /**
@@ -241,6 +267,47 @@ call_update_state(sip_call_t *call, sip_msg_t *msg);
 const char *
 call_get_attribute(struct sip_call *call, enum sip_attr_id id, char *value);
 
+/**
+ * @brief Return a cached call attribute value
+ *
+ * Same as call_get_attribute, but the value is only calculated the
+ * first time it is requested. Values that depend on call messages
+ * are recalculated after call_attr_invalidate is invoked.
+ *
+ * Returned pointer is owned by the call and it is valid until the
+ * next call update.
+ *
+ * @param call SIP call structure
+ * @param id Attribute id
+ * @return Attribute value or NULL if not found
+ */
+const char *
+call_get_attribute_cached(sip_call_t *call, enum sip_attr_id id);
+
+/**
+ * @brief Return the color of a cached call attribute value
+ *
+ * Color is calculated when the attribute value is cached.
+ *
+ * @param call SIP call structure
+ * @param id Attribute id
+ * @return Attribute color or 0 if attribute has no color
+ */
+int
+call_get_attribute_color(sip_call_t *call, enum sip_attr_id id);
+
+/**
+ * @brief Remove a cached attribute value
+ *
+ * This must be invoked each time any of the call fields used to
+ * calculate the attribute value is updated.
+ *
+ * @param call SIP call structure
+ * @param id Attribute id
+ */
+void
+call_attr_invalidate(sip_call_t *call, enum sip_attr_id id);
+
 /**
  * @brief Return the string represtation of a call state
  *
@@ -56,6 +56,8 @@ struct sip_msg {
     char *resp_str;
     //! Message Cseq
     uint32_t cseq;
+    //! Method of the message Cseq @see sip_methods
+    int cseqmethod;
     //! SIP From Header
     char *sip_from;
     //! SIP To Header
@@ -245,6 +245,13 @@ vector_set_sorter(vector_t *vector, void (*sorter) (vector_t *vector, void *item
     vector->sorter = sorter;
 }
 
+void
+vector_sort(vector_t *vector, int (*cmp) (const void *item1, const void *item2))
+{
+    if (vector->count > 1)
+        qsort(vector->list, vector->count, sizeof(void *), cmp);
+}
+
 void
 vector_generic_destroyer(void *item)
 {
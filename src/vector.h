@@ -170,6 +170,15 @@ vector_set_destroyer(vector_t *vector, void (*destroyer) (void *item));
 void
 vector_set_sorter(vector_t *vector, void (*sorter) (vector_t *vector, void *item));
 
+/**
+ * @brief Sort all vector items at once
+ *
+ * Unlike vector sorter, this sorts the current items using
+ * a qsort comparator receiving pointers to two items.
+ */
+void
+vector_sort(vector_t *vector, int (*cmp) (const void *item1, const void *item2));
+
 /**
  * @brief A generic item destroyer
  *
@@ -0,0 +1,626 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file bench_parser.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * Microbenchmarks of SIP and RTP parser functions
+ *
+ * A synthetic corpus of SIP messages is generated for each benchmark
+ * (INVITE dialogs with SDP, REGISTER storms, compact headers and TCP
+ * segments with several messages) and each parser function is timed in
+ * isolation. Packets are created before starting the timer.
+ *
+ * Results are printed one JSON object per line, with the time and the
+ * number of allocations per parsed message.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include "../src/capture.h"
+#include "../src/option.h"
+#include "../src/setting.h"
+#include "../src/sip.h"
+#include "../src/rtp.h"
+
+//! Max size of a generated message (or segment)
+#define BENCH_MSG_MAXLEN 4096
+//! RTP payload size (20ms of G.711)
+#define BENCH_RTP_LEN 160
+
+//! Synthetic corpus kinds
+enum bench_corpus {
+    //! INVITE/100/180/200/ACK/BYE/200 dialogs with SDP
+    CORPUS_DIALOG = 0,
+    //! REGISTER/401/REGISTER/200 transactions
+    CORPUS_REGISTER,
+    //! INVITE dialogs using compact header names
+    CORPUS_COMPACT,
+    //! TCP segments with three dialog messages each
+    CORPUS_TCP_MULTI,
+    CORPUS_COUNT
+};
+
+//! Corpus names in results
+static const char *corpus_names[CORPUS_COUNT] = {
+    "dialog", "register", "compact", "tcp_multi"
+};
+
+//! Shorter declaration of bench_msg structure
+typedef struct bench_msg bench_msg_t;
+
+/**
+ * @brief Generated message payload
+ */
+struct bench_msg {
+    //! Message payload
+    char *payload;
+    //! Payload length
+    int len;
+    //! Message is sent from the callee to the caller
+    bool reply;
+    //! Caller and callee addresses of the dialog
+    address_t caller;
+    address_t callee;
+};
+
+//! Allocations made since program start
+static uint64_t bench_allocs = 0;
+//! Bytes allocated since program start
+static uint64_t bench_alloc_bytes = 0;
+
+#ifdef __GLIBC__
+/**
+ * Count allocations replacing glibc allocator entry points. glibc
+ * allows replacing them and its internal functions (like strdup) also
+ * use the replaced ones.
+ */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+void *
+malloc(size_t size)
+{
+    bench_allocs++;
+    bench_alloc_bytes += size;
+    return __libc_malloc(size);
+}
+
+void *
+calloc(size_t nmemb, size_t size)
+{
+    bench_allocs++;
+    bench_alloc_bytes += nmemb * size;
+    return __libc_calloc(nmemb, size);
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+    bench_allocs++;
+    bench_alloc_bytes += size;
+    return __libc_realloc(ptr, size);
+}
+
+void
+free(void *ptr)
+{
+    __libc_free(ptr);
+}
+#endif
+
+//! Random seed of the corpus generator
+static unsigned int bench_seed = 1;
+
+static uint64_t
+bench_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+bench_report(const char *bench, const char *corpus, uint64_t msgs, uint64_t ns,
+             uint64_t allocs, uint64_t bytes)
+{
+    printf("{\"bench\":\"%s\",\"corpus\":\"%s\",\"msgs\":%lu,\"ns\":%lu,"
+           "\"ns_per_msg\":%.1f,\"allocs_per_msg\":%.2f,\"bytes_per_msg\":%.1f}\n",
+           bench, corpus, (unsigned long) msgs, (unsigned long) ns,
+           msgs ? (double) ns / msgs : 0, msgs ? (double) allocs / msgs : 0,
+           msgs ? (double) bytes / msgs : 0);
+    fflush(stdout);
+}
+
+static address_t
+bench_address(int port)
+{
+    address_t addr = { };
+    snprintf(addr.ip, sizeof(addr.ip), "10.%d.%d.%d",
+             rand_r(&bench_seed) % 256, rand_r(&bench_seed) % 256, 1 + rand_r(&bench_seed) % 254);
+    addr.port = port;
+    return addr;
+}
+
+static int
+bench_sdp(char *body, size_t size, address_t media, int port)
+{
+    return snprintf(body, size,
+                    "v=0\r\n"
+                    "o=- %u %u IN IP4 %s\r\n"
+                    "s=-\r\n"
+                    "c=IN IP4 %s\r\n"
+                    "t=0 0\r\n"
+                    "m=audio %d RTP/AVP 0 8 101\r\n"
+                    "a=rtpmap:0 PCMU/8000\r\n"
+                    "a=rtpmap:8 PCMA/8000\r\n"
+                    "a=rtpmap:101 telephone-event/8000\r\n"
+                    "a=sendrecv\r\n",
+                    rand_r(&bench_seed), rand_r(&bench_seed), media.ip, media.ip, port);
+}
+
+/**
+ * @brief Generate a SIP message of a dialog
+ *
+ * @param first Request or status line
+ * @param totag Include To tag (responses and in-dialog requests)
+ * @param sdp Media port of the SDP body (0 for no body)
+ */
+static int
+bench_sip(char *buf, size_t size, const char *first, const char *method, int cseq,
+          const char *callid, unsigned int tags[2], bool totag, bool compact,
+          address_t from, int sdp)
+{
+    char body[1024] = "";
+    char totagstr[32] = "";
+    int bodylen = 0;
+
+    if (sdp)
+        bodylen = bench_sdp(body, sizeof(body), from, sdp);
+    if (totag)
+        snprintf(totagstr, sizeof(totagstr), ";tag=%08x", tags[1]);
+
+    return snprintf(buf, size,
+                    "%s\r\n"
+                    "%s SIP/2.0/UDP %s:%d;branch=z9hG4bK%08x\r\n"
+                    "Max-Forwards: 70\r\n"
+                    "%s <sip:alice@example.com>;tag=%08x\r\n"
+                    "%s <sip:bob@example.com>%s\r\n"
+                    "%s %s\r\n"
+                    "CSeq: %d %s\r\n"
+                    "%s <sip:alice@%s:%d>\r\n"
+                    "User-Agent: sngrep-bench\r\n"
+                    "%s%s"
+                    "%s %d\r\n"
+                    "\r\n"
+                    "%s",
+                    first,
+                    compact ? "v:" : "Via:", from.ip, from.port, rand_r(&bench_seed),
+                    compact ? "f:" : "From:", tags[0],
+                    compact ? "t:" : "To:", totagstr,
+                    compact ? "i:" : "Call-ID:", callid,
+                    cseq, method,
+                    compact ? "m:" : "Contact:", from.ip, from.port,
+                    sdp ? (compact ? "c: " : "Content-Type: ") : "",
+                    sdp ? "application/sdp\r\n" : "",
+                    compact ? "l:" : "Content-Length:", bodylen,
+                    body);
+}
+
+static void
+bench_msg_add(bench_msg_t *msgs, int *count, int max, const char *buf, int len, bool reply,
+              address_t caller, address_t callee)
+{
+    if (*count >= max)
+        return;
+
+    msgs[*count].payload = strndup(buf, len);
+    msgs[*count].len = len;
+    msgs[*count].reply = reply;
+    msgs[*count].caller = caller;
+    msgs[*count].callee = callee;
+    (*count)++;
+}
+
+/**
+ * @brief Generate a synthetic corpus of SIP messages
+ *
+ * @param kind Corpus kind
+ * @param count Number of messages (or segments) to generate
+ * @return array of generated messages
+ */
+static bench_msg_t *
+bench_corpus_create(enum bench_corpus kind, int count)
+{
+    char buf[BENCH_MSG_MAXLEN], seg[BENCH_MSG_MAXLEN * 3];
+    char callid[128], invite[128], ack[128], bye[128], reg[128];
+    unsigned int tags[2];
+    address_t caller, callee;
+    bench_msg_t *msgs, *dialog;
+    bool compact = (kind == CORPUS_COMPACT);
+    int n = 0, d, len, seglen, i, rport, lport;
+
+    if (!(msgs = calloc(count, sizeof(bench_msg_t))))
+        return NULL;
+
+    // Dialog messages are generated first and then grouped in segments
+    dialog = (kind == CORPUS_TCP_MULTI) ? calloc(count * 3, sizeof(bench_msg_t)) : msgs;
+    if (!dialog) {
+        free(msgs);
+        return NULL;
+    }
+
+    while (n < ((kind == CORPUS_TCP_MULTI) ? count * 3 : count)) {
+        int max = (kind == CORPUS_TCP_MULTI) ? count * 3 : count;
+
+        caller = bench_address(5060);
+        callee = bench_address(5060);
+        tags[0] = rand_r(&bench_seed);
+        tags[1] = rand_r(&bench_seed);
+        snprintf(callid, sizeof(callid), "%08x%08x@%s", rand_r(&bench_seed), rand_r(&bench_seed), caller.ip);
+        lport = 10000 + (rand_r(&bench_seed) % 10000) * 2;
+        rport = 10000 + (rand_r(&bench_seed) % 10000) * 2;
+        snprintf(invite, sizeof(invite), "INVITE sip:bob@%s:%d SIP/2.0", callee.ip, callee.port);
+        snprintf(ack, sizeof(ack), "ACK sip:bob@%s:%d SIP/2.0", callee.ip, callee.port);
+        snprintf(bye, sizeof(bye), "BYE sip:bob@%s:%d SIP/2.0", callee.ip, callee.port);
+
+        if (kind == CORPUS_REGISTER) {
+            // Authentication challenge and authenticated REGISTER
+            snprintf(reg, sizeof(reg), "REGISTER sip:%s SIP/2.0", callee.ip);
+            len = bench_sip(buf, sizeof(buf), reg, "REGISTER", 1, callid, tags, false, false, caller, 0);
+            bench_msg_add(msgs, &n, max, buf, len, false, caller, callee);
+            len = bench_sip(buf, sizeof(buf), "SIP/2.0 401 Unauthorized", "REGISTER", 1, callid, tags, true, false, callee, 0);
+            bench_msg_add(msgs, &n, max, buf, len, true, caller, callee);
+            len = bench_sip(buf, sizeof(buf), reg, "REGISTER", 2, callid, tags, false, false, caller, 0);
+            bench_msg_add(msgs, &n, max, buf, len, false, caller, callee);
+            len = bench_sip(buf, sizeof(buf), "SIP/2.0 200 OK", "REGISTER", 2, callid, tags, true, false, callee, 0);
+            bench_msg_add(msgs, &n, max, buf, len, true, caller, callee);
+            continue;
+        }
+
+        len = bench_sip(buf, sizeof(buf), invite, "INVITE", 1, callid, tags, false, compact, caller, lport);
+        bench_msg_add(dialog, &n, max, buf, len, false, caller, callee);
+        len = bench_sip(buf, sizeof(buf), "SIP/2.0 100 Trying", "INVITE", 1, callid, tags, false, compact, callee, 0);
+        bench_msg_add(dialog, &n, max, buf, len, true, caller, callee);
+        len = bench_sip(buf, sizeof(buf), "SIP/2.0 180 Ringing", "INVITE", 1, callid, tags, true, compact, callee, 0);
+        bench_msg_add(dialog, &n, max, buf, len, true, caller, callee);
+        len = bench_sip(buf, sizeof(buf), "SIP/2.0 200 OK", "INVITE", 1, callid, tags, true, compact, callee, rport);
+        bench_msg_add(dialog, &n, max, buf, len, true, caller, callee);
+        len = bench_sip(buf, sizeof(buf), ack, "ACK", 1, callid, tags, true, compact, caller, 0);
+        bench_msg_add(dialog, &n, max, buf, len, false, caller, callee);
+        len = bench_sip(buf, sizeof(buf), bye, "BYE", 2, callid, tags, true, compact, caller, 0);
+        bench_msg_add(dialog, &n, max, buf, len, false, caller, callee);
+        len = bench_sip(buf, sizeof(buf), "SIP/2.0 200 OK", "BYE", 2, callid, tags, true, compact, callee, 0);
+        bench_msg_add(dialog, &n, max, buf, len, true, caller, callee);
+    }
+
+    if (kind != CORPUS_TCP_MULTI)
+        return msgs;
+
+    // Join three consecutive messages in each segment
+    for (i = 0; i < count; i++) {
+        seglen = 0;
+        for (d = i * 3; d < i * 3 + 3; d++) {
+            memcpy(seg + seglen, dialog[d].payload, dialog[d].len);
+            seglen += dialog[d].len;
+            free(dialog[d].payload);
+        }
+        msgs[i] = dialog[i * 3];
+        msgs[i].payload = strndup(seg, seglen);
+        msgs[i].len = seglen;
+    }
+    free(dialog);
+
+    return msgs;
+}
+
+static void
+bench_corpus_destroy(bench_msg_t *msgs, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+        free(msgs[i].payload);
+    free(msgs);
+}
+
+static packet_t *
+bench_packet(bench_msg_t *msg)
+{
+    struct pcap_pkthdr header = { };
+    packet_t *packet;
+
+    gettimeofday(&header.ts, NULL);
+    header.caplen = header.len = msg->len + 42;
+
+    packet = msg->reply
+             ? packet_create(4, IPPROTO_UDP, msg->callee, msg->caller, 0)
+             : packet_create(4, IPPROTO_UDP, msg->caller, msg->callee, 0);
+    packet_set_type(packet, PACKET_SIP_UDP);
+    packet_set_payload(packet, (u_char *) msg->payload, msg->len);
+    packet_add_synthetic_frame(packet, &header);
+    return packet;
+}
+
+static packet_t **
+bench_packets(bench_msg_t *msgs, int count)
+{
+    packet_t **packets;
+    int i;
+
+    if (!(packets = calloc(count, sizeof(packet_t *))))
+        return NULL;
+    for (i = 0; i < count; i++)
+        packets[i] = bench_packet(&msgs[i]);
+    return packets;
+}
+
+static void
+bench_validate(enum bench_corpus kind, int count)
+{
+    bench_msg_t *msgs = bench_corpus_create(kind, count);
+    packet_t **packets = bench_packets(msgs, count);
+    uint64_t start, allocs, bytes;
+    int i;
+
+    allocs = bench_allocs;
+    bytes = bench_alloc_bytes;
+    start = bench_now();
+    for (i = 0; i < count; i++)
+        sip_validate_packet(packets[i]);
+    bench_report("sip_validate_packet", corpus_names[kind], count, bench_now() - start,
+                 bench_allocs - allocs, bench_alloc_bytes - bytes);
+
+    for (i = 0; i < count; i++)
+        packet_destroy(packets[i]);
+    free(packets);
+    bench_corpus_destroy(msgs, count);
+}
+
+static void
+bench_check(enum bench_corpus kind, int count)
+{
+    bench_msg_t *msgs = bench_corpus_create(kind, count);
+    packet_t **packets = bench_packets(msgs, count);
+    uint64_t start, allocs, bytes;
+    int i;
+
+    allocs = bench_allocs;
+    bytes = bench_alloc_bytes;
+    start = bench_now();
+    for (i = 0; i < count; i++) {
+        // Parsed packets are owned by their message from now on
+        if (sip_check_packet(packets[i]))
+            packets[i] = NULL;
+    }
+    bench_report("sip_check_packet", corpus_names[kind], count, bench_now() - start,
+                 bench_allocs - allocs, bench_alloc_bytes - bytes);
+
+    for (i = 0; i < count; i++)
+        packet_destroy(packets[i]);
+    free(packets);
+    sip_calls_clear();
+    bench_corpus_destroy(msgs, count);
+}
+
+static void
+bench_media(enum bench_corpus kind, int count)
+{
+    bench_msg_t *corpus = bench_corpus_create(kind, count);
+    bench_msg_t **msgs;
+    sip_msg_t **sipmsgs;
+    packet_t *packet;
+    sip_call_t *call;
+    uint64_t start, allocs, bytes;
+    char callid[] = "bench";
+    int i, sdpcnt = 0;
+
+    // Only messages with SDP are parsed
+    msgs = calloc(count, sizeof(bench_msg_t *));
+    sipmsgs = calloc(count, sizeof(sip_msg_t *));
+    for (i = 0; i < count; i++) {
+        if (strstr(corpus[i].payload, "\r\nm=audio"))
+            msgs[sdpcnt++] = &corpus[i];
+    }
+
+    // Each message is parsed as the first message of a new call
+    for (i = 0; i < sdpcnt; i++) {
+        call = call_create(callid, "");
+        sipmsgs[i] = msg_create();
+        sipmsgs[i]->call = call;
+    }
+    packet = bench_packet(msgs[0]);
+
+    allocs = bench_allocs;
+    bytes = bench_alloc_bytes;
+    start = bench_now();
+    for (i = 0; i < sdpcnt; i++) {
+        sipmsgs[i]->packet = packet;
+        sip_parse_msg_media(sipmsgs[i], (const u_char *) msgs[i]->payload);
+    }
+    bench_report("sip_parse_msg_media", corpus_names[kind], sdpcnt, bench_now() - start,
+                 bench_allocs - allocs, bench_alloc_bytes - bytes);
+
+    for (i = 0; i < sdpcnt; i++) {
+        call = sipmsgs[i]->call;
+        sipmsgs[i]->packet = NULL;
+        msg_destroy(sipmsgs[i]);
+        call_destroy(call);
+    }
+    packet_destroy(packet);
+    free(sipmsgs);
+    free(msgs);
+    bench_corpus_destroy(corpus, count);
+}
+
+static void
+bench_rtp(int calls, int count)
+{
+    bench_msg_t *msgs = bench_corpus_create(CORPUS_DIALOG, calls * 7);
+    packet_t **packets, *packet;
+    u_char rtp[12 + BENCH_RTP_LEN] = { 0x80, 0x00 };
+    address_t src, dst;
+    uint64_t start, allocs, bytes;
+    int i, c, matched = 0;
+    char *m;
+
+    // Create the calls with INVITE and 200 OK SDP
+    for (i = 0; i < calls * 7; i++) {
+        if (strncmp(msgs[i].payload, "INVITE", 6) && strncmp(msgs[i].payload, "SIP/2.0 200 OK\r\n", 16))
+            continue;
+        if (!strstr(msgs[i].payload, "m=audio"))
+            continue;
+        packet = bench_packet(&msgs[i]);
+        if (!sip_check_packet(packet))
+            packet_destroy(packet);
+    }
+
+    // RTP packets in both directions of each call
+    packets = calloc(count, sizeof(packet_t *));
+    for (i = 0; i < count; i++) {
+        c = (i / 2) % calls;
+        // Media ports announced in INVITE and 200 OK SDP of the call
+        m = strstr(msgs[c * 7].payload, "m=audio ");
+        src = msgs[c * 7].callee;
+        dst = msgs[c * 7].caller;
+        dst.port = atoi(m + 8);
+        m = strstr(msgs[c * 7 + 3].payload, "m=audio ");
+        src.port = atoi(m + 8);
+        if (i % 2) {
+            address_t tmp = src;
+            src = dst;
+            dst = tmp;
+        }
+        rtp[3] = i & 0xff;
+        rtp[2] = (i >> 8) & 0xff;
+        packets[i] = packet_create(4, IPPROTO_UDP, src, dst, 0);
+        packet_set_payload(packets[i], rtp, sizeof(rtp));
+    }
+
+    allocs = bench_allocs;
+    bytes = bench_alloc_bytes;
+    start = bench_now();
+    for (i = 0; i < count; i++) {
+        if (rtp_check_packet(packets[i]))
+            matched++;
+    }
+    bench_report("rtp_check_packet", "rtp", count, bench_now() - start,
+                 bench_allocs - allocs, bench_alloc_bytes - bytes);
+
+    if (matched != count)
+        fprintf(stderr, "rtp_check_packet: only %d of %d packets matched a stream\n", matched, count);
+
+    for (i = 0; i < count; i++)
+        packet_destroy(packets[i]);
+    free(packets);
+    sip_calls_clear();
+    bench_corpus_destroy(msgs, calls * 7);
+}
+
+static void
+usage()
+{
+    printf("Usage: bench_parser [-n messages] [-c calls] [-s seed] [-b benchmark]\n\n"
+           "    -n --messages\t Messages parsed by each benchmark (default: 100000)\n"
+           "    -c --calls\t\t Calls with RTP streams in rtp benchmark (default: 100)\n"
+           "    -s --seed\t\t Random seed of the synthetic corpus (default: 1)\n"
+           "    -b --bench\t\t Only run given benchmark: validate, check, media or rtp\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+    const char *only = NULL;
+    int count = 100000, calls = 100, opt, idx, kind;
+
+    static struct option long_options[] = {
+        { "help", no_argument, 0, 'h' },
+        { "messages", required_argument, 0, 'n' },
+        { "calls", required_argument, 0, 'c' },
+        { "seed", required_argument, 0, 's' },
+        { "bench", required_argument, 0, 'b' },
+        { 0, 0, 0, 0 }
+    };
+
+    while ((opt = getopt_long(argc, argv, "hn:c:s:b:", long_options, &idx)) != -1) {
+        switch (opt) {
+            case 'n':
+                count = atoi(optarg);
+                break;
+            case 'c':
+                calls = atoi(optarg);
+                break;
+            case 's':
+                bench_seed = atoi(optarg);
+                break;
+            case 'b':
+                only = optarg;
+                break;
+            default:
+                usage();
+                return (opt == 'h') ? 0 : 1;
+        }
+    }
+
+    if (count <= 0 || calls <= 0) {
+        usage();
+        return 1;
+    }
+
+    // Same parser configuration than a default sngrep run
+    init_options(1);
+    capture_init(setting_get_intvalue(SETTING_CAPTURE_LIMIT), false, true, 2 * 1024 * 1024);
+    sip_init(setting_get_intvalue(SETTING_CAPTURE_LIMIT), setting_enabled(SETTING_SIP_CALLS),
+             setting_enabled(SETTING_SIP_NOINCOMPLETE));
+
+    if (!only || !strcmp(only, "validate")) {
+        for (kind = 0; kind < CORPUS_COUNT; kind++)
+            bench_validate(kind, count);
+    }
+
+    if (!only || !strcmp(only, "check")) {
+        for (kind = 0; kind < CORPUS_TCP_MULTI; kind++)
+            bench_check(kind, count);
+    }
+
+    if (!only || !strcmp(only, "media")) {
+        bench_media(CORPUS_DIALOG, count);
+        bench_media(CORPUS_COMPACT, count);
+    }
+
+    if (!only || !strcmp(only, "rtp"))
+        bench_rtp(calls, count);
+
+    sip_deinit();
+    capture_deinit();
+    deinit_options();
+    return 0;
+}
@@ -0,0 +1,711 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file bench_replay.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * End-to-end offline replay benchmark
+ *
+ * Replays a pcap file through the same parse_packet() path used by
+ * sngrep, without ncurses interface, and prints one JSON line with
+ * packets/s, messages/s, calls/s, peak RSS and the time spent in each
+ * pipeline stage.
+ *
+ * It can also generate large synthetic pcap files with INVITE dialogs
+ * over UDP, TCP or WebSocket, optional RTP streams and IP fragmentation,
+ * so sngrep scaling can be measured without real traffic.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "../src/capture.h"
+#include "../src/event.h"
+#include "../src/metrics.h"
+#include "../src/option.h"
+#include "../src/setting.h"
+#include "../src/sip.h"
+
+//! Max size of a generated SIP message
+#define GEN_MSG_MAXLEN 4096
+//! Max size of a generated frame
+#define GEN_FRAME_MAXLEN 65535
+//! Size of generated Ethernet header
+#define GEN_ETHER_LEN 14
+//! RTP payload size (20ms of G.711)
+#define GEN_RTP_LEN 160
+//! First timestamp of generated captures
+#define GEN_START_TIME 1700000000
+
+//! Transports of generated dialogs
+enum gen_transport {
+    GEN_UDP = 0,
+    GEN_TCP,
+    GEN_WS,
+    GEN_TRANSPORT_COUNT
+};
+
+//! Transport names in the -t mix
+static const char *gen_transport_names[GEN_TRANSPORT_COUNT] = {
+    "udp", "tcp", "ws"
+};
+
+//! Shorter declaration of gen_config structure
+typedef struct gen_config gen_config_t;
+//! Shorter declaration of gen_conn structure
+typedef struct gen_conn gen_conn_t;
+
+/**
+ * @brief Synthetic capture generator configuration
+ */
+struct gen_config {
+    //! Output pcap dumper
+    pcap_dumper_t *pd;
+    //! Number of dialogs to generate
+    int dialogs;
+    //! New dialogs per second of capture time
+    int rate;
+    //! RTP packets of each stream (0 for no RTP)
+    int rtp;
+    //! Max IP packet size. Larger UDP packets are fragmented and TCP is segmented
+    int mtu;
+    //! Weight of each transport in the dialog mix
+    int weights[GEN_TRANSPORT_COUNT];
+    //! Random seed
+    unsigned int seed;
+    //! Next IP identification
+    uint16_t ipid;
+    //! Timestamp of the next frame
+    struct timeval ts;
+    //! Written frames
+    uint64_t frames;
+};
+
+/**
+ * @brief Endpoints and sequence numbers of a dialog connection
+ */
+struct gen_conn {
+    //! Caller and callee addresses (network order)
+    struct in_addr caller, callee;
+    //! Caller and callee ports
+    uint16_t cport, sport;
+    //! Next TCP sequence from each endpoint
+    uint32_t cseq, sseq;
+    //! Dialog transport
+    enum gen_transport transport;
+};
+
+static uint64_t
+bench_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint16_t
+gen_checksum(const void *data, int len)
+{
+    const uint16_t *word = data;
+    uint32_t sum = 0;
+
+    for (; len > 1; len -= 2)
+        sum += *word++;
+    if (len)
+        sum += *(const uint8_t *) word;
+    while (sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+    return ~sum;
+}
+
+/**
+ * @brief Advance the timestamp of next written frames
+ *
+ * @param usec Microseconds to advance
+ */
+static void
+gen_advance(gen_config_t *gen, uint64_t usec)
+{
+    usec += gen->ts.tv_usec;
+    gen->ts.tv_sec += usec / 1000000;
+    gen->ts.tv_usec = usec % 1000000;
+}
+
+static void
+gen_write(gen_config_t *gen, const u_char *frame, int len)
+{
+    struct pcap_pkthdr header;
+
+    header.ts = gen->ts;
+    header.caplen = header.len = len;
+    pcap_dump((u_char *) gen->pd, &header, frame);
+    gen->frames++;
+}
+
+/**
+ * @brief Write an IPv4 packet, fragmenting it if required
+ *
+ * @param data Transport header and payload
+ */
+static void
+gen_ip(gen_config_t *gen, struct in_addr src, struct in_addr dst, uint8_t proto,
+       const u_char *data, int len)
+{
+    static u_char frame[GEN_FRAME_MAXLEN];
+    struct ip *ip = (struct ip *) (frame + GEN_ETHER_LEN);
+    int offset = 0, fraglen, maxfrag;
+
+    // Ethernet header with fixed addresses and IPv4 type
+    memset(frame, 0, GEN_ETHER_LEN);
+    frame[5] = 0x02;
+    frame[11] = 0x01;
+    frame[12] = 0x08;
+
+    // Fragment payload must be multiple of 8 bytes
+    maxfrag = (gen->mtu - sizeof(struct ip)) & ~7;
+
+    gen->ipid++;
+    do {
+        fraglen = (len - offset > maxfrag) ? maxfrag : len - offset;
+
+        memset(ip, 0, sizeof(struct ip));
+        ip->ip_v = 4;
+        ip->ip_hl = sizeof(struct ip) / 4;
+        ip->ip_len = htons(sizeof(struct ip) + fraglen);
+        ip->ip_id = htons(gen->ipid);
+        ip->ip_off = htons((offset / 8) | ((offset + fraglen < len) ? IP_MF : 0));
+        ip->ip_ttl = 64;
+        ip->ip_p = proto;
+        ip->ip_src = src;
+        ip->ip_dst = dst;
+        ip->ip_sum = gen_checksum(ip, sizeof(struct ip));
+
+        memcpy(frame + GEN_ETHER_LEN + sizeof(struct ip), data + offset, fraglen);
+        gen_write(gen, frame, GEN_ETHER_LEN + sizeof(struct ip) + fraglen);
+        offset += fraglen;
+    } while (offset < len);
+}
+
+static void
+gen_udp(gen_config_t *gen, struct in_addr src, uint16_t sport, struct in_addr dst, uint16_t dport,
+        const u_char *payload, int len)
+{
+    static u_char data[GEN_FRAME_MAXLEN];
+    struct udphdr *udp = (struct udphdr *) data;
+
+    // UDP checksum is optional in IPv4
+    udp->uh_sport = htons(sport);
+    udp->uh_dport = htons(dport);
+    udp->uh_ulen = htons(sizeof(struct udphdr) + len);
+    udp->uh_sum = 0;
+    memcpy(data + sizeof(struct udphdr), payload, len);
+    gen_ip(gen, src, dst, IPPROTO_UDP, data, sizeof(struct udphdr) + len);
+}
+
+/**
+ * @brief Write a payload as TCP segments of a dialog connection
+ *
+ * Only the last segment has PSH flag, as sngrep waits for it before
+ * parsing non SIP payloads (like WebSocket frames).
+ */
+static void
+gen_tcp(gen_config_t *gen, gen_conn_t *conn, bool fromcaller, const u_char *payload, int len)
+{
+    static u_char data[GEN_FRAME_MAXLEN];
+    struct tcphdr *tcp = (struct tcphdr *) data;
+    uint32_t *seq = fromcaller ? &conn->cseq : &conn->sseq;
+    int offset = 0, seglen, mss;
+
+    mss = gen->mtu - sizeof(struct ip) - sizeof(struct tcphdr);
+
+    do {
+        seglen = (len - offset > mss) ? mss : len - offset;
+
+        memset(tcp, 0, sizeof(struct tcphdr));
+        tcp->th_sport = htons(fromcaller ? conn->cport : conn->sport);
+        tcp->th_dport = htons(fromcaller ? conn->sport : conn->cport);
+        tcp->th_seq = htonl(*seq);
+        tcp->th_ack = htonl(fromcaller ? conn->sseq : conn->cseq);
+        tcp->th_off = sizeof(struct tcphdr) / 4;
+        tcp->th_flags = TH_ACK | ((offset + seglen == len) ? TH_PUSH : 0);
+        tcp->th_win = htons(65535);
+        memcpy(data + sizeof(struct tcphdr), payload + offset, seglen);
+
+        gen_ip(gen, fromcaller ? conn->caller : conn->callee,
+               fromcaller ? conn->callee : conn->caller,
+               IPPROTO_TCP, data, sizeof(struct tcphdr) + seglen);
+
+        *seq += seglen;
+        offset += seglen;
+    } while (offset < len);
+}
+
+/**
+ * @brief Write a SIP message using the dialog transport
+ */
+static void
+gen_sip(gen_config_t *gen, gen_conn_t *conn, bool fromcaller, const char *msg, int len)
+{
+    static u_char frame[GEN_MSG_MAXLEN + 8];
+    u_char mask[4];
+    int i, off = 0;
+
+    switch (conn->transport) {
+        case GEN_UDP:
+            gen_udp(gen, fromcaller ? conn->caller : conn->callee, fromcaller ? conn->cport : conn->sport,
+                    fromcaller ? conn->callee : conn->caller, fromcaller ? conn->sport : conn->cport,
+                    (const u_char *) msg, len);
+            break;
+        case GEN_TCP:
+            gen_tcp(gen, conn, fromcaller, (const u_char *) msg, len);
+            break;
+        case GEN_WS:
+            // Text frame with 16 bits length, masked from client to server
+            frame[off++] = 0x81;
+            frame[off++] = (fromcaller ? 0x80 : 0x00) | 126;
+            frame[off++] = (len >> 8) & 0xff;
+            frame[off++] = len & 0xff;
+            if (fromcaller) {
+                for (i = 0; i < 4; i++)
+                    frame[off++] = mask[i] = rand_r(&gen->seed) & 0xff;
+                for (i = 0; i < len; i++)
+                    frame[off + i] = msg[i] ^ mask[i % 4];
+            } else {
+                memcpy(frame + off, msg, len);
+            }
+            gen_tcp(gen, conn, fromcaller, frame, off + len);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Format a SIP message of a dialog
+ *
+ * @param first Request or status line
+ * @param method CSeq method
+ * @param totag Include callee tag in To header
+ * @param media Media port of the SDP body (0 for no body)
+ */
+static int
+gen_sip_format(char *buf, gen_conn_t *conn, const char *first, const char *method, int cseq,
+               const char *callid, unsigned int tags[2], bool totag, bool fromcaller, int media)
+{
+    char body[1024] = "", totagstr[32] = "", ip[INET_ADDRSTRLEN];
+    const char *transport = "UDP";
+    int bodylen = 0;
+
+    if (conn->transport == GEN_TCP)
+        transport = "TCP";
+    if (conn->transport == GEN_WS)
+        transport = "WS";
+
+    // Via and SDP addresses of the message sender
+    inet_ntop(AF_INET, fromcaller ? &conn->caller : &conn->callee, ip, sizeof(ip));
+
+    if (media) {
+        bodylen = snprintf(body, sizeof(body),
+                           "v=0\r\n"
+                           "o=- %u 1 IN IP4 %s\r\n"
+                           "s=-\r\n"
+                           "c=IN IP4 %s\r\n"
+                           "t=0 0\r\n"
+                           "m=audio %d RTP/AVP 0 101\r\n"
+                           "a=rtpmap:0 PCMU/8000\r\n"
+                           "a=rtpmap:101 telephone-event/8000\r\n"
+                           "a=sendrecv\r\n",
+                           tags[fromcaller ? 0 : 1], ip, ip, media);
+    }
+    if (totag)
+        snprintf(totagstr, sizeof(totagstr), ";tag=%08x", tags[1]);
+
+    return snprintf(buf, GEN_MSG_MAXLEN,
+                    "%s\r\n"
+                    "Via: SIP/2.0/%s %s:%d;branch=z9hG4bK%08x%d\r\n"
+                    "Max-Forwards: 70\r\n"
+                    "From: <sip:alice@example.com>;tag=%08x\r\n"
+                    "To: <sip:bob@example.com>%s\r\n"
+                    "Call-ID: %s\r\n"
+                    "CSeq: %d %s\r\n"
+                    "Contact: <sip:%s@%s:%d;transport=%s>\r\n"
+                    "User-Agent: sngrep-bench\r\n"
+                    "%s"
+                    "Content-Length: %d\r\n"
+                    "\r\n"
+                    "%s",
+                    first,
+                    transport, ip, fromcaller ? conn->cport : conn->sport, tags[0], cseq,
+                    tags[0], totagstr, callid, cseq, method,
+                    fromcaller ? "alice" : "bob", ip, fromcaller ? conn->cport : conn->sport, transport,
+                    media ? "Content-Type: application/sdp\r\n" : "",
+                    bodylen, body);
+}
+
+/**
+ * @brief Write the RTP streams of a dialog
+ *
+ * @param step Time between packets of each direction
+ */
+static void
+gen_rtp(gen_config_t *gen, gen_conn_t *conn, int cmedia, int smedia, uint64_t step)
+{
+    u_char rtp[12 + GEN_RTP_LEN];
+    uint32_t ssrc[2] = { rand_r(&gen->seed), rand_r(&gen->seed) };
+    int i, dir;
+
+    memset(rtp, 0xff, sizeof(rtp));
+    for (i = 0; i < gen->rtp; i++) {
+        for (dir = 0; dir < 2; dir++) {
+            // Version 2, PCMU, sequence, timestamp and SSRC
+            rtp[0] = 0x80;
+            rtp[1] = (i == 0) ? 0x80 : 0x00;
+            rtp[2] = (i >> 8) & 0xff;
+            rtp[3] = i & 0xff;
+            *(uint32_t *) (rtp + 4) = htonl(i * GEN_RTP_LEN);
+            *(uint32_t *) (rtp + 8) = htonl(ssrc[dir]);
+            if (dir == 0) {
+                gen_udp(gen, conn->caller, cmedia, conn->callee, smedia, rtp, sizeof(rtp));
+            } else {
+                gen_udp(gen, conn->callee, smedia, conn->caller, cmedia, rtp, sizeof(rtp));
+            }
+        }
+        gen_advance(gen, step);
+    }
+}
+
+/**
+ * @brief Write a SIP message of a dialog and advance the capture time
+ */
+static void
+gen_dialog_msg(gen_config_t *gen, gen_conn_t *conn, bool fromcaller, const char *first,
+               const char *method, int cseq, const char *callid, unsigned int tags[2],
+               bool totag, int media, uint64_t step)
+{
+    char msg[GEN_MSG_MAXLEN];
+    int len;
+
+    len = gen_sip_format(msg, conn, first, method, cseq, callid, tags, totag, fromcaller, media);
+    gen_sip(gen, conn, fromcaller, msg, len);
+    gen_advance(gen, step);
+}
+
+/**
+ * @brief Write an INVITE dialog
+ *
+ * All packets of the dialog are written together, evenly spread in the
+ * time between two consecutive dialogs, so frame timestamps always grow.
+ */
+static void
+gen_dialog(gen_config_t *gen, int index)
+{
+    char callid[64];
+    unsigned int tags[2];
+    gen_conn_t conn;
+    int weight, cmedia, smedia;
+    uint64_t start, step;
+
+    // Dialog transport from the weighted mix
+    weight = rand_r(&gen->seed) % (gen->weights[GEN_UDP] + gen->weights[GEN_TCP] + gen->weights[GEN_WS]);
+    for (conn.transport = GEN_UDP; conn.transport < GEN_WS; conn.transport++) {
+        if (weight < gen->weights[conn.transport])
+            break;
+        weight -= gen->weights[conn.transport];
+    }
+
+    // Dialog endpoints and identifiers
+    conn.caller.s_addr = htonl(0x0a000000 | (rand_r(&gen->seed) & 0xffffff));
+    conn.callee.s_addr = htonl(0xac100000 | (rand_r(&gen->seed) & 0xfffff));
+    conn.cport = (conn.transport == GEN_UDP) ? 5060 : 1024 + rand_r(&gen->seed) % 60000;
+    conn.sport = (conn.transport == GEN_WS) ? 8080 : 5060;
+    conn.cseq = 1 + rand_r(&gen->seed);
+    conn.sseq = 1 + rand_r(&gen->seed);
+    tags[0] = rand_r(&gen->seed);
+    tags[1] = rand_r(&gen->seed);
+    snprintf(callid, sizeof(callid), "%08x%08x-%d@sngrep.bench", rand_r(&gen->seed), tags[0], index);
+    cmedia = 10000 + (rand_r(&gen->seed) % 20000) * 2;
+    smedia = 10000 + (rand_r(&gen->seed) % 20000) * 2;
+
+    // Spread dialog packets in the time until next dialog
+    start = (uint64_t) index * 1000000 / gen->rate;
+    gen->ts.tv_sec = GEN_START_TIME + start / 1000000;
+    gen->ts.tv_usec = start % 1000000;
+    step = 1000000 / gen->rate / (7 + gen->rtp);
+
+    gen_dialog_msg(gen, &conn, true, "INVITE sip:bob@example.com SIP/2.0", "INVITE", 1, callid, tags, false, cmedia, step);
+    gen_dialog_msg(gen, &conn, false, "SIP/2.0 100 Trying", "INVITE", 1, callid, tags, false, 0, step);
+    gen_dialog_msg(gen, &conn, false, "SIP/2.0 180 Ringing", "INVITE", 1, callid, tags, true, 0, step);
+    gen_dialog_msg(gen, &conn, false, "SIP/2.0 200 OK", "INVITE", 1, callid, tags, true, smedia, step);
+    gen_dialog_msg(gen, &conn, true, "ACK sip:bob@example.com SIP/2.0", "ACK", 1, callid, tags, true, 0, step);
+    gen_rtp(gen, &conn, cmedia, smedia, step);
+    gen_dialog_msg(gen, &conn, true, "BYE sip:bob@example.com SIP/2.0", "BYE", 2, callid, tags, true, 0, step);
+    gen_dialog_msg(gen, &conn, false, "SIP/2.0 200 OK", "BYE", 2, callid, tags, true, 0, step);
+}
+
+/**
+ * @brief Parse the transport mix (udp:8,tcp:1,ws:1)
+ *
+ * @return 0 if mix is valid, 1 otherwise
+ */
+static int
+gen_parse_mix(gen_config_t *gen, const char *mix)
+{
+    char *copy = strdup(mix), *item, *save = NULL, *weight;
+    int i, total = 0;
+
+    memset(gen->weights, 0, sizeof(gen->weights));
+    for (item = strtok_r(copy, ",", &save); item; item = strtok_r(NULL, ",", &save)) {
+        if ((weight = strchr(item, ':')))
+            *weight++ = '\0';
+        for (i = 0; i < GEN_TRANSPORT_COUNT; i++) {
+            if (!strcmp(item, gen_transport_names[i]))
+                break;
+        }
+        if (i == GEN_TRANSPORT_COUNT) {
+            free(copy);
+            return 1;
+        }
+        gen->weights[i] = weight ? atoi(weight) : 1;
+        total += gen->weights[i];
+    }
+    free(copy);
+
+    return total > 0 ? 0 : 1;
+}
+
+/**
+ * @brief Write a synthetic capture file
+ *
+ * @return 0 if file has been written, 1 otherwise
+ */
+static int
+gen_capture(gen_config_t *gen, const char *filename)
+{
+    pcap_t *handle;
+    int i;
+
+    if (!(handle = pcap_open_dead(DLT_EN10MB, GEN_FRAME_MAXLEN)))
+        return 1;
+
+    if (!(gen->pd = pcap_dump_open(handle, filename))) {
+        fprintf(stderr, "Couldn't open %s: %s\n", filename, pcap_geterr(handle));
+        pcap_close(handle);
+        return 1;
+    }
+
+    for (i = 0; i < gen->dialogs; i++)
+        gen_dialog(gen, i);
+
+    pcap_dump_close(gen->pd);
+    pcap_close(handle);
+
+    fprintf(stderr, "Generated %d dialogs in %lu frames\n", gen->dialogs, (unsigned long) gen->frames);
+    return 0;
+}
+
+/**
+ * @brief Replay a capture file through sngrep parsers
+ *
+ * @return 0 if file has been replayed, 1 otherwise
+ */
+static int
+replay_capture(const char *filename)
+{
+    capture_info_t *capinfo;
+    vector_iter_t it;
+    metrics_histogram_t *histogram;
+    struct rusage usage;
+    uint64_t start, elapsed, frames = 0, msgs = 0, count;
+    int calls, i;
+
+    if (capture_offline(filename) != 0)
+        return 1;
+
+    // Parse all packets in this thread, there is no interface holding the lock
+    start = bench_now();
+    it = capture_sources_iterator();
+    while ((capinfo = vector_iterator_next(&it))) {
+        pcap_loop(capinfo->handle, -1, parse_packet, (u_char *) capinfo);
+        frames += atomic_load(&capinfo->metrics.captured);
+    }
+    capture_packet_store_pending();
+    elapsed = bench_now() - start;
+
+    for (i = 0; i < METRICS_SIP_METHODS; i++)
+        msgs += atomic_load(&metrics.sip_methods[i]);
+    for (i = 0; i < METRICS_SIP_RESPONSES; i++)
+        msgs += atomic_load(&metrics.sip_responses[i]);
+    calls = sip_calls_count_unrotated();
+    getrusage(RUSAGE_SELF, &usage);
+
+    printf("{\"file\":");
+    json_write_string(stdout, filename);
+    printf(",\"seconds\":%.3f,\"packets\":%lu,\"messages\":%lu,\"calls\":%d,"
+           "\"rtp_streams\":%lu,\"rtp_packets\":%lu,\"packets_per_sec\":%.0f,\"messages_per_sec\":%.0f,"
+           "\"calls_per_sec\":%.0f,\"peak_rss_kb\":%ld",
+           elapsed / 1e9, (unsigned long) frames, (unsigned long) msgs, calls,
+           (unsigned long) atomic_load(&metrics.rtp_streams),
+           (unsigned long) atomic_load(&metrics.rtp_packets),
+           frames / (elapsed / 1e9), msgs / (elapsed / 1e9), calls / (elapsed / 1e9),
+           usage.ru_maxrss);
+
+    // Time spent in each pipeline stage
+    if (metrics.stages) {
+        printf(",\"stages\":{");
+        for (i = 0; i < METRICS_STAGE_COUNT; i++) {
+            histogram = &metrics.stage[i];
+            count = metrics_histogram_count(histogram);
+            printf("%s\"%s\":{\"count\":%lu,\"ns\":%lu,\"p50_ns\":%lu,\"p99_ns\":%lu,\"max_ns\":%lu}",
+                   i ? "," : "", metrics_stage_name(i), (unsigned long) count,
+                   (unsigned long) atomic_load(&histogram->sum),
+                   (unsigned long) metrics_histogram_percentile(histogram, 50),
+                   (unsigned long) metrics_histogram_percentile(histogram, 99),
+                   (unsigned long) atomic_load(&histogram->max));
+        }
+        printf("}");
+    }
+    printf("}\n");
+
+    return 0;
+}
+
+static void
+usage()
+{
+    printf("Usage: bench_replay [-g output] [generator options] [-l limit] [-r] [-S] [file]\n\n"
+           "Generator options:\n"
+           "    -g --generate\t Write a synthetic capture to given file\n"
+           "    -n --dialogs\t Number of INVITE dialogs (default: 10000)\n"
+           "    -c --rate\t\t New dialogs per second of capture time (default: 100)\n"
+           "    -p --rtp\t\t RTP packets per stream, 0 disables RTP (default: 0)\n"
+           "    -t --transports\t Weighted transport mix (default: udp:1)\n"
+           "    \t\t\t Example: udp:8,tcp:1,ws:1\n"
+           "    -m --mtu\t\t Max IP packet size, larger packets are fragmented (default: 1500)\n"
+           "    -s --seed\t\t Random seed (default: 1)\n\n"
+           "Replay options:\n"
+           "    -l --limit\t\t Max stored dialogs, oldest are rotated (default: capture.limit)\n"
+           "    -r --rtp-capture\t Store RTP packets in memory\n"
+           "    -S --no-stages\t Disable pipeline stage timers\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+    gen_config_t gen = { .dialogs = 10000, .rate = 100, .mtu = 1500, .seed = 1 };
+    const char *output = NULL;
+    bool stages = true;
+    int opt, idx, limit;
+
+    static struct option long_options[] = {
+        { "help", no_argument, 0, 'h' },
+        { "generate", required_argument, 0, 'g' },
+        { "dialogs", required_argument, 0, 'n' },
+        { "rate", required_argument, 0, 'c' },
+        { "rtp", required_argument, 0, 'p' },
+        { "transports", required_argument, 0, 't' },
+        { "mtu", required_argument, 0, 'm' },
+        { "seed", required_argument, 0, 's' },
+        { "limit", required_argument, 0, 'l' },
+        { "rtp-capture", no_argument, 0, 'r' },
+        { "no-stages", no_argument, 0, 'S' },
+        { 0, 0, 0, 0 }
+    };
+
+    gen.weights[GEN_UDP] = 1;
+
+    // Same parser configuration than a default sngrep run
+    init_options(1);
+    limit = setting_get_intvalue(SETTING_CAPTURE_LIMIT);
+
+    while ((opt = getopt_long(argc, argv, "hg:n:c:p:t:m:s:l:rS", long_options, &idx)) != -1) {
+        switch (opt) {
+            case 'g':
+                output = optarg;
+                break;
+            case 'n':
+                gen.dialogs = atoi(optarg);
+                break;
+            case 'c':
+                gen.rate = atoi(optarg);
+                break;
+            case 'p':
+                gen.rtp = atoi(optarg);
+                break;
+            case 't':
+                if (gen_parse_mix(&gen, optarg) != 0) {
+                    fprintf(stderr, "Invalid transport mix: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'm':
+                gen.mtu = atoi(optarg);
+                break;
+            case 's':
+                gen.seed = atoi(optarg);
+                break;
+            case 'l':
+                limit = atoi(optarg);
+                break;
+            case 'r':
+                setting_set_value(SETTING_CAPTURE_RTP, SETTING_ON);
+                break;
+            case 'S':
+                stages = false;
+                break;
+            default:
+                usage();
+                return (opt == 'h') ? 0 : 1;
+        }
+    }
+
+    if ((!output && optind >= argc) || gen.dialogs <= 0 || gen.rate <= 0 || gen.rtp < 0
+        || gen.mtu < 576 || gen.mtu > GEN_FRAME_MAXLEN - GEN_ETHER_LEN || limit <= 0) {
+        usage();
+        return 1;
+    }
+
+    if (output && gen_capture(&gen, output) != 0)
+        return 1;
+
+    if (optind >= argc)
+        return 0;
+
+    // Old dialogs are rotated to keep memory bounded
+    capture_init(limit, setting_enabled(SETTING_CAPTURE_RTP), true, 2 * 1024 * 1024);
+    sip_init(limit, setting_enabled(SETTING_SIP_CALLS), setting_enabled(SETTING_SIP_NOINCOMPLETE));
+    metrics.stages = stages;
+
+    if (replay_capture(argv[optind]) != 0)
+        return 1;
+
+    sip_deinit();
+    capture_deinit();
+    deinit_options();
+    return 0;
+}
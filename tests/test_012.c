@@ -0,0 +1,75 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file test_012.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * Basic testing of bounded queue structures
+ */
+
+#include "config.h"
+#include <assert.h>
+#include <stdint.h>
+#include "../src/queue.h"
+
+#define ITEM(n) ((void *) (uintptr_t) (n))
+
+int main ()
+{
+    queue_t *queue;
+
+    // Size is rounded to next power of 2
+    queue = queue_create(3);
+    assert(queue);
+    assert(queue->size == 4);
+    assert(queue_count(queue) == 0);
+    assert(queue_pop(queue) == NULL);
+
+    // Items are returned in the same order they were pushed
+    assert(queue_push(queue, ITEM(1)) == NULL);
+    assert(queue_push(queue, ITEM(2)) == NULL);
+    assert(queue_count(queue) == 2);
+    assert(queue_pop(queue) == ITEM(1));
+    assert(queue_pop(queue) == ITEM(2));
+    assert(queue_pop(queue) == NULL);
+
+    // Fill the queue
+    assert(queue_push(queue, ITEM(3)) == NULL);
+    assert(queue_push(queue, ITEM(4)) == NULL);
+    assert(queue_push(queue, ITEM(5)) == NULL);
+    assert(queue_push(queue, ITEM(6)) == NULL);
+    assert(queue_count(queue) == 4);
+
+    // Full queue drops the oldest items
+    assert(queue_push(queue, ITEM(7)) == ITEM(3));
+    assert(queue_push(queue, ITEM(8)) == ITEM(4));
+    assert(queue_count(queue) == 4);
+    assert(queue_pop(queue) == ITEM(5));
+    assert(queue_pop(queue) == ITEM(6));
+    assert(queue_pop(queue) == ITEM(7));
+    assert(queue_pop(queue) == ITEM(8));
+    assert(queue_pop(queue) == NULL);
+    assert(queue_count(queue) == 0);
+
+    queue_destroy(queue);
+    return 0;
+}
@@ -0,0 +1,63 @@
+/**************************************************************************
+ **
+ ** sngrep - SIP Messages flow viewer
+ **
+ ** Copyright (C) 2013-2018 Ivan Alonso (Kaian)
+ ** Copyright (C) 2013-2018 Irontec SL. All rights reserved.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation, either version 3 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **
+ ****************************************************************************/
+/**
+ * @file test_013.c
+ * @author Ivan Alonso [aka Kaian] <kaian@irontec.com>
+ *
+ * Basic testing of display filter expressions
+ */
+
+#include "config.h"
+#include <assert.h>
+#include "../src/filter.h"
+
+//! Display filters storage
+extern filter_t filters[FILTER_COUNT];
+
+int main ()
+{
+    // Plain expression
+    assert(filter_set(FILTER_SIPFROM, "alice") == 0);
+    assert(filter_check_expr(filters[FILTER_SIPFROM], "sip:Alice@example.com") == 0);
+    assert(filter_check_expr(filters[FILTER_SIPFROM], "sip:bob@example.com") != 0);
+
+    // Anchored expression
+    assert(filter_set(FILTER_SIPFROM, "^sip:alice") == 0);
+    assert(filter_check_expr(filters[FILTER_SIPFROM], "sip:alice@example.com") == 0);
+    assert(filter_check_expr(filters[FILTER_SIPFROM], "<sip:alice@example.com>") != 0);
+
+    // Word anchored expression
+    assert(filter_set(FILTER_SIPFROM, "\\<alice\\>") == 0);
+#if defined(WITH_PCRE) || defined(WITH_PCRE2)
+    // Escaped angle brackets are characters
+    assert(filter_check_expr(filters[FILTER_SIPFROM], "<alice>@example.com") == 0);
+    assert(filter_check_expr(filters[FILTER_SIPFROM], "sip:alice@example.com") != 0);
+#else
+    // Escaped angle brackets are word boundaries
+    assert(filter_check_expr(filters[FILTER_SIPFROM], "sip:alice@example.com") == 0);
+    assert(filter_check_expr(filters[FILTER_SIPFROM], "sip:alicia@example.com") != 0);
+#endif
+
+    // Remove the filter
+    assert(filter_set(FILTER_SIPFROM, NULL) == 0);
+    return 0;
+}